@@ -19,8 +19,9 @@ typedef struct {
 
 typedef struct {
     PSF1Header header;
-    uint8_t* glyphs;
+    uint8_t* glyphs;       // May point into the mounted volume
     size_t glyph_count;
+    uint8_t* storage;      // Heap copy of the glyphs, or NULL
 } PSF1Font;
 
 PSF1Font* load_psf1(const char* path);
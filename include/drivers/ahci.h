@@ -0,0 +1,140 @@
+#ifndef AHCI_H
+#define AHCI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// ICH9 AHCI controller of the q35 machine (PCI 8086:2922)
+#define AHCI_VENDOR_ID       0x8086
+#define AHCI_DEVICE_ID       0x2922
+#define PCI_CLASS_STORAGE    0x01
+#define PCI_SUBCLASS_SATA    0x06
+#define PCI_INTERFACE_AHCI   0x01
+#define AHCI_PCI_ABAR        0x24    // BAR5: HBA registers
+
+// HBA (generic host control) register offsets
+#define AHCI_HBA_CAP         0x00
+#define AHCI_HBA_GHC         0x04
+#define AHCI_HBA_IS          0x08
+#define AHCI_HBA_PI          0x0C    // Ports implemented
+#define AHCI_HBA_VS          0x10
+
+#define AHCI_CAP_NCS_SHIFT   8       // Command slots - 1 (5 bits)
+#define AHCI_CAP_SNCQ        (1u << 30)
+#define AHCI_CAP_S64A        (1u << 31)
+
+#define AHCI_GHC_HR          (1u << 0)    // HBA reset
+#define AHCI_GHC_AE          (1u << 31)   // AHCI enable
+
+// Port registers, at 0x100 + port * 0x80
+#define AHCI_PORT_BASE       0x100
+#define AHCI_PORT_SIZE       0x80
+#define AHCI_PxCLB           0x00
+#define AHCI_PxCLBU          0x04
+#define AHCI_PxFB            0x08
+#define AHCI_PxFBU           0x0C
+#define AHCI_PxIS            0x10
+#define AHCI_PxIE            0x14
+#define AHCI_PxCMD           0x18
+#define AHCI_PxTFD           0x20
+#define AHCI_PxSIG           0x24
+#define AHCI_PxSSTS          0x28
+#define AHCI_PxSERR          0x30
+#define AHCI_PxSACT          0x34
+#define AHCI_PxCI            0x38
+
+#define AHCI_PxCMD_ST        (1u << 0)    // Start processing the command list
+#define AHCI_PxCMD_FRE       (1u << 4)    // FIS receive enable
+#define AHCI_PxCMD_FR        (1u << 14)   // FIS receive running
+#define AHCI_PxCMD_CR        (1u << 15)   // Command list running
+
+#define AHCI_PxIS_TFES       (1u << 30)   // Task file error
+#define AHCI_PxSSTS_DET      0x0F
+#define AHCI_DET_PRESENT     3            // Device present, link up
+#define AHCI_SIG_ATA         0x00000101
+
+// ATA commands used over AHCI
+#define AHCI_CMD_IDENTIFY          0xEC
+#define AHCI_CMD_READ_DMA_EXT      0x25
+#define AHCI_CMD_WRITE_DMA_EXT     0x35
+#define AHCI_CMD_READ_FPDMA        0x60    // NCQ
+#define AHCI_CMD_WRITE_FPDMA       0x61
+#define AHCI_CMD_FLUSH_CACHE_EXT   0xEA
+
+#define AHCI_FIS_REG_H2D     0x27
+
+// Command list entry
+struct ahci_cmd_header {
+    uint16_t flags;          // FIS length in dwords (bits 0-4), W (bit 6)
+    uint16_t prdtl;          // PRD entries
+    volatile uint32_t prdbc; // Bytes transferred
+    uint32_t ctba;           // Command table, 128-byte aligned
+    uint32_t ctbau;
+    uint32_t reserved[4];
+} __attribute__((packed));
+
+#define AHCI_HEADER_WRITE    (1u << 6)
+
+struct ahci_prd {
+    uint32_t dba;            // Data address, word aligned
+    uint32_t dbau;
+    uint32_t reserved;
+    uint32_t dbc;            // Byte count - 1 (22 bits), bit 31 interrupt
+} __attribute__((packed));
+
+#define AHCI_PRDS            8       // PRD entries per command table
+
+struct ahci_cmd_table {
+    uint8_t cfis[64];
+    uint8_t acmd[16];
+    uint8_t reserved[48];
+    struct ahci_prd prdt[AHCI_PRDS];
+} __attribute__((packed));
+
+// Host to device register FIS
+struct ahci_fis_h2d {
+    uint8_t type;
+    uint8_t flags;           // Bit 7: command
+    uint8_t command;
+    uint8_t feature_low;
+    uint8_t lba0, lba1, lba2;
+    uint8_t device;
+    uint8_t lba3, lba4, lba5;
+    uint8_t feature_high;
+    uint8_t count_low;
+    uint8_t count_high;
+    uint8_t icc;
+    uint8_t control;
+    uint8_t reserved[4];
+} __attribute__((packed));
+
+#define AHCI_MAX_PORTS       32
+#define AHCI_MAX_SLOTS       32
+#define AHCI_CMD_SECTORS     128     // Sectors per queued command (64 KB)
+#define AHCI_TIMEOUT         500     // Ticks (10 ms) before a transfer fails
+
+typedef struct {
+    uint8_t* regs;                   // This port's registers
+    struct ahci_cmd_header* cmd_list;
+    uint8_t* fis;
+    struct ahci_cmd_table* tables;   // One per slot
+    uint32_t sectors;                // Capacity from IDENTIFY
+    uint8_t depth;                   // Commands kept in flight
+    bool ncq;                        // Drive and HBA support NCQ
+} ahci_port_t;
+
+// Find the controller, reset it and bring up every port with an ATA disk
+bool ahci_init(void);
+bool ahci_is_initialized(void);
+
+// First port with a disk, or -1
+int ahci_first_disk(void);
+uint32_t ahci_get_total_sectors(int port);
+
+// Transfer any number of sectors. Large transfers are split into
+// AHCI_CMD_SECTORS commands kept in flight together, as NCQ commands
+// when the drive supports them.
+bool ahci_read_sectors(int port, uint64_t lba, uint32_t count, void* buffer);
+bool ahci_write_sectors(int port, uint64_t lba, uint32_t count, const void* buffer);
+
+#endif // AHCI_H
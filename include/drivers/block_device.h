@@ -5,7 +5,48 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+struct block_queue;
+
+// A transfer submitted through a device's request queue. Bios for
+// adjacent sectors are merged into one request, and queued requests are
+// dispatched in C-LOOK order: ascending from the last position, then
+// wrapping to the lowest sector.
+struct bio;
+typedef void (*bio_callback_t)(struct bio* bio);
+
+struct bio {
+    bool write;
+    uint32_t sector;
+    uint32_t count;
+    void* buffer;
+    bio_callback_t callback;    // Called when the transfer is done, may be NULL
+    void* context;
+    bool ok;
+    volatile bool done;
+    struct bio* next;           // Next bio of the same request
+};
+
+#define BLOCK_QUEUE_REQUESTS  32     // Request slots per device
+#define BLOCK_QUEUE_DEPTH     16     // Default requests held before dispatch
+#define BLOCK_MAX_REQUEST     256    // Sectors per merged request
+
+struct block_request {
+    bool write;
+    uint32_t sector;
+    uint32_t count;
+    void* buffer;               // Where the transfer goes, set at dispatch
+    uint8_t* bounce;            // Copy of scattered bio buffers, or NULL
+    struct bio* head;
+    struct bio* tail;
+    // Set by the driver for asynchronous transfers
+    bool ok;
+    volatile bool done;
+};
+
 typedef struct {
+    // Short name shown by the mount command
+    const char* name;
+
     // Read sectors from the device
     bool (*read_sectors)(uint32_t start_sector, uint32_t count, void* buffer);
     
@@ -17,12 +58,83 @@ typedef struct {
     
     // Get sector size in bytes
     uint16_t (*get_sector_size)(void);
+
+    // Address of sectors in memory, for devices that live in RAM.
+    // NULL for devices that can only be read through read_sectors.
+    const void* (*map_sectors)(uint32_t start_sector, uint32_t count);
+
+    // Request queue of the device, NULL to transfer every bio at once
+    struct block_queue* queue;
+
+    // Optional asynchronous transfers. submit starts a request and
+    // returns at once; the driver sets the request's 'ok' and 'done'
+    // when it completes, possibly from an interrupt. wait sleeps until a
+    // submitted request is done. NULL for devices that only transfer
+    // synchronously.
+    bool (*submit)(struct block_request* request);
+    void (*wait)(struct block_request* request);
 } block_device_t;
 
+struct block_queue_stats {
+    uint32_t submitted;         // Bios
+    uint32_t merged;            // Bios added to an existing request
+    uint32_t dispatched;        // Requests sent to the device
+    uint32_t bounced;           // Requests copied through a bounce buffer
+    uint32_t async;             // Requests the device completed in the background
+};
+
+struct block_queue {
+    struct block_request requests[BLOCK_QUEUE_REQUESTS];
+    uint32_t used;              // Bitmap of request slots in use
+    uint32_t in_flight;         // Used slots the device is working on
+    uint32_t depth;             // Requests held before the queue is run
+    uint32_t position;          // Sector after the last dispatched request
+    struct block_queue_stats stats;
+};
+
 // Global block device interface
 extern block_device_t* current_block_device;
 
 // Initialize block device interface with IDE driver
 bool block_device_init(void);
 
-#endif // BLOCK_DEVICE_H 
\ No newline at end of file
+// Backends. The ISO device is the FAT16 image GRUB loaded into RAM. The
+// IDE device is the primary master disk; it initializes the controller on
+// first use and returns NULL if there is no disk. The AHCI device is the
+// first SATA disk of the q35 machine's controller. The virtio device is
+// the first virtio-blk disk of a virtual machine.
+block_device_t* block_device_iso(void);
+block_device_t* block_device_ide(void);
+block_device_t* block_device_ahci(void);
+block_device_t* block_device_virtio(void);
+
+// Look up a backend by name ("iso", "ide", "ahci" or "virtio")
+block_device_t* block_device_get(const char* name);
+
+// Queue a bio. Queued bios reach the device once 'depth' requests are
+// waiting or the queue is kicked or run; a bio overlapping a queued or
+// in-flight write (or a write overlapping any request) runs the queue
+// first. Bio callbacks run from the queue calls below, never from an
+// interrupt.
+void block_submit(block_device_t* device, struct bio* bio);
+
+// Dispatch every queued request without waiting for asynchronous ones
+void block_queue_kick(block_device_t* device);
+
+// Complete the requests the device has finished. Cheap; called from
+// idle loops so background transfers are reaped.
+void block_queue_poll(block_device_t* device);
+
+// Dispatch every queued request and wait for all of them. False if any
+// request failed.
+bool block_queue_run(block_device_t* device);
+
+// Run the queue until 'bio' is done and return its result
+bool block_wait(block_device_t* device, struct bio* bio);
+
+// Requests held before dispatch, 1 to BLOCK_QUEUE_REQUESTS. A depth of 1
+// sends every bio to the device as soon as it is submitted.
+void block_queue_set_depth(block_device_t* device, uint32_t depth);
+void block_queue_print_stats(block_device_t* device);
+
+#endif // BLOCK_DEVICE_H 
@@ -11,7 +11,11 @@ bool font_loader_init(const char* font_file);
 // Clean up font resources
 void font_loader_cleanup(void);
 
-// Get the bitmap data for a character
+// Tallest glyph kept in the glyph cache
+#define FONT_MAX_HEIGHT 32
+
+// Get the bitmap data for a character: one byte (8 pixels, MSB first)
+// per row, from the glyph cache built when the font is loaded
 const uint8_t* font_get_char_bitmap(char c);
 
 // Get the width of a character
@@ -20,6 +24,20 @@ int font_get_char_width(char c);
 // Get the height of a character
 int font_get_char_height(char c);
 
+// Height of every glyph in the active font
+int font_get_height(void);
+
+// 8 dwords for one glyph row, all ones where a pixel is set
+const uint32_t* font_row_mask(uint8_t bits);
+
+// One glyph row expanded to 32-bpp pixels
+typedef uint32_t font_row_t[8];
+
+// Glyph rows pre-expanded to 32-bpp fg/bg pixels, indexed by row bits.
+// A few color pairs are cached; the table stays valid until the next
+// call with a different pair evicts it.
+const font_row_t* font_color_rows(uint32_t fg, uint32_t bg);
+
 // Check if a character is available in either font
 bool font_is_char_available(char c);
 
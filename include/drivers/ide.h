@@ -0,0 +1,170 @@
+#ifndef IDE_H
+#define IDE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../io.h"
+#include "pci.h"
+
+// PIIX3 IDE function (PCI 8086:7010)
+#define PIIX3_IDE_VENDOR_ID  0x8086
+#define PIIX3_IDE_DEVICE_ID  0x7010
+#define PIIX3_IDE_CONFIG     0x40    // IDE timing registers
+#define PIIX3_IDE_BMIBA      0x20    // BAR4: bus master I/O base
+
+// Legacy channel ports
+#define IDE_PRIMARY_BASE     0x1F0
+#define IDE_PRIMARY_CTRL     0x3F6
+#define IDE_SECONDARY_BASE   0x170
+#define IDE_SECONDARY_CTRL   0x376
+
+// Register offsets from the channel base port
+#define IDE_DATA             0x00
+#define IDE_ERROR            0x01
+#define IDE_FEATURES         0x01
+#define IDE_SECTOR_COUNT     0x02
+#define IDE_LBA_LOW          0x03
+#define IDE_LBA_MID          0x04
+#define IDE_LBA_HIGH         0x05
+#define IDE_DRIVE_HEAD       0x06
+#define IDE_STATUS           0x07
+#define IDE_COMMAND          0x07
+
+// Commands
+#define IDE_CMD_READ_SECTORS       0x20
+#define IDE_CMD_READ_SECTORS_EXT   0x24
+#define IDE_CMD_WRITE_SECTORS      0x30
+#define IDE_CMD_WRITE_SECTORS_EXT  0x34
+#define IDE_CMD_READ_DMA           0xC8
+#define IDE_CMD_READ_DMA_EXT       0x25
+#define IDE_CMD_WRITE_DMA          0xCA
+#define IDE_CMD_WRITE_DMA_EXT      0x35
+#define IDE_CMD_FLUSH_CACHE        0xE7
+#define IDE_CMD_IDENTIFY           0xEC
+
+// Status register bits
+#define IDE_SR_BSY    0x80    // Busy
+#define IDE_SR_DRDY   0x40    // Drive ready
+#define IDE_SR_DF     0x20    // Drive write fault
+#define IDE_SR_DSC    0x10    // Drive seek complete
+#define IDE_SR_DRQ    0x08    // Data request ready
+#define IDE_SR_CORR   0x04    // Corrected data
+#define IDE_SR_IDX    0x02    // Index
+#define IDE_SR_ERR    0x01    // Error
+
+// Drive/Head register bits
+#define IDE_DRIVE_MASTER   0xA0
+#define IDE_DRIVE_SLAVE    0xB0
+#define IDE_DRIVE_LBA      0x40
+
+// Bus master IDE registers, from the BAR4 base (+8 for the secondary)
+#define IDE_BM_COMMAND     0x00
+#define IDE_BM_STATUS      0x02
+#define IDE_BM_PRDT        0x04
+
+#define IDE_BM_CMD_START   0x01
+#define IDE_BM_CMD_READ    0x08    // Device to memory
+
+#define IDE_BM_SR_ACTIVE   0x01
+#define IDE_BM_SR_ERR      0x02    // Write 1 to clear
+#define IDE_BM_SR_IRQ      0x04    // Write 1 to clear
+#define IDE_BM_SR_DMA_CAP  0x60    // Drive 0/1 DMA capable, set by firmware
+
+// Physical Region Descriptor: one physically contiguous piece of a DMA
+// transfer. A region may not cross a 64 KB boundary; a count of 0 is 64 KB.
+struct ide_prd {
+    uint32_t base;
+    uint16_t count;
+    uint16_t flags;
+} __attribute__((packed));
+
+#define IDE_PRD_EOT        0x8000  // Last descriptor of the table
+
+// Ticks (10 ms) to wait for a command's interrupt before resetting
+#define IDE_TIMEOUT        500
+
+// Largest transfer of one READ/WRITE SECTORS command (count register 0)
+#define IDE_MAX_SECTORS    256
+
+typedef enum {
+    IDE_DEVICE_NONE,
+    IDE_DEVICE_ATA
+} ide_device_type_t;
+
+typedef struct {
+    uint16_t base_port;
+    uint16_t ctrl_port;
+    bool present;                  // Any drive answered IDENTIFY
+    ide_device_type_t device_type;
+    bool drive_present[2];         // Master, slave
+    uint32_t drive_sectors[2];     // Capacity from IDENTIFY
+    bool drive_dma[2];             // IDENTIFY reports DMA support
+    uint16_t bmide_port;           // Bus master registers, 0 without DMA
+} ide_channel_t;
+
+typedef struct {
+    ide_channel_t primary;
+    ide_channel_t secondary;
+    bool initialized;
+} ide_controller_t;
+
+// Controller setup
+bool ide_init(void);
+bool ide_detect_devices(void);
+bool ide_identify_device(uint8_t channel, uint8_t drive);
+void ide_print_device_info(uint8_t channel, uint8_t drive);
+bool ide_is_initialized(void);
+bool ide_channel_has_devices(uint8_t channel);
+bool ide_drive_present(uint8_t channel, uint8_t drive);
+uint32_t ide_get_total_sectors(uint8_t channel, uint8_t drive);
+void ide_get_piiX3_location(uint8_t* bus, uint8_t* slot, uint8_t* func);
+
+// One transfer of 1 to IDE_MAX_SECTORS sectors, queued on its channel
+struct ide_request;
+typedef void (*ide_callback_t)(struct ide_request* request);
+
+struct ide_request {
+    uint8_t channel;
+    uint8_t drive;
+    bool write;
+    uint64_t lba;
+    uint16_t sectors;
+    void* buffer;
+    void* context;              // For the callback
+    // Set by the driver
+    volatile bool done;
+    bool ok;
+    ide_callback_t callback;
+    struct ide_request* next;
+};
+
+// Queue a request; it starts when the channel is done with the ones
+// before it. Returns false for a bad request. The callback (may be NULL)
+// runs from the IRQ handler when the request completes, and must not
+// sleep. The request must stay valid until then.
+bool ide_submit(struct ide_request* request, ide_callback_t callback);
+
+// Sleep until a submitted request completes and return request->ok. A
+// channel that stays silent for IDE_TIMEOUT ticks is reset, failing its
+// current request.
+bool ide_wait(struct ide_request* request);
+
+// Synchronous transfers of up to IDE_MAX_SECTORS sectors. Bus master DMA
+// is used when the controller and drive support it, PIO otherwise.
+bool ide_read_sectors(uint8_t channel, uint8_t drive, uint64_t lba, uint16_t sectors, void* buffer);
+bool ide_write_sectors(uint8_t channel, uint8_t drive, uint64_t lba, uint16_t sectors, const void* buffer);
+bool ide_dma_enabled(uint8_t channel, uint8_t drive);
+
+// IRQ14/IRQ15 handler, called from the stubs in idt.asm. Advances the
+// channel's active request and starts the next one.
+void ide_irq_handler(uint8_t channel);
+
+// Diagnostics (ide_test.c)
+void test_ide_driver(void);
+void init_storage_system(void);
+bool read_boot_sector(void* buffer);
+void test_secondary_ide_channel(void);
+void test_ide_channel_status(void);
+void ide_diagnostic_test(void);
+
+#endif // IDE_H
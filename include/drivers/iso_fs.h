@@ -16,6 +16,12 @@ void iso_fs_set_base(uint32_t base);
 // Set the size of the filesystem
 void iso_fs_set_size(uint32_t size);
 
+// Get the size of the filesystem in bytes
+uint32_t iso_fs_get_size(void);
+
+// Address of sectors inside the image, or NULL if they run past its end
+const void* iso_fs_map_sectors(uint32_t lba, uint32_t sectors);
+
 // Read sectors from the ISO filesystem
 bool iso_fs_read_sectors(uint32_t lba, uint8_t sectors, void* buffer);
 
@@ -103,6 +103,20 @@ void vbe_draw_string_wrapped(struct vbe_text_context* ctx, const char* str, int
 void vbe_draw_string_scroll(struct vbe_text_context* ctx, const char* str, int max_width, int max_height);
 uint32_t vbe_get_pixel(int x, int y);
 
+// Back buffer. Once vbe_init_back_buffer succeeds every vbe_* primitive
+// draws into RAM and only the changed rows are copied to the framebuffer.
+// Drawing calls between vbe_begin_update and vbe_end_update are presented
+// together when the outermost batch ends.
+bool vbe_init_back_buffer(void);
+void vbe_present(void);
+void vbe_begin_update(void);
+void vbe_end_update(void);
+void vbe_invalidate(void);
+
+// Framebuffer caching and throughput
+bool vbe_enable_write_combining(void);
+void vbe_bench(void);
+
 // Terminal color functions
 void vbe_setcolor(uint32_t color);
 uint32_t vbe_getcolor(void);
@@ -120,9 +134,19 @@ void terminal_clear(void);
 void terminal_putchar(char c);
 void terminal_putentryat(char c, uint8_t color, size_t x, size_t y);
 void terminal_writestring(const char* data);
+void terminal_write(const char* data, size_t size);
 void terminal_writehex(uint32_t n);
 void terminal_get_cursor(size_t* x, size_t* y);
 void terminal_update_cursor(void);
+void terminal_putchar_color(char c, uint32_t color);
+void terminal_writestring_color(const char* data, uint32_t color);
+
+// Text console cells (8x16 pixels each). The terminal keeps a character
+// grid with scrollback; these write it without moving the cursor.
+void terminal_putcell(size_t x, size_t y, char c, uint32_t color);
+void terminal_writestring_at(size_t x, size_t y, const char* data, uint32_t color);
+void terminal_clear_to_eol(void);
+void terminal_scroll_view(int lines);
 
 // ANSI support
 void ansi_set_enabled(bool enabled);
@@ -0,0 +1,98 @@
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Transitional virtio-blk PCI device, driven through its legacy I/O BAR
+#define VIRTIO_VENDOR_ID          0x1AF4
+#define VIRTIO_BLK_DEVICE_ID      0x1001
+
+// Legacy virtio-pci registers, from BAR0 (I/O)
+#define VIRTIO_PCI_HOST_FEATURES  0x00
+#define VIRTIO_PCI_GUEST_FEATURES 0x04
+#define VIRTIO_PCI_QUEUE_PFN      0x08
+#define VIRTIO_PCI_QUEUE_SIZE     0x0C
+#define VIRTIO_PCI_QUEUE_SELECT   0x0E
+#define VIRTIO_PCI_QUEUE_NOTIFY   0x10
+#define VIRTIO_PCI_STATUS         0x12
+#define VIRTIO_PCI_ISR            0x13
+#define VIRTIO_PCI_CONFIG         0x14    // Device config without MSI-X
+
+#define VIRTIO_STATUS_ACK         0x01
+#define VIRTIO_STATUS_DRIVER      0x02
+#define VIRTIO_STATUS_DRIVER_OK   0x04
+#define VIRTIO_STATUS_FAILED      0x80
+
+// Feature bits
+#define VIRTIO_BLK_F_SEG_MAX      (1u << 2)
+#define VIRTIO_BLK_F_RO           (1u << 5)
+#define VIRTIO_BLK_F_FLUSH        (1u << 9)
+#define VIRTIO_F_INDIRECT_DESC    (1u << 28)
+#define VIRTIO_F_EVENT_IDX        (1u << 29)
+
+// virtio_blk_config offsets in the device config area
+#define VIRTIO_BLK_CFG_CAPACITY   0x00    // 64-bit, in 512 byte sectors
+#define VIRTIO_BLK_CFG_SEG_MAX    0x0C
+
+// Split virtqueue
+struct virtq_desc {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed));
+
+#define VIRTQ_DESC_F_NEXT         1
+#define VIRTQ_DESC_F_WRITE        2       // Device writes this buffer
+#define VIRTQ_DESC_F_INDIRECT     4
+
+struct virtq_avail {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];                      // Followed by used_event
+} __attribute__((packed));
+
+#define VIRTQ_AVAIL_F_NO_INTERRUPT 1
+
+struct virtq_used_elem {
+    uint32_t id;
+    uint32_t len;
+} __attribute__((packed));
+
+struct virtq_used {
+    uint16_t flags;
+    uint16_t idx;
+    struct virtq_used_elem ring[];        // Followed by avail_event
+} __attribute__((packed));
+
+#define VIRTQ_USED_F_NO_NOTIFY    1
+
+// Request header and types
+struct virtio_blk_req {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed));
+
+#define VIRTIO_BLK_T_IN           0
+#define VIRTIO_BLK_T_OUT          1
+#define VIRTIO_BLK_T_FLUSH        4
+#define VIRTIO_BLK_S_OK           0
+
+#define VIRTIO_BLK_DEPTH          32      // Requests in flight
+#define VIRTIO_BLK_SEGS           64      // Data segments per request
+#define VIRTIO_BLK_REQ_SECTORS    256     // Sectors per request
+#define VIRTIO_BLK_TIMEOUT        500     // Ticks (10 ms) before a transfer fails
+
+// Find and set up the first virtio-blk device
+bool virtio_blk_init(void);
+bool virtio_blk_is_initialized(void);
+uint32_t virtio_blk_get_total_sectors(void);
+
+// Transfer any number of sectors as up to VIRTIO_BLK_DEPTH requests in
+// flight, each described by one indirect descriptor
+bool virtio_blk_read_sectors(uint64_t sector, uint32_t count, void* buffer);
+bool virtio_blk_write_sectors(uint64_t sector, uint32_t count, const void* buffer);
+
+#endif // VIRTIO_BLK_H
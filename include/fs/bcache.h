@@ -0,0 +1,82 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../drivers/block_device.h"
+
+// Buffer cache between the filesystem and its block device. The device
+// is cached in blocks of 'block_sectors' sectors counted from
+// 'base_sector', so with FAT16 every data cluster is exactly one block.
+// Sectors below 'base_sector' are passed straight to the device.
+
+#define BCACHE_BLOCKS       128   // Cached blocks
+#define BCACHE_FLUSH_TICKS  300   // Dirty blocks are written back every 3 seconds
+
+struct bcache_buf {
+    uint32_t block;       // Block number
+    uint8_t* data;        // block_sectors * sector size bytes
+    uint16_t refcount;    // Pins; pinned buffers are never evicted
+    bool valid;
+    bool dirty;
+    bool referenced;      // CLOCK reference bit
+    bool busy;            // Read-ahead still in flight
+    int16_t hash_next;
+    struct bio bio;       // Write-back or read-ahead in the request queue
+};
+
+struct bcache_stats {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+    uint32_t writebacks;  // Dirty blocks written to the device
+    uint32_t flushes;
+    uint32_t direct_reads;  // Device reads that bypassed the cache
+};
+
+// Set up the cache for a device. Dirty blocks of a previous device are
+// written back first.
+bool bcache_init(block_device_t* device, uint32_t base_sector, uint32_t block_sectors);
+
+// Get the pinned buffer of the block starting at 'lba', reading it in on a
+// miss. 'lba' must be block aligned. Every bcache_get needs a bcache_release.
+struct bcache_buf* bcache_get(uint32_t lba);
+
+// Like bcache_get, but a miss doesn't read the block: for callers that
+// overwrite all of it. The contents are undefined until then.
+struct bcache_buf* bcache_get_nofill(uint32_t lba);
+void bcache_release(struct bcache_buf* buf);
+void bcache_mark_dirty(struct bcache_buf* buf);
+
+// Copy sectors through the cache. Writes are written back later.
+bool bcache_read(uint32_t lba, uint32_t count, void* buffer);
+bool bcache_write(uint32_t lba, uint32_t count, const void* buffer);
+
+// Read sectors for a bulk transfer without caching them. Blocks already
+// cached are copied from the cache; each stretch of uncached sectors
+// between them is one device read straight into 'buffer'.
+bool bcache_read_direct(uint32_t lba, uint32_t count, void* buffer);
+
+// Load the blocks of a sector range that are not cached yet, for
+// read-ahead. Sectors below the cached area are ignored. The reads go
+// through the device's request queue, so neighbouring blocks are merged,
+// and on devices with asynchronous transfers they complete in the
+// background; a lookup of a block still in flight waits for it.
+void bcache_prefetch(uint32_t lba, uint32_t count);
+
+// Write back every dirty block, as merged and sorted queue requests
+bool bcache_flush(void);
+
+// Write back the dirty blocks overlapping a sector range, so the device
+// holds current data for readers that bypass the cache
+bool bcache_sync(uint32_t lba, uint32_t count);
+
+// Called from idle loops; completes finished read-ahead and flushes once
+// BCACHE_FLUSH_TICKS have passed
+void bcache_periodic(uint32_t ticks);
+
+uint32_t bcache_block_size(void);
+void bcache_get_stats(struct bcache_stats* stats);
+void bcache_print_stats(void);
+
+#endif // BCACHE_H
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "../drivers/block_device.h"
 
 // FAT16 Boot Sector structure
 typedef struct {
@@ -40,6 +41,29 @@ typedef struct {
     uint32_t file_size;
 } __attribute__((packed)) fat16_dir_entry_t;
 
+// Run of physically contiguous clusters in a file
+struct fat16_run {
+    uint32_t index;            // Position of the run in the file, in clusters
+    uint16_t cluster;          // First cluster of the run
+    uint16_t length;           // Clusters in the run
+};
+
+// VFAT long name entry. A long name is stored as fragments of 13 UCS-2
+// characters in the entries before its 8.3 entry, last fragment first.
+typedef struct {
+    uint8_t order;             // Fragment number, FAT16_LFN_LAST on the last
+    uint16_t name1[5];
+    uint8_t attributes;        // Always FAT16_ATTR_LONG_NAME
+    uint8_t type;
+    uint8_t checksum;          // Of the 8.3 name
+    uint16_t name2[6];
+    uint16_t starting_cluster; // Always 0
+    uint16_t name3[2];
+} __attribute__((packed)) fat16_lfn_entry_t;
+
+#define FAT16_LFN_LAST  0x40
+#define FAT16_MAX_NAME  255
+
 // FAT16 File structure
 struct fat16_file {
     uint16_t starting_cluster;  // First cluster of the file
@@ -47,6 +71,39 @@ struct fat16_file {
     uint32_t position;         // Current position in file
     uint16_t current_cluster;  // Current cluster being read
     uint32_t cluster_offset;   // Offset within current cluster
+    uint32_t cluster_index;    // Position of current_cluster in the chain
+    uint32_t readahead_index;  // Clusters before this one were read ahead
+    uint16_t dir_cluster;      // Directory holding the entry (0 = root)
+    uint16_t dir_index;        // Entry slot in that directory
+    struct fat16_run* runs;    // Chain mapped so far, built as it is walked
+    uint32_t run_count;
+    uint32_t run_capacity;
+    uint32_t mapped_clusters;  // Clusters covered by runs
+};
+
+#define FAT16_SEEK_SET 0
+#define FAT16_SEEK_CUR 1
+#define FAT16_SEEK_END 2
+
+#define FAT16_READAHEAD 8      // Clusters read ahead by sequential reads
+
+// Run of file data in memory
+struct fat16_extent {
+    const uint8_t* data;
+    uint32_t length;
+};
+
+#define FAT16_MAP_EXTENTS 16
+
+// A file mapped for reading. When the volume lives in RAM the extents
+// point straight into the image; otherwise, or when the file has more
+// fragments than FAT16_MAP_EXTENTS, it is read into one heap buffer.
+// The mapping is only valid until the file is written or removed.
+struct fat16_map {
+    uint32_t size;       // File size in bytes
+    int count;           // Extents in use
+    struct fat16_extent extents[FAT16_MAP_EXTENTS];
+    uint8_t* copy;       // Heap buffer behind the extents, or NULL
 };
 
 // File attributes
@@ -60,6 +117,8 @@ struct fat16_file {
 
 // Function prototypes
 bool fat16_init(void);
+bool fat16_mount(block_device_t* device);
+block_device_t* fat16_get_device(void);
 bool fat16_read_root_dir(void);
 int fat16_read_file(const char* filename, void* buffer, uint32_t max_size);
 bool fat16_write_file(const char* filename, const void* buffer, uint32_t size);
@@ -68,19 +127,36 @@ bool fat16_delete_file(const char* filename);
 bool fat16_list_directory(const char* path);
 bool fat16_remove_file(const char* filename);
 
-// Directory functions
+// Directory functions. Paths are relative to the current directory
+// unless they start with '/'. Subdirectories grow as entries are added;
+// fat16_rmdir only removes empty directories.
 bool fat16_read_directory(uint16_t cluster, fat16_dir_entry_t* entries, int max_entries);
 bool fat16_change_directory(const char* path, uint16_t* current_cluster);
+bool fat16_mkdir(const char* path);
+bool fat16_rmdir(const char* path);
 
 // Helper functions
 uint16_t fat16_get_next_cluster(uint16_t cluster);
 bool fat16_is_end_of_chain(uint16_t cluster);
 uint32_t fat16_cluster_to_lba(uint16_t cluster);
 const char* get_file_type(const fat16_dir_entry_t* entry);
+uint32_t fat16_get_free_clusters(void);
 
-// File operations
+// File operations. Handles track their position and cache the cluster
+// holding it; fat16_read and fat16_write return the bytes transferred,
+// or -1 on error. Writes extend the file and update its directory entry.
+// Every opened handle must be closed to free its run list.
 int fat16_open_file(const char* filename, struct fat16_file* file);
 void fat16_close_file(struct fat16_file* file);
+int fat16_read(struct fat16_file* file, void* buffer, uint32_t size);
+int fat16_write(struct fat16_file* file, const void* buffer, uint32_t size);
+int fat16_seek(struct fat16_file* file, int32_t offset, int whence);
 uint32_t fat16_get_file_size(const char* filename);
 
+// Zero-copy reads. fat16_map_read gathers bytes across extents and
+// returns how many were copied.
+bool fat16_map_file(const char* filename, struct fat16_map* map);
+void fat16_unmap_file(struct fat16_map* map);
+uint32_t fat16_map_read(const struct fat16_map* map, uint32_t offset, void* buffer, uint32_t size);
+
 #endif // FAT16_H 
\ No newline at end of file
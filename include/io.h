@@ -14,4 +14,22 @@ uint32_t inl(uint16_t port);
 /* I/O Wait */
 void io_wait(void);
 
+/* CPU identification */
+void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx);
+
+/* Control registers */
+uint32_t read_cr0(void);
+void write_cr0(uint32_t value);
+uint32_t read_cr2(void);
+uint32_t read_cr3(void);
+void write_cr3(uint32_t value);
+uint32_t read_cr4(void);
+void write_cr4(uint32_t value);
+void invlpg(void* addr);
+
+/* Model-specific registers and caches */
+uint64_t rdmsr(uint32_t msr);
+void wrmsr(uint32_t msr, uint64_t value);
+void wbinvd(void);
+
 #endif /* IO_H */ 
\ No newline at end of file
@@ -2,6 +2,20 @@
 #define HEAP_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+// Fixed heap window; the PMM keeps these pages out of its free pool
+#define HEAP_START 0x2000000  // Start at 32MB
+#define HEAP_SIZE 0x1000000   // 16MB heap size
+
+// Heap usage counters
+struct heap_stats {
+    size_t bytes_in_use;    // Bytes handed out (rounded to size class or page)
+    size_t pages_used;      // Heap window pages backing slabs and large blocks
+    size_t pages_total;     // Pages in the heap window
+    uint32_t allocations;   // Successful allocations
+    uint32_t frees;         // Successful frees
+};
 
 // Initialize the heap
 void heap_init(void);
@@ -12,10 +26,28 @@ void* malloc(size_t size);
 // Free previously allocated memory
 void free(void* ptr);
 
+// Resize a heap allocation
+void* realloc(void* ptr, size_t size);
+
+// Allocate zeroed memory for an array
+void* calloc(size_t count, size_t size);
+
 // Allocate memory from the kernel heap
 void* kmalloc(size_t size);
 
 // Free memory allocated from the kernel heap
 void kfree(void* ptr);
 
-#endif // HEAP_H 
\ No newline at end of file
+// Resize a kernel heap allocation, moving it if needed
+void* krealloc(void* ptr, size_t size);
+
+// Allocate zeroed memory for an array from the kernel heap
+void* kcalloc(size_t count, size_t size);
+
+// Get the usable size of a kernel heap allocation
+size_t kmalloc_usable_size(void* ptr);
+
+// Get heap usage counters
+void heap_get_stats(struct heap_stats* stats);
+
+#endif // HEAP_H 
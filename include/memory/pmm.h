@@ -3,12 +3,13 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 
 // Memory page size (4KB)
 #define PAGE_SIZE 4096
 
 // Initialize the physical memory manager
-void pmm_init(void);
+void pmm_init(void* multiboot_info);
 
 // Allocate a single physical page
 void* pmm_alloc_page(void);
@@ -16,13 +17,37 @@ void* pmm_alloc_page(void);
 // Free a single physical page
 void pmm_free_page(void* page);
 
+// Allocate 'count' physically contiguous pages. 'align' is the required
+// alignment of the first page in bytes (0 or PAGE_SIZE for none).
+void* pmm_alloc_pages(size_t count, size_t align);
+
+// Free 'count' contiguous pages starting at 'base'
+void pmm_free_pages(void* base, size_t count);
+
+// Mark a physical range as used so it is never handed out.
+// Partially covered pages are reserved whole.
+bool pmm_reserve_range(uint64_t base, uint64_t length);
+
+// Largest block order tracked (2^10 pages = 4MB). Build with PMM_BUDDY
+// defined to use the buddy allocator instead of the bitmap scan.
+#define PMM_MAX_ORDER 10
+
+// Number of free blocks of each order (0..PMM_MAX_ORDER)
+void pmm_get_order_counts(size_t counts[PMM_MAX_ORDER + 1]);
+
+// Percentage (0-100) of free memory unusable for a block of 2^order pages
+uint32_t pmm_get_fragmentation(uint32_t order);
+
 // Get the total number of available pages
 size_t pmm_get_total_pages(void);
 
 // Get the number of free pages
 size_t pmm_get_free_pages(void);
 
-// Map physical address to virtual address
+// Get the end of the highest usable physical page
+uint64_t pmm_get_memory_top(void);
+
+// Map physical address to virtual address (RAM is identity mapped)
 void* pmm_map_physical_to_virtual(uint32_t physical_addr);
 
 #endif // PMM_H 
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include "vmm.h"
 
 // Program entry point type
 typedef void (*program_entry_t)(void);
@@ -14,7 +15,11 @@ struct program {
     void* data_segment;      // Data segment address
     size_t code_size;        // Size of code segment
     size_t data_size;        // Size of data segment
-    program_entry_t entry;   // Entry point
+    program_entry_t entry;   // Entry point, at its address in the loaded code
+    void* load_base;         // Address the code was loaded from
+    struct vmm_address_space* address_space;  // Private address space (NULL without paging)
+    void* code_base;         // Code segment address inside the address space
+    void* data_base;         // Data segment address inside the address space
 };
 
 // Load a program from memory
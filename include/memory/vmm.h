@@ -0,0 +1,75 @@
+#ifndef VMM_H
+#define VMM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Page table entry flags accepted by the mapping functions
+#define VMM_WRITE           0x002   // Writable
+#define VMM_USER            0x004   // Accessible from ring 3
+#define VMM_WRITE_THROUGH   0x008   // Write-through caching
+#define VMM_NO_CACHE        0x010   // Caching disabled (MMIO registers)
+#define VMM_WRITE_COMBINING 0x200   // Write-combining through PAT (framebuffers)
+
+// Virtual address layout
+#define VMM_KERNEL_TOP   0xC0000000  // RAM below this is identity mapped
+#define VMM_PROCESS_BASE 0xC0000000  // Per-process private window
+#define VMM_PROCESS_END  0xD0000000
+#define VMM_DYNAMIC_BASE 0xD0000000  // Kernel window for vmm_alloc_region
+#define VMM_DYNAMIC_END  0xE0000000
+
+// An address space is a page directory. The kernel part of every
+// address space is shared; only the process window differs.
+struct vmm_address_space {
+    uint32_t* page_directory;
+};
+
+// Build the kernel page directory and turn on paging
+void vmm_init(void);
+
+// Check if paging is enabled
+bool vmm_is_enabled(void);
+
+// Map one 4KB page (space NULL = kernel address space)
+bool vmm_map(struct vmm_address_space* space, void* virt, uint32_t phys, uint32_t flags);
+
+// Remove the mapping of one 4KB page
+void vmm_unmap(struct vmm_address_space* space, void* virt);
+
+// Translate a virtual address, returns 0 if it is not mapped
+uint32_t vmm_get_physical(struct vmm_address_space* space, void* virt);
+
+// Allocate and map 'size' bytes of fresh pages in the kernel dynamic window
+void* vmm_alloc_region(size_t size, uint32_t flags);
+
+// Unmap a region from vmm_alloc_region and free its pages
+void vmm_free_region(void* addr, size_t size);
+
+// Identity map a device memory range, using 4MB pages where possible
+void* vmm_map_mmio(uint32_t phys, size_t size, uint32_t flags);
+
+// Change the cache type of an existing kernel mapping. 'cache_flags' is a
+// combination of VMM_WRITE_THROUGH, VMM_NO_CACHE and VMM_WRITE_COMBINING.
+bool vmm_set_cache_flags(void* virt, size_t size, uint32_t cache_flags);
+
+// Make an identity-mapped range write-combining, through PAT if the CPU
+// has it, otherwise through a free variable MTRR
+bool vmm_set_write_combining(uint32_t phys, size_t size);
+
+// Check if PAT was programmed (VMM_WRITE_COMBINING usable in mappings)
+bool vmm_has_pat(void);
+
+// Create an address space sharing the kernel mappings
+struct vmm_address_space* vmm_create_address_space(void);
+
+// Free an address space and its page tables (not the pages mapped in it)
+void vmm_destroy_address_space(struct vmm_address_space* space);
+
+// Load an address space (NULL = kernel address space)
+void vmm_switch_address_space(struct vmm_address_space* space);
+
+// Page fault handler called from the ISR stub
+void page_fault_handler(uint32_t fault_addr, uint32_t error_code, uint32_t eip);
+
+#endif // VMM_H
@@ -2,6 +2,7 @@
 #define STRING_H
 
 #include <stddef.h>
+#include <stdbool.h>
 #include <stdarg.h>
 
 // Convert integer to string in the given base
@@ -13,6 +14,9 @@ int strcmp(const char* s1, const char* s2);
 // Compare two strings up to n characters
 int strncmp(const char* s1, const char* s2, size_t n);
 
+// Copy string
+char* strcpy(char* dest, const char* src);
+
 // Find first occurrence of character in string
 char* strchr(const char* str, int c);
 
@@ -22,9 +26,21 @@ char* strrchr(const char* str, int c);
 // Set memory to a specific value
 void* memset(void* dest, int val, size_t count);
 
+// Pick the memory routine strategy from CPUID (call once at boot)
+void string_init(void);
+
+// Check if the memory routines use SSE2
+bool string_has_sse2(void);
+
+// Copy memory between non-overlapping buffers
+void* memcpy(void* dest, const void* src, size_t count);
+
 // Move memory from one location to another
 void* memmove(void* dest, const void* src, size_t n);
 
+// Compare memory regions
+int memcmp(const void* ptr1, const void* ptr2, size_t count);
+
 // Minimal vsnprintf and snprintf
 int vsnprintf(char* str, size_t size, const char* format, va_list ap);
 int snprintf(char* str, size_t size, const char* format, ...);
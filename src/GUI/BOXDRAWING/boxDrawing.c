@@ -10,30 +10,31 @@
 #define BOX_HORIZONTAL   0xC0
 #define BOX_VERTICAL     0xC1
 
-// Draw a box at the specified position with the given dimensions
+// Draw a box at the specified position with the given dimensions, in
+// console cells so it stays part of the terminal text
 void draw_box(int x, int y, int width, int height, uint32_t color) {
     // Draw top border
-    vbe_draw_char_font_loader(x * 8, y * 16, BOX_TOP_LEFT, color);
+    terminal_putcell(x, y, BOX_TOP_LEFT, color);
     for (int i = 1; i < width - 1; i++) {
-        vbe_draw_char_font_loader((x + i) * 8, y * 16, BOX_HORIZONTAL, color);
+        terminal_putcell(x + i, y, BOX_HORIZONTAL, color);
     }
-    vbe_draw_char_font_loader((x + width - 1) * 8, y * 16, BOX_TOP_RIGHT, color);
+    terminal_putcell(x + width - 1, y, BOX_TOP_RIGHT, color);
 
     // Draw sides
     for (int i = 1; i < height - 1; i++) {
         // Left side
-        vbe_draw_char_font_loader(x * 8, (y + i) * 16, BOX_VERTICAL, color);
+        terminal_putcell(x, y + i, BOX_VERTICAL, color);
         
         // Right side
-        vbe_draw_char_font_loader((x + width - 1) * 8, (y + i) * 16, BOX_VERTICAL, color);
+        terminal_putcell(x + width - 1, y + i, BOX_VERTICAL, color);
     }
 
     // Draw bottom border
-    vbe_draw_char_font_loader(x * 8, (y + height - 1) * 16, BOX_BOTTOM_LEFT, color);
+    terminal_putcell(x, y + height - 1, BOX_BOTTOM_LEFT, color);
     for (int i = 1; i < width - 1; i++) {
-        vbe_draw_char_font_loader((x + i) * 8, (y + height - 1) * 16, BOX_HORIZONTAL, color);
+        terminal_putcell(x + i, y + height - 1, BOX_HORIZONTAL, color);
     }
-    vbe_draw_char_font_loader((x + width - 1) * 8, (y + height - 1) * 16, BOX_BOTTOM_RIGHT, color);
+    terminal_putcell(x + width - 1, y + height - 1, BOX_BOTTOM_RIGHT, color);
 }
 
 // Draw a box with text centered inside it
@@ -46,5 +47,5 @@ void draw_box_with_text(int x, int y, int width, int height, const char* text, u
     int text_y = y + (height - 1) / 2;
 
     // Draw the text
-    vbe_draw_string_font_loader(text_x * 8, text_y * 16, text, text_color);
+    terminal_writestring_at(text_x, text_y, text, text_color);
 } 
\ No newline at end of file
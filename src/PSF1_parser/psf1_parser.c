@@ -1,59 +1,65 @@
 #include "../include/PSF1_parser/psf1_parser.h"
+#include "../include/drivers/font_loader.h"
 #include "../include/fs/fat16.h"
 #include "../include/memory/heap.h"
 #include <stdbool.h>
 #include <stdint.h>
 
 PSF1Font* load_psf1(const char* path) {
-    // Read the file into a buffer
-    uint8_t* buffer = malloc(4096);  // 4KB buffer should be enough for most PSF1 fonts
-    if (!buffer) {
-        terminal_writestring("Failed to allocate memory for font file\n");
-        return NULL;
-    }
-
-    int result = fat16_read_file(path, buffer, 4096);
-    if (result <= 0) {
+    // Map the file instead of reading it into a buffer
+    struct fat16_map map;
+    if (!fat16_map_file(path, &map) || map.size == 0) {
         terminal_writestring("Failed to read font file\n");
-        free(buffer);
+        fat16_unmap_file(&map);
         return NULL;
     }
 
     // Parse the header
-    PSF1Header* header = (PSF1Header*)buffer;
-    if (header->magic[0] != PSF1_MAGIC0 || header->magic[1] != PSF1_MAGIC1) {
+    PSF1Header header;
+    if (fat16_map_read(&map, 0, &header, sizeof(PSF1Header)) != sizeof(PSF1Header) ||
+        header.magic[0] != PSF1_MAGIC0 || header.magic[1] != PSF1_MAGIC1) {
         terminal_writestring("Not a valid PSF1 font\n");
-        free(buffer);
+        fat16_unmap_file(&map);
         return NULL;
     }
 
-    size_t glyph_count = (header->mode & 0x01) ? 512 : 256;
-    size_t glyph_size = header->char_height;
+    size_t glyph_count = (header.mode & 0x01) ? 512 : 256;
+    size_t glyph_size = header.char_height;
     size_t total_size = glyph_count * glyph_size;
+    if (map.size < sizeof(PSF1Header) + total_size) {
+        terminal_writestring("Font file is truncated\n");
+        fat16_unmap_file(&map);
+        return NULL;
+    }
     
     // Allocate memory for the font structure
     PSF1Font* font = malloc(sizeof(PSF1Font));
     if (!font) {
         terminal_writestring("Failed to allocate memory for font structure\n");
-        free(buffer);
+        fat16_unmap_file(&map);
         return NULL;
     }
+    font->header = header;
+    font->glyph_count = glyph_count;
     
-    // Allocate memory for glyphs
-    font->glyphs = malloc(total_size);
-    if (!font->glyphs) {
-        terminal_writestring("Failed to allocate memory for glyphs\n");
-        free(font);
-        free(buffer);
-        return NULL;
+    // Glyphs in one mapped extent are used where they are. Otherwise, or
+    // when the file had to be copied, they get their own allocation.
+    if (!map.copy && map.extents[0].length >= sizeof(PSF1Header) + total_size) {
+        font->glyphs = (uint8_t*)map.extents[0].data + sizeof(PSF1Header);
+        font->storage = NULL;
+    } else {
+        font->glyphs = malloc(total_size);
+        if (!font->glyphs) {
+            terminal_writestring("Failed to allocate memory for glyphs\n");
+            free(font);
+            fat16_unmap_file(&map);
+            return NULL;
+        }
+        fat16_map_read(&map, sizeof(PSF1Header), font->glyphs, total_size);
+        font->storage = font->glyphs;
     }
     
-    // Copy the header and glyph data
-    font->header = *header;
-    font->glyph_count = glyph_count;
-    memcpy(font->glyphs, buffer + sizeof(PSF1Header), total_size);
-    
-    free(buffer);
+    fat16_unmap_file(&map);
     return font;
 }
 
@@ -65,21 +71,28 @@ void render_glyph_vbe(const PSF1Font* font, int index, uint32_t* framebuffer, in
     }
 
     uint8_t* glyph = &font->glyphs[index * font->header.char_height];
+    const font_row_t* lut = font_color_rows(VBE_WHITE, VBE_BLACK);
+    int stride = fb_pitch / 4;
+    int limit = fb_width * stride;  // Same pixel bound as the old per-pixel check
+
+    // Clip once for the whole glyph, then copy pre-expanded rows
+    int col0 = x < 0 ? -x : 0;
+    int col1 = x + 8 > fb_width ? fb_width - x : 8;
     for (int row = 0; row < font->header.char_height; row++) {
-        uint8_t bits = glyph[row];
-        for (int col = 0; col < 8; col++) {
-            int pixel_on = bits & (0x80 >> col);
-            int fb_index = (y + row) * (fb_pitch / 4) + (x + col);
-            if (fb_index >= 0 && fb_index < (fb_width * fb_pitch / 4)) {
-                framebuffer[fb_index] = pixel_on ? VBE_WHITE : VBE_BLACK;
-            }
+        int line = y + row;
+        if (line < 0) continue;
+        if (line * stride + x + col1 > limit) break;
+        const uint32_t* src = lut[glyph[row]];
+        uint32_t* dst = framebuffer + line * stride + x;
+        for (int col = col0; col < col1; col++) {
+            dst[col] = src[col];
         }
     }
 }
 
 void free_psf1(PSF1Font* font) {
     if (font) {
-        free(font->glyphs);
+        free(font->storage);
         free(font);
     }
 }
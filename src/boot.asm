@@ -34,6 +34,24 @@ _start:
     push ebx    ; Multiboot info structure
     push eax    ; Multiboot magic number
 
+    ; Enable the FPU: no emulation (EM), monitor coprocessor (MP),
+    ; native error reporting (NE)
+    mov ecx, cr0
+    and ecx, ~((1 << 2) | (1 << 3))
+    or ecx, (1 << 1) | (1 << 5)
+    mov cr0, ecx
+    fninit
+
+    ; Enable SSE if the CPU has it: OSFXSR and OSXMMEXCPT in CR4
+    mov eax, 1
+    cpuid
+    test edx, 1 << 25
+    jz .no_sse
+    mov ecx, cr4
+    or ecx, (1 << 9) | (1 << 10)
+    mov cr4, ecx
+.no_sse:
+
     ; Call kernel main
     call kernel_main
 
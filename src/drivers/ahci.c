@@ -0,0 +1,424 @@
+#include "../../include/drivers/ahci.h"
+#include "../../include/drivers/pci.h"
+#include "../../include/io.h"
+#include "../../include/stdio.h"
+#include "../../include/string.h"
+#include "../../include/timerDriver.h"
+#include "../../include/memory/pmm.h"
+#include "../../include/memory/vmm.h"
+#include <stddef.h>
+
+static uint8_t* abar = NULL;
+static uint32_t hba_cap;
+static uint8_t hba_slots;
+static bool initialized = false;
+static ahci_port_t ports[AHCI_MAX_PORTS];
+
+static inline uint32_t ahci_read32(uint8_t* addr) {
+    return *((volatile uint32_t*)addr);
+}
+
+static inline void ahci_write32(uint8_t* addr, uint32_t value) {
+    *((volatile uint32_t*)addr) = value;
+}
+
+// Wait for bits of a register to clear, for at most 'ms' milliseconds
+static bool ahci_wait_clear(uint8_t* reg, uint32_t mask, uint32_t ms) {
+    for (uint32_t i = 0; i < ms * 1000; i++) {
+        if (!(ahci_read32(reg) & mask)) {
+            return true;
+        }
+        io_wait();
+    }
+    return false;
+}
+
+// Physical address of a buffer byte. RAM below VMM_KERNEL_TOP is
+// identity mapped; the windows above it have to be translated.
+static uint32_t ahci_physical(const uint8_t* addr) {
+    if ((uint32_t)addr < VMM_KERNEL_TOP) {
+        return (uint32_t)addr;
+    }
+    return vmm_get_physical(NULL, (void*)addr);
+}
+
+static void ahci_stop_port(ahci_port_t* port) {
+    uint8_t* cmd = port->regs + AHCI_PxCMD;
+    ahci_write32(cmd, ahci_read32(cmd) & ~AHCI_PxCMD_ST);
+    ahci_wait_clear(cmd, AHCI_PxCMD_CR, 500);
+    ahci_write32(cmd, ahci_read32(cmd) & ~AHCI_PxCMD_FRE);
+    ahci_wait_clear(cmd, AHCI_PxCMD_FR, 500);
+}
+
+static void ahci_start_port(ahci_port_t* port) {
+    uint8_t* cmd = port->regs + AHCI_PxCMD;
+    ahci_wait_clear(cmd, AHCI_PxCMD_CR, 500);
+    ahci_write32(port->regs + AHCI_PxSERR, 0xFFFFFFFF);
+    ahci_write32(port->regs + AHCI_PxIS, 0xFFFFFFFF);
+    ahci_write32(cmd, ahci_read32(cmd) | AHCI_PxCMD_FRE);
+    ahci_write32(cmd, ahci_read32(cmd) | AHCI_PxCMD_ST);
+}
+
+// Describe up to 'bytes' of a buffer in a command table's PRDs, merging
+// physically contiguous pages. Returns the bytes covered, which is less
+// than asked for when the PRDs run out.
+static uint32_t ahci_build_prdt(struct ahci_cmd_table* table, uint8_t* buffer, uint32_t bytes, uint16_t* prds) {
+    uint32_t done = 0;
+    int n = -1;
+    uint32_t next_phys = 0;
+    while (done < bytes) {
+        uint32_t phys = ahci_physical(buffer + done);
+        uint32_t chunk = PAGE_SIZE - (phys & (PAGE_SIZE - 1));
+        if (chunk > bytes - done) chunk = bytes - done;
+
+        if (n >= 0 && phys == next_phys && table->prdt[n].dbc + 1 + chunk <= 0x400000) {
+            table->prdt[n].dbc += chunk;
+        } else {
+            if (n + 1 == AHCI_PRDS) break;
+            n++;
+            table->prdt[n].dba = phys;
+            table->prdt[n].dbau = 0;
+            table->prdt[n].reserved = 0;
+            table->prdt[n].dbc = chunk - 1;
+        }
+        next_phys = phys + chunk;
+        done += chunk;
+    }
+    *prds = n + 1;
+    return done;
+}
+
+// Fill a slot's command header and FIS. Returns the sectors the command
+// covers (possibly fewer than 'count'), 0 on a bad buffer.
+static uint32_t ahci_prepare(ahci_port_t* port, int slot, uint8_t command, uint64_t lba,
+                             uint32_t count, uint8_t* buffer, bool write) {
+    struct ahci_cmd_table* table = &port->tables[slot];
+    struct ahci_cmd_header* header = &port->cmd_list[slot];
+
+    uint16_t prds = 0;
+    if (count) {
+        // Trim a partly described last sector off the end
+        uint32_t bytes = ahci_build_prdt(table, buffer, count * 512, &prds);
+        uint32_t extra = bytes % 512;
+        while (extra) {
+            uint32_t length = table->prdt[prds - 1].dbc + 1;
+            if (length > extra) {
+                table->prdt[prds - 1].dbc -= extra;
+                break;
+            }
+            extra -= length;
+            prds--;
+        }
+        count = bytes / 512;
+        if (count == 0) return 0;
+    }
+
+    struct ahci_fis_h2d* fis = (struct ahci_fis_h2d*)table->cfis;
+    memset(fis, 0, sizeof(*fis));
+    fis->type = AHCI_FIS_REG_H2D;
+    fis->flags = 0x80;
+    fis->command = command;
+    fis->lba0 = lba & 0xFF;
+    fis->lba1 = (lba >> 8) & 0xFF;
+    fis->lba2 = (lba >> 16) & 0xFF;
+    fis->lba3 = (lba >> 24) & 0xFF;
+    fis->lba4 = (lba >> 32) & 0xFF;
+    fis->lba5 = (lba >> 40) & 0xFF;
+    if (command == AHCI_CMD_READ_FPDMA || command == AHCI_CMD_WRITE_FPDMA) {
+        // NCQ: the count moves to the features, the tag into the count
+        fis->feature_low = count & 0xFF;
+        fis->feature_high = (count >> 8) & 0xFF;
+        fis->count_low = slot << 3;
+        fis->device = 0x40;
+    } else if (command != AHCI_CMD_IDENTIFY) {
+        fis->count_low = count & 0xFF;
+        fis->count_high = (count >> 8) & 0xFF;
+        fis->device = 0x40;
+    }
+
+    header->flags = (sizeof(struct ahci_fis_h2d) / 4) | (write ? AHCI_HEADER_WRITE : 0);
+    header->prdtl = prds;
+    header->prdbc = 0;
+    return count ? count : 1;
+}
+
+// Clear an error: restart the port so its command list can be used again
+static void ahci_recover(ahci_port_t* port) {
+    ahci_stop_port(port);
+    ahci_start_port(port);
+}
+
+// Issue one non-queued command in slot 0 and wait for it
+static bool ahci_run(ahci_port_t* port) {
+    ahci_write32(port->regs + AHCI_PxIS, 0xFFFFFFFF);
+    ahci_write32(port->regs + AHCI_PxCI, 1);
+
+    uint32_t start = timer_get_ticks();
+    uint32_t spins = 0;
+    while (ahci_read32(port->regs + AHCI_PxCI) & 1) {
+        if (ahci_read32(port->regs + AHCI_PxIS) & AHCI_PxIS_TFES ||
+            timer_get_ticks() - start > AHCI_TIMEOUT || ++spins > 50000000) {
+            ahci_recover(port);
+            return false;
+        }
+    }
+    return !(ahci_read32(port->regs + AHCI_PxIS) & AHCI_PxIS_TFES);
+}
+
+static bool ahci_identify(ahci_port_t* port) {
+    uint16_t identify[256];
+    ahci_prepare(port, 0, AHCI_CMD_IDENTIFY, 0, 1, (uint8_t*)identify, false);
+    if (!ahci_run(port)) {
+        return false;
+    }
+
+    // Capacity as in the IDE driver: LBA48 count when supported
+    port->sectors = identify[60] | ((uint32_t)identify[61] << 16);
+    if ((identify[83] & (1 << 10)) && identify[102] == 0 && identify[103] == 0) {
+        port->sectors = identify[100] | ((uint32_t)identify[101] << 16);
+    } else if (identify[83] & (1 << 10)) {
+        port->sectors = 0xFFFFFFFF;  // Larger than 2 TB, clamp
+    }
+
+    // Word 76 bit 8: NCQ; word 75: queue depth - 1
+    port->ncq = (hba_cap & AHCI_CAP_SNCQ) && (identify[76] & (1 << 8));
+    port->depth = hba_slots;
+    if (port->ncq && (identify[75] & 0x1F) + 1 < port->depth) {
+        port->depth = (identify[75] & 0x1F) + 1;
+    }
+    return true;
+}
+
+// Give a port its command list, FIS area and command tables, then start it
+static bool ahci_port_setup(int index) {
+    ahci_port_t* port = &ports[index];
+    port->regs = abar + AHCI_PORT_BASE + index * AHCI_PORT_SIZE;
+    ahci_stop_port(port);
+
+    // 1 KB command list and 256 byte FIS area share a page; the
+    // 256 byte tables are 128-byte aligned by construction
+    uint32_t table_pages = (AHCI_MAX_SLOTS * sizeof(struct ahci_cmd_table) + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint8_t* page = (uint8_t*)pmm_alloc_pages(1, PAGE_SIZE);
+    port->tables = (struct ahci_cmd_table*)pmm_alloc_pages(table_pages, PAGE_SIZE);
+    if (!page || !port->tables) {
+        printf("AHCI: out of memory for port %d\n", index);
+        if (page) pmm_free_pages(page, 1);
+        if (port->tables) pmm_free_pages(port->tables, table_pages);
+        port->regs = NULL;
+        return false;
+    }
+    memset(page, 0, PAGE_SIZE);
+    memset(port->tables, 0, table_pages * PAGE_SIZE);
+    port->cmd_list = (struct ahci_cmd_header*)page;
+    port->fis = page + 1024;
+
+    for (int slot = 0; slot < AHCI_MAX_SLOTS; slot++) {
+        port->cmd_list[slot].ctba = (uint32_t)&port->tables[slot];
+        port->cmd_list[slot].ctbau = 0;
+    }
+    ahci_write32(port->regs + AHCI_PxCLB, (uint32_t)port->cmd_list);
+    ahci_write32(port->regs + AHCI_PxCLBU, 0);
+    ahci_write32(port->regs + AHCI_PxFB, (uint32_t)port->fis);
+    ahci_write32(port->regs + AHCI_PxFBU, 0);
+    ahci_write32(port->regs + AHCI_PxIE, 0);  // Completion is polled
+    ahci_start_port(port);
+
+    if (!ahci_identify(port)) {
+        printf("AHCI: port %d did not answer IDENTIFY\n", index);
+        ahci_stop_port(port);
+        port->regs = NULL;
+        return false;
+    }
+    printf("AHCI: port %d: %u sectors, %s, %u commands in flight\n", index, port->sectors,
+           port->ncq ? "NCQ" : "no NCQ", port->depth);
+    return true;
+}
+
+// Keep up to port->depth commands of at most AHCI_CMD_SECTORS in flight
+// until the whole range is done. NCQ commands finish in any order; a slot
+// is free again once the drive cleared it from both SACT and CI.
+static bool ahci_transfer(int index, uint64_t lba, uint32_t count, uint8_t* buffer, bool write) {
+    if (index < 0 || index >= AHCI_MAX_PORTS || !ports[index].regs || ((uint32_t)buffer & 1)) {
+        return false;
+    }
+    ahci_port_t* port = &ports[index];
+    uint8_t command;
+    if (port->ncq) {
+        command = write ? AHCI_CMD_WRITE_FPDMA : AHCI_CMD_READ_FPDMA;
+    } else {
+        command = write ? AHCI_CMD_WRITE_DMA_EXT : AHCI_CMD_READ_DMA_EXT;
+    }
+
+    uint32_t busy = 0;
+    uint32_t in_flight = 0;
+    uint32_t start = timer_get_ticks();
+    uint32_t spins = 0;
+    ahci_write32(port->regs + AHCI_PxIS, 0xFFFFFFFF);
+    while (count || busy) {
+        while (count && in_flight < port->depth) {
+            int slot = __builtin_ctz(~busy);
+            uint32_t n = count > AHCI_CMD_SECTORS ? AHCI_CMD_SECTORS : count;
+            n = ahci_prepare(port, slot, command, lba, n, buffer, write);
+            if (n == 0) {
+                count = 0;  // Odd-sized piece of a buffer; fail after draining
+                break;
+            }
+            if (port->ncq) {
+                ahci_write32(port->regs + AHCI_PxSACT, 1u << slot);
+            }
+            ahci_write32(port->regs + AHCI_PxCI, 1u << slot);
+            busy |= 1u << slot;
+            in_flight++;
+            lba += n;
+            count -= n;
+            buffer += n * 512;
+        }
+
+        if (ahci_read32(port->regs + AHCI_PxIS) & AHCI_PxIS_TFES) {
+            ahci_recover(port);
+            return false;
+        }
+        uint32_t active = ahci_read32(port->regs + AHCI_PxCI);
+        if (port->ncq) {
+            active |= ahci_read32(port->regs + AHCI_PxSACT);
+        }
+        uint32_t finished = busy & ~active;
+        if (finished) {
+            busy &= active;
+            for (; finished; finished &= finished - 1) {
+                in_flight--;
+            }
+            start = timer_get_ticks();
+            spins = 0;
+        } else if (timer_get_ticks() - start > AHCI_TIMEOUT || ++spins > 50000000) {
+            printf("AHCI: port %d timed out\n", index);
+            ahci_recover(port);
+            return false;
+        }
+    }
+    if (count) {
+        return false;
+    }
+
+    // Writes are durable once the drive's cache is flushed
+    if (write) {
+        ahci_prepare(port, 0, AHCI_CMD_FLUSH_CACHE_EXT, 0, 0, NULL, false);
+        return ahci_run(port);
+    }
+    return true;
+}
+
+bool ahci_read_sectors(int port, uint64_t lba, uint32_t count, void* buffer) {
+    return ahci_transfer(port, lba, count, (uint8_t*)buffer, false);
+}
+
+bool ahci_write_sectors(int port, uint64_t lba, uint32_t count, const void* buffer) {
+    return ahci_transfer(port, lba, count, (uint8_t*)buffer, true);
+}
+
+// Find the AHCI controller by class code
+static bool find_ahci_controller(uint8_t* bus_out, uint8_t* slot_out, uint8_t* func_out) {
+    for (int bus = 0; bus < 256; bus++) {
+        for (int device = 0; device < 32; device++) {
+            for (int function = 0; function < 8; function++) {
+                uint16_t vendor = pci_config_read(bus, device, function, 0x00) & 0xFFFF;
+                if (vendor == 0xFFFF) {
+                    continue;
+                }
+                uint32_t class_code = pci_config_read(bus, device, function, 0x08);
+                if (((class_code >> 24) & 0xFF) == PCI_CLASS_STORAGE &&
+                    ((class_code >> 16) & 0xFF) == PCI_SUBCLASS_SATA &&
+                    ((class_code >> 8) & 0xFF) == PCI_INTERFACE_AHCI) {
+                    *bus_out = bus;
+                    *slot_out = device;
+                    *func_out = function;
+                    printf("Found AHCI controller at PCI %d:%d.%d\n", bus, device, function);
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+bool ahci_init(void) {
+    if (initialized) {
+        return true;
+    }
+
+    uint8_t bus, slot, func;
+    if (!find_ahci_controller(&bus, &slot, &func)) {
+        printf("AHCI controller not found\n");
+        return false;
+    }
+
+    // ABAR must be mapped uncached; enable memory space and bus mastering
+    uint32_t bar5 = pci_config_read(bus, slot, func, AHCI_PCI_ABAR) & 0xFFFFFFF0;
+    abar = (uint8_t*)vmm_map_mmio(bar5, AHCI_PORT_BASE + AHCI_MAX_PORTS * AHCI_PORT_SIZE,
+                                  VMM_WRITE | VMM_NO_CACHE);
+    if (!abar) {
+        return false;
+    }
+    uint32_t command = pci_config_read(bus, slot, func, 0x04);
+    pci_config_write(bus, slot, func, 0x04, (command & 0xFFFF) | 0x06);
+
+    // Reset the HBA, then switch it to AHCI mode with interrupts off
+    ahci_write32(abar + AHCI_HBA_GHC, AHCI_GHC_AE);
+    ahci_write32(abar + AHCI_HBA_GHC, AHCI_GHC_AE | AHCI_GHC_HR);
+    if (!ahci_wait_clear(abar + AHCI_HBA_GHC, AHCI_GHC_HR, 1000)) {
+        printf("AHCI: HBA reset timed out\n");
+        return false;
+    }
+    ahci_write32(abar + AHCI_HBA_GHC, AHCI_GHC_AE);
+
+    hba_cap = ahci_read32(abar + AHCI_HBA_CAP);
+    hba_slots = ((hba_cap >> AHCI_CAP_NCS_SHIFT) & 0x1F) + 1;
+    uint32_t implemented = ahci_read32(abar + AHCI_HBA_PI);
+    uint32_t version = ahci_read32(abar + AHCI_HBA_VS);
+    printf("AHCI %u.%u: %u command slots%s\n", version >> 16, (version >> 8) & 0xFF, hba_slots,
+           (hba_cap & AHCI_CAP_SNCQ) ? ", NCQ" : "");
+
+    // COMRESET after the HBA reset takes a moment to bring links up
+    timer_delay_ms(10);
+
+    int disks = 0;
+    for (int i = 0; i < AHCI_MAX_PORTS; i++) {
+        ports[i].regs = NULL;
+        if (!(implemented & (1u << i))) continue;
+
+        uint8_t* regs = abar + AHCI_PORT_BASE + i * AHCI_PORT_SIZE;
+        if ((ahci_read32(regs + AHCI_PxSSTS) & AHCI_PxSSTS_DET) != AHCI_DET_PRESENT ||
+            ahci_read32(regs + AHCI_PxSIG) != AHCI_SIG_ATA) {
+            continue;  // Empty, or ATAPI
+        }
+        if (ahci_port_setup(i)) {
+            disks++;
+        }
+    }
+
+    initialized = true;
+    if (disks == 0) {
+        printf("AHCI: no disks\n");
+    }
+    return true;
+}
+
+bool ahci_is_initialized(void) {
+    return initialized;
+}
+
+int ahci_first_disk(void) {
+    for (int i = 0; i < AHCI_MAX_PORTS; i++) {
+        if (ports[i].regs) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint32_t ahci_get_total_sectors(int port) {
+    if (port < 0 || port >= AHCI_MAX_PORTS || !ports[port].regs) {
+        return 0;
+    }
+    return ports[port].sectors;
+}
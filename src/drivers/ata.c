@@ -1,4 +1,5 @@
 #include "../../include/drivers/ata.h"
+#include "../../include/drivers/ide.h"
 #include "../../include/io.h"
 #include "../../include/drivers/vbe.h"
 #include <stdbool.h>
@@ -79,103 +80,19 @@ bool ata_init(void) {
     return true;
 }
 
-// Read sectors from the drive
+// Transfers go through the IDE driver's queue for the primary master, so
+// they complete on IRQ14 (and use DMA when available) instead of polling
+// the same ports behind the IDE driver's back
 bool ata_read_sectors(uint32_t lba, uint8_t sectors, void* buffer) {
-    if (!ata_wait_ready()) {
+    if (!ide_is_initialized() && !ide_init()) {
         return false;
     }
-
-    // Set up the command
-    outb(ATA_DRIVE_HEAD, ATA_DRIVE_MASTER | ATA_DRIVE_LBA | ((lba >> 24) & 0x0F));
-    outb(ATA_SECTOR_CNT, sectors);
-    outb(ATA_LBA_LOW, lba & 0xFF);
-    outb(ATA_LBA_MID, (lba >> 8) & 0xFF);
-    outb(ATA_LBA_HIGH, (lba >> 16) & 0xFF);
-    outb(ATA_COMMAND, ATA_CMD_READ_SECTORS);
-
-    // Read the data
-    uint16_t* data = (uint16_t*)buffer;
-    for (int i = 0; i < sectors; i++) {
-        if (!ata_wait_data()) {
-            return false;
-        }
-
-        // Read 256 words (512 bytes) per sector
-        for (int j = 0; j < 256; j++) {
-            data[j] = inw(ATA_DATA);
-        }
-        data += 256;
-    }
-
-    return true;
+    return ide_read_sectors(0, 0, lba, sectors, buffer);
 }
 
-// Write sectors to the drive
 bool ata_write_sectors(uint32_t lba, uint8_t sectors, const void* buffer) {
-    if (!ata_wait_ready()) {
+    if (!ide_is_initialized() && !ide_init()) {
         return false;
     }
-
-    // Set up the command
-    outb(ATA_DRIVE_HEAD, ATA_DRIVE_MASTER | ATA_DRIVE_LBA | ((lba >> 24) & 0x0F));
-    outb(ATA_SECTOR_CNT, sectors);
-    outb(ATA_LBA_LOW, lba & 0xFF);
-    outb(ATA_LBA_MID, (lba >> 8) & 0xFF);
-    outb(ATA_LBA_HIGH, (lba >> 16) & 0xFF);
-    outb(ATA_COMMAND, ATA_CMD_WRITE_SECTORS);
-
-    // Write the data
-    const uint16_t* data = (const uint16_t*)buffer;
-    for (int i = 0; i < sectors; i++) {
-        if (!ata_wait_data()) {
-            return false;
-        }
-
-        // Write 256 words (512 bytes) per sector
-        for (int j = 0; j < 256; j++) {
-            outw(ATA_DATA, data[j]);
-        }
-        data += 256;
-
-        // Check for errors after each sector
-        uint8_t status = inb(ATA_STATUS);
-        if (status & ATA_SR_ERR) {
-            return false;
-        }
-    }
-
-    // Wait for the write to complete with timeout
-    uint32_t timeout = 1000000;  // Adjust timeout value as needed
-    while (timeout--) {
-        uint8_t status = inb(ATA_STATUS);
-        if (!(status & ATA_SR_BSY)) {
-            break;
-        }
-        if (status & ATA_SR_ERR) {
-            return false;
-        }
-    }
-    if (timeout == 0) {
-        return false;  // Timeout occurred
-    }
-
-    // Flush the write cache
-    outb(ATA_COMMAND, 0xE7);  // FLUSH CACHE command
-    
-    // Wait for flush to complete with timeout
-    timeout = 1000000;  // Adjust timeout value as needed
-    while (timeout--) {
-        uint8_t status = inb(ATA_STATUS);
-        if (!(status & ATA_SR_BSY)) {
-            break;
-        }
-        if (status & ATA_SR_ERR) {
-            return false;
-        }
-    }
-    if (timeout == 0) {
-        return false;  // Timeout occurred
-    }
-
-    return true;
-} 
\ No newline at end of file
+    return ide_write_sectors(0, 0, lba, sectors, buffer);
+}
@@ -32,43 +32,60 @@ static int parse_decimal(const char* str) {
     return value;
 }
 
+#define BDF_MAX_LINE 256
+
+// Read position in a mapped BDF file
+struct bdf_cursor {
+    int extent;
+    uint32_t offset;
+};
+
+// Copy the next line into 'line' without its newline. Lines may cross
+// extents; overlong lines are cut at BDF_MAX_LINE - 1 characters.
+static bool bdf_next_line(const struct fat16_map* map, struct bdf_cursor* cursor, char* line) {
+    int length = 0;
+    bool any = false;
+    while (cursor->extent < map->count) {
+        const struct fat16_extent* extent = &map->extents[cursor->extent];
+        if (cursor->offset >= extent->length) {
+            cursor->extent++;
+            cursor->offset = 0;
+            continue;
+        }
+        char c = extent->data[cursor->offset++];
+        any = true;
+        if (c == '\n') break;
+        if (length < BDF_MAX_LINE - 1) {
+            line[length++] = c;
+        }
+    }
+    line[length] = '\0';
+    return any;
+}
+
 bool bdf_load_font(const char* filename, struct bdf_font* font) {
     // Initialize font structure
     memset(font, 0, sizeof(struct bdf_font));
     
-    // First, get the file size
-    terminal_writestring("Getting font file size...\n");
-    uint32_t file_size = fat16_get_file_size(filename);
-    if (file_size == 0) {
+    // Map the file; lines are copied out one at a time while parsing
+    terminal_writestring("Mapping font file...\n");
+    struct fat16_map map;
+    if (!fat16_map_file(filename, &map) || map.size == 0) {
         terminal_writestring("Error: Font file not found or empty\n");
+        fat16_unmap_file(&map);
         return false;
     }
     
     terminal_writestring("Font file size: ");
     char size_str[32];
-    sprintf(size_str, "%d bytes\n", file_size);
+    sprintf(size_str, "%d bytes\n", map.size);
     terminal_writestring(size_str);
     
-    // Allocate buffer for the file
-    uint8_t* buffer = (uint8_t*)kmalloc(file_size);
-    if (!buffer) {
-        terminal_writestring("Error: Failed to allocate memory for font file\n");
-        return false;
-    }
-    
-    // Read the file
-    terminal_writestring("Reading font file...\n");
-    if (!fat16_read_file(filename, buffer, file_size)) {
-        terminal_writestring("Error: Failed to read font file\n");
-        kfree(buffer);
-        return false;
-    }
-    
     terminal_writestring("Parsing BDF file...\n");
     
     // Parse the BDF file
-    char* line = (char*)buffer;
-    char* end = (char*)(buffer + file_size);
+    char line[BDF_MAX_LINE];
+    struct bdf_cursor cursor = {0, 0};
     bool in_char = false;
     int current_char = 0;
     int bitmap_row = 0;
@@ -76,11 +93,7 @@ bool bdf_load_font(const char* filename, struct bdf_font* font) {
     int max_height = 0;
     
     // First pass: determine font properties and count characters
-    while (line < end) {
-        char* next_line = strchr(line, '\n');
-        if (!next_line) break;
-        *next_line = '\0';
-        
+    while (bdf_next_line(&map, &cursor, line)) {
         if (strncmp(line, "FONTBOUNDINGBOX", 15) == 0) {
             char* width_str = line + 16;
             char* height_str = strchr(width_str, ' ');
@@ -99,8 +112,6 @@ bool bdf_load_font(const char* filename, struct bdf_font* font) {
             in_char = false;
             current_char++;
         }
-        
-        line = next_line + 1;
     }
     
     // Allocate font data
@@ -123,7 +134,8 @@ bool bdf_load_font(const char* filename, struct bdf_font* font) {
     memset(font->data, 0, font->data_size);
     
     // Second pass: parse character data
-    line = (char*)buffer;
+    cursor.extent = 0;
+    cursor.offset = 0;
     in_char = false;
     current_char = 0;
     bitmap_row = 0;
@@ -135,11 +147,7 @@ bool bdf_load_font(const char* filename, struct bdf_font* font) {
     sprintf(dims, "%dx%d\n", max_width, max_height);
     terminal_writestring(dims);
     
-    while (line < end) {
-        char* next_line = strchr(line, '\n');
-        if (!next_line) break;
-        *next_line = '\0';
-        
+    while (bdf_next_line(&map, &cursor, line)) {
         if (strncmp(line, "STARTCHAR", 9) == 0) {
             in_char = true;
             bitmap_row = 0;
@@ -191,8 +199,6 @@ bool bdf_load_font(const char* filename, struct bdf_font* font) {
                 terminal_writestring("Finished reading 'A'\n");
             }
         }
-        
-        line = next_line + 1;
     }
     
     terminal_writestring("Font parsing complete\n");
@@ -203,7 +209,7 @@ bool bdf_load_font(const char* filename, struct bdf_font* font) {
     sprintf(dims, "%d\n", font->last_char);
     terminal_writestring(dims);
     
-    kfree(buffer);
+    fat16_unmap_file(&map);
     return true;
 }
 
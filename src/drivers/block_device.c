@@ -1,45 +1,537 @@
 #include "../../include/drivers/block_device.h"
+#include "../../include/drivers/ahci.h"
 #include "../../include/drivers/ide.h"
+#include "../../include/drivers/iso_fs.h"
+#include "../../include/drivers/virtio_blk.h"
+#include "../../include/memory/heap.h"
+#include "../../include/stdio.h"
+#include "../../include/string.h"
 #include <stddef.h>
 
 // Global block device interface
 block_device_t* current_block_device = NULL;
 
-// IDE block device implementation
+// ISO RAM image block device implementation. iso_fs takes at most 255
+// sectors per call.
+static bool block_device_iso_read_sectors(uint32_t start_sector, uint32_t count, void* buffer) {
+    uint8_t* out = (uint8_t*)buffer;
+    while (count) {
+        uint8_t n = count > 255 ? 255 : count;
+        if (!iso_fs_read_sectors(start_sector, n, out)) {
+            return false;
+        }
+        start_sector += n;
+        count -= n;
+        out += n * 512;
+    }
+    return true;
+}
+
+static bool block_device_iso_write_sectors(uint32_t start_sector, uint32_t count, const void* buffer) {
+    const uint8_t* in = (const uint8_t*)buffer;
+    while (count) {
+        uint8_t n = count > 255 ? 255 : count;
+        if (!iso_fs_write_sectors(start_sector, n, in)) {
+            return false;
+        }
+        start_sector += n;
+        count -= n;
+        in += n * 512;
+    }
+    return true;
+}
+
+static uint32_t block_device_iso_get_total_sectors(void) {
+    return iso_fs_get_size() / 512;
+}
+
+static const void* block_device_iso_map_sectors(uint32_t start_sector, uint32_t count) {
+    return iso_fs_map_sectors(start_sector, count);
+}
+
+// IDE block device implementation, split into commands of IDE_MAX_SECTORS
 static bool block_device_ide_read_sectors(uint32_t start_sector, uint32_t count, void* buffer) {
-    return ide_read_sectors(0, 0, start_sector, count, buffer);  // Using primary master
+    uint8_t* out = (uint8_t*)buffer;
+    while (count) {
+        uint16_t n = count > IDE_MAX_SECTORS ? IDE_MAX_SECTORS : count;
+        if (!ide_read_sectors(0, 0, start_sector, n, out)) {  // Using primary master
+            return false;
+        }
+        start_sector += n;
+        count -= n;
+        out += n * 512;
+    }
+    return true;
 }
 
 static bool block_device_ide_write_sectors(uint32_t start_sector, uint32_t count, const void* buffer) {
-    return ide_write_sectors(0, 0, start_sector, count, buffer);  // Using primary master
+    const uint8_t* in = (const uint8_t*)buffer;
+    while (count) {
+        uint16_t n = count > IDE_MAX_SECTORS ? IDE_MAX_SECTORS : count;
+        if (!ide_write_sectors(0, 0, start_sector, n, in)) {  // Using primary master
+            return false;
+        }
+        start_sector += n;
+        count -= n;
+        in += n * 512;
+    }
+    return true;
 }
 
 static uint32_t block_device_ide_get_total_sectors(void) {
-    // For now, return a reasonable default size (1GB = 2,097,152 sectors)
-    // In a real implementation, you'd get this from the drive's identify data
-    return 2097152;  // 1GB in sectors
+    return ide_get_total_sectors(0, 0);
+}
+
+// AHCI block device implementation on the first SATA disk. The driver
+// splits transfers into queued commands itself.
+static int ahci_disk = -1;
+
+static bool block_device_ahci_read_sectors(uint32_t start_sector, uint32_t count, void* buffer) {
+    return ahci_read_sectors(ahci_disk, start_sector, count, buffer);
+}
+
+static bool block_device_ahci_write_sectors(uint32_t start_sector, uint32_t count, const void* buffer) {
+    return ahci_write_sectors(ahci_disk, start_sector, count, buffer);
+}
+
+static uint32_t block_device_ahci_get_total_sectors(void) {
+    return ahci_get_total_sectors(ahci_disk);
+}
+
+// virtio-blk block device implementation. The driver splits transfers
+// into requests kept in flight itself.
+static bool block_device_virtio_read_sectors(uint32_t start_sector, uint32_t count, void* buffer) {
+    return virtio_blk_read_sectors(start_sector, count, buffer);
+}
+
+static bool block_device_virtio_write_sectors(uint32_t start_sector, uint32_t count, const void* buffer) {
+    return virtio_blk_write_sectors(start_sector, count, buffer);
+}
+
+static uint16_t block_device_get_sector_size_512(void) {
+    return 512;  // Standard sector size for both backends
+}
+
+// Request queues, one per backend
+static struct block_queue iso_queue = { .depth = BLOCK_QUEUE_DEPTH };
+static struct block_queue ide_queue = { .depth = BLOCK_QUEUE_DEPTH };
+static struct block_queue ahci_queue = { .depth = BLOCK_QUEUE_DEPTH };
+static struct block_queue virtio_queue = { .depth = BLOCK_QUEUE_DEPTH };
+
+// Asynchronous IDE transfers: one driver request per queue slot, started
+// on the channel queue and completed from the IRQ handler
+static struct ide_request ide_ios[BLOCK_QUEUE_REQUESTS];
+
+static void block_device_ide_done(struct ide_request* io) {
+    struct block_request* request = (struct block_request*)io->context;
+    request->ok = io->ok;
+    request->done = true;
 }
 
-static uint16_t block_device_ide_get_sector_size(void) {
-    return 512;  // Standard sector size for IDE
+static bool block_device_ide_submit(struct block_request* request) {
+    struct ide_request* io = &ide_ios[request - ide_queue.requests];
+    if (request->count > IDE_MAX_SECTORS) {
+        return false;
+    }
+    io->channel = 0;  // Using primary master
+    io->drive = 0;
+    io->write = request->write;
+    io->lba = request->sector;
+    io->sectors = request->count;
+    io->buffer = request->buffer;
+    io->context = request;
+    return ide_submit(io, block_device_ide_done);
 }
 
+static void block_device_ide_wait(struct block_request* request) {
+    ide_wait(&ide_ios[request - ide_queue.requests]);
+}
+
+// ISO block device structure
+static block_device_t iso_device = {
+    .name = "iso",
+    .read_sectors = block_device_iso_read_sectors,
+    .write_sectors = block_device_iso_write_sectors,
+    .get_total_sectors = block_device_iso_get_total_sectors,
+    .get_sector_size = block_device_get_sector_size_512,
+    .map_sectors = block_device_iso_map_sectors,
+    .queue = &iso_queue
+};
+
 // IDE block device structure
 static block_device_t ide_device = {
+    .name = "ide",
     .read_sectors = block_device_ide_read_sectors,
     .write_sectors = block_device_ide_write_sectors,
     .get_total_sectors = block_device_ide_get_total_sectors,
-    .get_sector_size = block_device_ide_get_sector_size
+    .get_sector_size = block_device_get_sector_size_512,
+    .queue = &ide_queue,
+    .submit = block_device_ide_submit,
+    .wait = block_device_ide_wait
+};
+
+// AHCI block device structure
+static block_device_t ahci_device = {
+    .name = "ahci",
+    .read_sectors = block_device_ahci_read_sectors,
+    .write_sectors = block_device_ahci_write_sectors,
+    .get_total_sectors = block_device_ahci_get_total_sectors,
+    .get_sector_size = block_device_get_sector_size_512,
+    .queue = &ahci_queue
 };
 
+// virtio-blk block device structure
+static block_device_t virtio_device = {
+    .name = "virtio",
+    .read_sectors = block_device_virtio_read_sectors,
+    .write_sectors = block_device_virtio_write_sectors,
+    .get_total_sectors = virtio_blk_get_total_sectors,
+    .get_sector_size = block_device_get_sector_size_512,
+    .queue = &virtio_queue
+};
+
+block_device_t* block_device_iso(void) {
+    return &iso_device;
+}
+
+block_device_t* block_device_ide(void) {
+    if (!ide_is_initialized() && !ide_init()) {
+        return NULL;
+    }
+    if (!ide_drive_present(0, 0)) {
+        return NULL;
+    }
+    return &ide_device;
+}
+
+block_device_t* block_device_ahci(void) {
+    if (!ahci_is_initialized() && !ahci_init()) {
+        return NULL;
+    }
+    ahci_disk = ahci_first_disk();
+    if (ahci_disk < 0) {
+        return NULL;
+    }
+    return &ahci_device;
+}
+
+block_device_t* block_device_virtio(void) {
+    if (!virtio_blk_is_initialized() && !virtio_blk_init()) {
+        return NULL;
+    }
+    return &virtio_device;
+}
+
+block_device_t* block_device_get(const char* name) {
+    if (strcmp(name, "iso") == 0) {
+        return block_device_iso();
+    }
+    if (strcmp(name, "ide") == 0) {
+        return block_device_ide();
+    }
+    if (strcmp(name, "ahci") == 0) {
+        return block_device_ahci();
+    }
+    if (strcmp(name, "virtio") == 0) {
+        return block_device_virtio();
+    }
+    return NULL;
+}
+
+static bool device_transfer(block_device_t* device, bool write, uint32_t sector, uint32_t count, void* buffer) {
+    if (write) {
+        return device->write_sectors(sector, count, buffer);
+    }
+    return device->read_sectors(sector, count, buffer);
+}
+
+static void bio_complete(struct bio* bio, bool ok) {
+    bio->ok = ok;
+    bio->done = true;
+    if (bio->callback) {
+        bio->callback(bio);
+    }
+}
+
+static bool overlaps(uint32_t a, uint32_t a_count, uint32_t b, uint32_t b_count) {
+    return a < b + b_count && b < a + a_count;
+}
+
+static uint32_t count_bits(uint32_t bits) {
+    uint32_t n = 0;
+    for (; bits; bits &= bits - 1) {
+        n++;
+    }
+    return n;
+}
+
+// Requests waiting for dispatch
+static uint32_t queued_mask(struct block_queue* queue) {
+    return queue->used & ~queue->in_flight;
+}
+
+// C-LOOK: the lowest waiting request at or above the last position, or
+// the lowest of all once the sweep has passed every request
+static int pick_request(struct block_queue* queue) {
+    uint32_t queued = queued_mask(queue);
+    int next = -1, lowest = -1;
+    for (int i = 0; i < BLOCK_QUEUE_REQUESTS; i++) {
+        if (!(queued & (1u << i))) continue;
+        uint32_t sector = queue->requests[i].sector;
+        if (lowest < 0 || sector < queue->requests[lowest].sector) {
+            lowest = i;
+        }
+        if (sector >= queue->position && (next < 0 || sector < queue->requests[next].sector)) {
+            next = i;
+        }
+    }
+    return next >= 0 ? next : lowest;
+}
+
+// Free a finished request's slot and complete its bios. The slot is
+// freed first, so callbacks can submit more bios.
+static bool finish_request(block_device_t* device, int slot) {
+    struct block_queue* queue = device->queue;
+    struct block_request request = queue->requests[slot];
+    queue->used &= ~(1u << slot);
+    queue->in_flight &= ~(1u << slot);
+
+    if (request.bounce) {
+        uint32_t sector_size = device->get_sector_size ? device->get_sector_size() : 512;
+        uint8_t* at = request.bounce;
+        for (struct bio* bio = request.head; bio && request.ok && !request.write; bio = bio->next) {
+            memcpy(bio->buffer, at, bio->count * sector_size);
+            at += bio->count * sector_size;
+        }
+        free(request.bounce);
+    }
+
+    struct bio* bio = request.head;
+    while (bio) {
+        struct bio* next = bio->next;  // The callback may reuse the bio
+        bio_complete(bio, request.ok);
+        bio = next;
+    }
+    return request.ok;
+}
+
+// Send one request to the device. Asynchronous devices keep it in flight;
+// otherwise it is transferred and finished here. Returns false only for
+// a request that already failed.
+static bool dispatch_request(block_device_t* device, int slot) {
+    struct block_queue* queue = device->queue;
+    struct block_request* request = &queue->requests[slot];
+    queue->position = request->sector + request->count;
+    queue->stats.dispatched++;
+
+    uint32_t sector_size = device->get_sector_size ? device->get_sector_size() : 512;
+    bool contiguous = true;
+    for (struct bio* bio = request->head; bio->next; bio = bio->next) {
+        if ((uint8_t*)bio->buffer + bio->count * sector_size != bio->next->buffer) {
+            contiguous = false;
+            break;
+        }
+    }
+
+    request->bounce = NULL;
+    request->buffer = request->head->buffer;
+    if (!contiguous) {
+        // Scattered buffers still go out as one transfer, through a copy
+        request->bounce = (uint8_t*)malloc(request->count * sector_size);
+        if (!request->bounce) {
+            // No memory for the copy: one transfer per bio
+            queue->used &= ~(1u << slot);
+            bool ok = true;
+            struct bio* bio = request->head;
+            while (bio) {
+                struct bio* next = bio->next;
+                bool bio_ok = device_transfer(device, request->write, bio->sector, bio->count, bio->buffer);
+                ok = ok && bio_ok;
+                bio_complete(bio, bio_ok);
+                bio = next;
+            }
+            return ok;
+        }
+        queue->stats.bounced++;
+        request->buffer = request->bounce;
+        uint8_t* at = request->bounce;
+        for (struct bio* bio = request->head; bio && request->write; bio = bio->next) {
+            memcpy(at, bio->buffer, bio->count * sector_size);
+            at += bio->count * sector_size;
+        }
+    }
+
+    request->ok = false;
+    request->done = false;
+    queue->in_flight |= 1u << slot;
+    if (device->submit && device->submit(request)) {
+        queue->stats.async++;
+        return true;
+    }
+    request->ok = device_transfer(device, request->write, request->sector, request->count, request->buffer);
+    request->done = true;
+    return finish_request(device, slot);
+}
+
+// Finish every request the device is done with. False if one failed.
+static bool reap_requests(block_device_t* device) {
+    struct block_queue* queue = device->queue;
+    bool ok = true;
+    for (int i = 0; i < BLOCK_QUEUE_REQUESTS; i++) {
+        if ((queue->in_flight & (1u << i)) && queue->requests[i].done && !finish_request(device, i)) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// Move the queue forward by one step: dispatch the next waiting request,
+// or sleep until an in-flight one is done. False when the queue is empty.
+static bool queue_step(block_device_t* device, bool* ok) {
+    struct block_queue* queue = device->queue;
+    if (queued_mask(queue)) {
+        if (!dispatch_request(device, pick_request(queue))) {
+            *ok = false;
+        }
+    } else if (queue->in_flight) {
+        int slot = __builtin_ctz(queue->in_flight);
+        if (!queue->requests[slot].done) {
+            device->wait(&queue->requests[slot]);
+        }
+    } else {
+        return false;
+    }
+    if (!reap_requests(device)) {
+        *ok = false;
+    }
+    return true;
+}
+
+void block_submit(block_device_t* device, struct bio* bio) {
+    bio->ok = false;
+    bio->done = false;
+    bio->next = NULL;
+
+    struct block_queue* queue = device->queue;
+    if (!queue) {
+        bio_complete(bio, device_transfer(device, bio->write, bio->sector, bio->count, bio->buffer));
+        return;
+    }
+    queue->stats.submitted++;
+    reap_requests(device);
+
+    // Queued requests may be reordered, and in-flight ones may still be
+    // moving data, so conflicting ones go out and finish first
+    for (int i = 0; i < BLOCK_QUEUE_REQUESTS; i++) {
+        struct block_request* request = &queue->requests[i];
+        if ((queue->used & (1u << i)) && (request->write || bio->write) &&
+            overlaps(request->sector, request->count, bio->sector, bio->count)) {
+            block_queue_run(device);
+            break;
+        }
+    }
+
+    // Merge with a waiting request of the same direction ending where the
+    // bio starts, or starting where it ends
+    uint32_t queued = queued_mask(queue);
+    for (int i = 0; i < BLOCK_QUEUE_REQUESTS; i++) {
+        struct block_request* request = &queue->requests[i];
+        if (!(queued & (1u << i)) || request->write != bio->write ||
+            request->count + bio->count > BLOCK_MAX_REQUEST) {
+            continue;
+        }
+        if (request->sector + request->count == bio->sector) {
+            request->tail->next = bio;
+            request->tail = bio;
+        } else if (bio->sector + bio->count == request->sector) {
+            bio->next = request->head;
+            request->head = bio;
+            request->sector = bio->sector;
+        } else {
+            continue;
+        }
+        request->count += bio->count;
+        queue->stats.merged++;
+        return;
+    }
+
+    bool ok = true;
+    while (~queue->used == 0) {
+        queue_step(device, &ok);
+    }
+    int slot = __builtin_ctz(~queue->used);
+    struct block_request* request = &queue->requests[slot];
+    request->write = bio->write;
+    request->sector = bio->sector;
+    request->count = bio->count;
+    request->head = bio;
+    request->tail = bio;
+    queue->used |= 1u << slot;
+
+    if (count_bits(queued_mask(queue)) >= queue->depth) {
+        block_queue_kick(device);
+    }
+}
+
+void block_queue_kick(block_device_t* device) {
+    struct block_queue* queue = device->queue;
+    while (queue && queued_mask(queue)) {
+        dispatch_request(device, pick_request(queue));
+    }
+    block_queue_poll(device);
+}
+
+void block_queue_poll(block_device_t* device) {
+    if (device && device->queue) {
+        reap_requests(device);
+    }
+}
+
+bool block_queue_run(block_device_t* device) {
+    bool ok = true;
+    while (device->queue && queue_step(device, &ok)) {
+    }
+    return ok;
+}
+
+bool block_wait(block_device_t* device, struct bio* bio) {
+    bool ok = true;
+    while (!bio->done && device->queue && queue_step(device, &ok)) {
+    }
+    return bio->done && bio->ok;
+}
+
+void block_queue_set_depth(block_device_t* device, uint32_t depth) {
+    if (!device->queue) return;
+    if (depth < 1) depth = 1;
+    if (depth > BLOCK_QUEUE_REQUESTS) depth = BLOCK_QUEUE_REQUESTS;
+    device->queue->depth = depth;
+    if (count_bits(queued_mask(device->queue)) >= depth) {
+        block_queue_kick(device);
+    }
+}
+
+void block_queue_print_stats(block_device_t* device) {
+    struct block_queue* queue = device->queue;
+    if (!queue) {
+        printf("%s: no request queue\n", device->name);
+        return;
+    }
+    printf("Request queue (%s): depth %u, %u queued, %u in flight\n", device->name, queue->depth,
+           count_bits(queued_mask(queue)), count_bits(queue->in_flight));
+    printf("  Bios: %u  Merged: %u  Requests: %u  Bounced: %u  Async: %u\n",
+           queue->stats.submitted, queue->stats.merged, queue->stats.dispatched,
+           queue->stats.bounced, queue->stats.async);
+}
+
 // Initialize block device interface with IDE driver
 bool block_device_init(void) {
-    // Initialize IDE driver
-    if (!ide_init()) {
+    block_device_t* device = block_device_ide();
+    if (!device) {
         return false;
     }
     
     // Set current block device to IDE
-    current_block_device = &ide_device;
+    current_block_device = device;
     return true;
-} 
\ No newline at end of file
+} 
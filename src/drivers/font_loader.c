@@ -5,11 +5,68 @@
 #include "../include/memory/heap.h"
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 // Global font state
 static PSF1Font* main_font = NULL;
 static bool main_font_loaded = false;
 
+// Glyph cache. Each character is resolved once (loaded font, embedded
+// font or blank) into 8-pixel mask rows, one byte per row, MSB first.
+static uint8_t glyph_rows[256][FONT_MAX_HEIGHT];
+static int glyph_height = 0;
+static bool glyph_cache_ready = false;
+
+// 32-bpp expansion of every 8-pixel row: all ones where a pixel is set
+static uint32_t row_masks[256][8];
+static bool row_masks_ready = false;
+
+// Expanded fg/bg rows for the most recently used color pairs
+#define FONT_COLOR_SLOTS 4
+static struct {
+    uint32_t fg;
+    uint32_t bg;
+    bool valid;
+    font_row_t rows[256];
+} color_luts[FONT_COLOR_SLOTS];
+static int color_last = 0;
+static int color_next = 0;
+
+static void build_row_masks(void) {
+    for (int bits = 0; bits < 256; bits++) {
+        for (int px = 0; px < 8; px++) {
+            row_masks[bits][px] = (bits & (0x80 >> px)) ? 0xFFFFFFFF : 0;
+        }
+    }
+    row_masks_ready = true;
+}
+
+// Resolve every character of the active font into the glyph cache
+static void build_glyph_cache(void) {
+    memset(glyph_rows, 0, sizeof(glyph_rows));
+
+    if (main_font_loaded && main_font) {
+        glyph_height = main_font->header.char_height;
+        if (glyph_height > FONT_MAX_HEIGHT) glyph_height = FONT_MAX_HEIGHT;
+        size_t count = main_font->glyph_count < 256 ? main_font->glyph_count : 256;
+        for (size_t c = 0; c < count; c++) {
+            memcpy(glyph_rows[c], &main_font->glyphs[c * main_font->header.char_height], glyph_height);
+        }
+    } else {
+        glyph_height = font_8x16.height;
+        for (int c = font_8x16.first_char; c <= font_8x16.last_char; c++) {
+            memcpy(glyph_rows[c], &font_8x16.data[(c - font_8x16.first_char) * font_8x16.height], glyph_height);
+        }
+    }
+    glyph_cache_ready = true;
+}
+
+static inline void ensure_glyph_cache(void) {
+    if (!glyph_cache_ready) {
+        build_glyph_cache();
+    }
+}
+
 bool font_loader_init(const char* font_file) {
     // Clean up any existing font
     font_loader_cleanup();
@@ -24,6 +81,7 @@ bool font_loader_init(const char* font_file) {
     main_font = load_psf1(font_file);
     if (main_font) {
         main_font_loaded = true;
+        build_glyph_cache();
         return true;
     }
     
@@ -38,50 +96,62 @@ void font_loader_cleanup(void) {
         main_font = NULL;
         main_font_loaded = false;
     }
+    build_glyph_cache();
 }
 
 const uint8_t* font_get_char_bitmap(char c) {
-    // Convert to unsigned to properly handle extended ASCII
-    unsigned char uc = (unsigned char)c;
-    
-    // Try main font first
-    if (main_font_loaded && main_font && uc < main_font->glyph_count) {
-        return &main_font->glyphs[uc * main_font->header.char_height];
-    }
-    
-    // Fall back to embedded font
-    if (uc >= font_8x16.first_char && uc <= font_8x16.last_char) {
-        return &font_8x16.data[(uc - font_8x16.first_char) * font_8x16.height];
-    }
-    
-    // Return space character if not found
-    return &font_8x16.data[0];
+    ensure_glyph_cache();
+    return glyph_rows[(unsigned char)c];
 }
 
 int font_get_char_width(char c) {
-    // Convert to unsigned to properly handle extended ASCII
-    unsigned char uc = (unsigned char)c;
-    
-    // PSF1 fonts are always 8 pixels wide
-    if (main_font_loaded && main_font && uc < main_font->glyph_count) {
-        return 8;
-    }
-    
-    // Fall back to embedded font
-    return font_8x16.width;
+    // PSF1 and the embedded font are both 8 pixels wide
+    (void)c;
+    return 8;
 }
 
 int font_get_char_height(char c) {
-    // Convert to unsigned to properly handle extended ASCII
-    unsigned char uc = (unsigned char)c;
-    
-    // Try main font first
-    if (main_font_loaded && main_font && uc < main_font->glyph_count) {
-        return main_font->header.char_height;
+    (void)c;
+    ensure_glyph_cache();
+    return glyph_height;
+}
+
+int font_get_height(void) {
+    ensure_glyph_cache();
+    return glyph_height;
+}
+
+const uint32_t* font_row_mask(uint8_t bits) {
+    if (!row_masks_ready) {
+        build_row_masks();
     }
-    
-    // Fall back to embedded font
-    return font_8x16.height;
+    return row_masks[bits];
+}
+
+const font_row_t* font_color_rows(uint32_t fg, uint32_t bg) {
+    if (color_luts[color_last].valid && color_luts[color_last].fg == fg && color_luts[color_last].bg == bg) {
+        return color_luts[color_last].rows;
+    }
+    for (int i = 0; i < FONT_COLOR_SLOTS; i++) {
+        if (color_luts[i].valid && color_luts[i].fg == fg && color_luts[i].bg == bg) {
+            color_last = i;
+            return color_luts[i].rows;
+        }
+    }
+
+    // Expand all 256 row patterns for this pair, replacing the oldest slot
+    int slot = color_next;
+    color_next = (color_next + 1) % FONT_COLOR_SLOTS;
+    for (int bits = 0; bits < 256; bits++) {
+        for (int px = 0; px < 8; px++) {
+            color_luts[slot].rows[bits][px] = (bits & (0x80 >> px)) ? fg : bg;
+        }
+    }
+    color_luts[slot].fg = fg;
+    color_luts[slot].bg = bg;
+    color_luts[slot].valid = true;
+    color_last = slot;
+    return color_luts[slot].rows;
 }
 
 bool font_is_char_available(char c) {
@@ -1,7 +1,12 @@
 #include "../../include/drivers/ide.h"
 #include "../../include/drivers/pci.h"
 #include "../../include/io.h"
+#include "../../include/idt.h"
 #include "../../include/stdio.h"
+#include "../../include/string.h"
+#include "../../include/timerDriver.h"
+#include "../../include/memory/pmm.h"
+#include "../../include/memory/vmm.h"
 #include <stddef.h>
 
 // Global IDE controller instance
@@ -12,6 +17,32 @@ static uint8_t piiX3_bus = 0;
 static uint8_t piiX3_slot = 0;
 static uint8_t piiX3_func = 0;
 
+// Per-channel DMA state. The bounce buffer takes transfers whose buffer
+// is not identity mapped.
+static struct ide_prd* dma_prdt[2];
+static uint8_t* dma_bounce[2];
+
+// Stages of the active request
+#define IDE_STAGE_DATA   0   // Transfer command issued
+#define IDE_STAGE_FLUSH  1   // FLUSH CACHE after a write
+
+// Per-channel request queue. The head is the request on the drive; the
+// rest start in order as the IRQ handler finishes the one before.
+struct ide_queue {
+    struct ide_request* head;
+    struct ide_request* tail;
+    uint8_t stage;
+    bool dma;                  // Head uses DMA
+    bool bounce;               // ...through the bounce buffer
+    uint8_t* data;             // PIO: next sector of the buffer
+    uint16_t remaining;        // PIO: sectors still to transfer
+    uint32_t started;          // Tick the current command was issued
+};
+
+static struct ide_queue queues[2];
+
+#define IDE_DMA_BOUNCE_PAGES  (IDE_MAX_SECTORS * 512 / PAGE_SIZE)
+
 // Function prototypes for static functions
 static bool find_piiX3_controller(void);
 static bool configure_piiX3_controller(void);
@@ -22,6 +53,7 @@ static void ide_write_data(uint8_t channel, uint16_t data);
 static void ide_setup_lba(uint8_t channel, uint8_t drive, uint64_t lba, uint16_t sectors);
 static bool ide_init_channel(uint8_t channel);
 static void check_piiX3_configuration(void);
+static void ide_dma_init(void);
 
 // Find the PIIX3 IDE controller via PCI
 static bool find_piiX3_controller(void) {
@@ -155,11 +187,17 @@ bool ide_init(void) {
     ide_ctrl.primary.ctrl_port = IDE_PRIMARY_CTRL;
     ide_ctrl.primary.present = false;
     ide_ctrl.primary.device_type = IDE_DEVICE_NONE;
+    ide_ctrl.primary.drive_present[0] = ide_ctrl.primary.drive_present[1] = false;
+    ide_ctrl.primary.drive_dma[0] = ide_ctrl.primary.drive_dma[1] = false;
+    ide_ctrl.primary.bmide_port = 0;
     
     ide_ctrl.secondary.base_port = IDE_SECONDARY_BASE;
     ide_ctrl.secondary.ctrl_port = IDE_SECONDARY_CTRL;
     ide_ctrl.secondary.present = false;
     ide_ctrl.secondary.device_type = IDE_DEVICE_NONE;
+    ide_ctrl.secondary.drive_present[0] = ide_ctrl.secondary.drive_present[1] = false;
+    ide_ctrl.secondary.drive_dma[0] = ide_ctrl.secondary.drive_dma[1] = false;
+    ide_ctrl.secondary.bmide_port = 0;
     
     // Configure PIIX3 controller
     if (!configure_piiX3_controller()) {
@@ -180,6 +218,12 @@ bool ide_init(void) {
         return false;
     }
     
+    ide_dma_init();
+
+    // Transfers complete on IRQ14/15 (slave PIC) through the cascade line
+    outb(PIC2_DATA, inb(PIC2_DATA) & ~0xC0);
+    outb(PIC1_DATA, inb(PIC1_DATA) & ~0x04);
+
     ide_ctrl.initialized = true;
     printf("IDE Controller initialized successfully\n");
     return true;
@@ -269,12 +313,27 @@ bool ide_identify_device(uint8_t channel, uint8_t drive) {
     
     printf("  Device responding, reading identify data...\n");
     
-    // Read identify data (we'll just read it to clear the buffer for now)
+    // Read identify data
+    uint16_t identify[256];
     for (int i = 0; i < 256; i++) {
-        inw(base_port + IDE_DATA);
+        identify[i] = inw(base_port + IDE_DATA);
     }
+
+    // Capacity: words 100-103 when LBA48 is supported (word 83 bit 10),
+    // otherwise the LBA28 count in words 60-61
+    ide_channel_t* ch = (channel == 0) ? &ide_ctrl.primary : &ide_ctrl.secondary;
+    uint32_t sectors = identify[60] | ((uint32_t)identify[61] << 16);
+    if ((identify[83] & (1 << 10)) && (identify[102] == 0 && identify[103] == 0)) {
+        sectors = identify[100] | ((uint32_t)identify[101] << 16);
+    } else if (identify[83] & (1 << 10)) {
+        sectors = 0xFFFFFFFF;  // Larger than 2 TB, clamp
+    }
+    ch->drive_present[drive] = true;
+    ch->drive_sectors[drive] = sectors;
+    ch->drive_dma[drive] = (identify[49] & (1 << 8)) != 0;
+    ch->device_type = IDE_DEVICE_ATA;
     
-    printf("  %s %s drive identified successfully\n", channel_name, drive_name);
+    printf("  %s %s drive identified successfully (%u sectors)\n", channel_name, drive_name, sectors);
     return true;
 }
 
@@ -282,108 +341,332 @@ bool ide_identify_device(uint8_t channel, uint8_t drive) {
 void ide_print_device_info(uint8_t channel, uint8_t drive) {
     const char* channel_name = (channel == 0) ? "Primary" : "Secondary";
     const char* drive_name = (drive == 0) ? "Master" : "Slave";
-    printf("IDE Device: %s Channel %s Drive\n", channel_name, drive_name);
+    printf("IDE Device: %s Channel %s Drive%s\n", channel_name, drive_name,
+           ide_dma_enabled(channel, drive) ? " (DMA)" : "");
 }
 
-// Read sectors from IDE drive
-bool ide_read_sectors(uint8_t channel, uint8_t drive, uint64_t lba, uint16_t sectors, void* buffer) {
-    uint16_t base_port = (channel == 0) ? IDE_PRIMARY_BASE : IDE_SECONDARY_BASE;
-    
-    if (!ide_wait_ready(channel)) {
-        return false;
+// Fill the channel's PRD table for a physically contiguous buffer,
+// splitting it at 64 KB boundaries
+static void ide_build_prdt(uint8_t channel, uint32_t phys, uint32_t bytes) {
+    struct ide_prd* prd = dma_prdt[channel];
+    while (bytes) {
+        uint32_t chunk = 0x10000 - (phys & 0xFFFF);
+        if (chunk > bytes) chunk = bytes;
+        prd->base = phys;
+        prd->count = chunk & 0xFFFF;
+        prd->flags = 0;
+        phys += chunk;
+        bytes -= chunk;
+        prd++;
     }
-    
-    // Setup LBA addressing
-    ide_setup_lba(channel, drive, lba, sectors);
-    
-    // Send read command
-    uint8_t cmd = (lba >= 0x100000000) ? IDE_CMD_READ_SECTORS_EXT : IDE_CMD_READ_SECTORS;
-    outb(base_port + IDE_COMMAND, cmd);
-    
-    // Read data
-    uint16_t* data = (uint16_t*)buffer;
-    for (int sector = 0; sector < sectors; sector++) {
-        if (!ide_wait_data(channel)) {
-            return false;
-        }
-        
-        // Read 256 words (512 bytes) per sector
-        for (int word = 0; word < 256; word++) {
+    prd[-1].flags = IDE_PRD_EOT;
+}
+
+// Reading the alternate status four times gives the drive the 400ns it
+// needs to raise BSY after a command or a data block
+static void ide_delay_400ns(uint8_t channel) {
+    uint16_t ctrl_port = (channel == 0) ? IDE_PRIMARY_CTRL : IDE_SECONDARY_CTRL;
+    for (int i = 0; i < 4; i++) {
+        inb(ctrl_port);
+    }
+}
+
+// Move one sector between the buffer and the data port
+static void ide_pio_sector(uint8_t channel, struct ide_queue* q, bool write) {
+    uint16_t* data = (uint16_t*)q->data;
+    for (int word = 0; word < 256; word++) {
+        if (write) {
+            ide_write_data(channel, data[word]);
+        } else {
             data[word] = ide_read_data(channel);
         }
-        data += 256;
     }
-    
-    return true;
+    q->data += 512;
+    if (write) {
+        ide_delay_400ns(channel);
+    }
 }
 
-// Write sectors to IDE drive
-bool ide_write_sectors(uint8_t channel, uint8_t drive, uint64_t lba, uint16_t sectors, const void* buffer) {
-    uint16_t base_port = (channel == 0) ? IDE_PRIMARY_BASE : IDE_SECONDARY_BASE;
-    
+static void ide_start(uint8_t channel);
+
+// Complete the head request and start the next one. The callback runs
+// last, so it may submit more requests.
+static void ide_finish(uint8_t channel, bool ok) {
+    struct ide_queue* q = &queues[channel];
+    struct ide_request* request = q->head;
+    q->head = request->next;
+    if (!q->head) {
+        q->tail = NULL;
+    }
+    ide_start(channel);
+
+    request->ok = ok;
+    request->done = true;
+    if (request->callback) {
+        request->callback(request);
+    }
+}
+
+// Issue the head request's command. Runs with interrupts off.
+static void ide_start(uint8_t channel) {
+    struct ide_queue* q = &queues[channel];
+    struct ide_request* request = q->head;
+    if (!request) return;
+
+    const ide_channel_t* ch = (channel == 0) ? &ide_ctrl.primary : &ide_ctrl.secondary;
+    uint16_t base_port = ch->base_port;
+    uint16_t bm_port = ch->bmide_port;
+    bool ext = request->lba >= 0x100000000;
+
+    q->stage = IDE_STAGE_DATA;
+    q->dma = ide_dma_enabled(channel, request->drive);
+    q->data = (uint8_t*)request->buffer;
+    q->remaining = request->sectors;
+    q->started = timer_get_ticks();
+
     if (!ide_wait_ready(channel)) {
-        return false;
+        ide_finish(channel, false);
+        return;
+    }
+
+    if (!q->dma) {
+        ide_setup_lba(channel, request->drive, request->lba, request->sectors);
+        if (request->write) {
+            outb(base_port + IDE_COMMAND, ext ? IDE_CMD_WRITE_SECTORS_EXT : IDE_CMD_WRITE_SECTORS);
+            // The first sector is asked for without an interrupt
+            if (!ide_wait_data(channel)) {
+                ide_finish(channel, false);
+                return;
+            }
+            ide_pio_sector(channel, q, true);
+        } else {
+            outb(base_port + IDE_COMMAND, ext ? IDE_CMD_READ_SECTORS_EXT : IDE_CMD_READ_SECTORS);
+            ide_delay_400ns(channel);
+        }
+        return;
+    }
+
+    // Buffers below VMM_KERNEL_TOP are identity mapped and used as they
+    // are; anything else goes through the bounce buffer
+    uint32_t bytes = (uint32_t)request->sectors * 512;
+    uint32_t addr = (uint32_t)request->buffer;
+    q->bounce = (addr & 1) || addr + bytes > VMM_KERNEL_TOP || addr + bytes < addr;
+    uint8_t* target = q->bounce ? dma_bounce[channel] : (uint8_t*)request->buffer;
+    if (request->write && q->bounce) {
+        memcpy(target, request->buffer, bytes);
+    }
+    ide_build_prdt(channel, (uint32_t)target, bytes);
+
+    // Stop the engine, load the table and clear old status
+    uint8_t direction = request->write ? 0 : IDE_BM_CMD_READ;
+    outb(bm_port + IDE_BM_COMMAND, 0);
+    outl(bm_port + IDE_BM_PRDT, (uint32_t)dma_prdt[channel]);
+    outb(bm_port + IDE_BM_COMMAND, direction);
+    uint8_t bm_status = inb(bm_port + IDE_BM_STATUS);
+    outb(bm_port + IDE_BM_STATUS, (bm_status & IDE_BM_SR_DMA_CAP) | IDE_BM_SR_IRQ | IDE_BM_SR_ERR);
+
+    ide_setup_lba(channel, request->drive, request->lba, request->sectors);
+    uint8_t cmd;
+    if (ext) {
+        cmd = request->write ? IDE_CMD_WRITE_DMA_EXT : IDE_CMD_READ_DMA_EXT;
+    } else {
+        cmd = request->write ? IDE_CMD_WRITE_DMA : IDE_CMD_READ_DMA;
     }
-    
-    // Setup LBA addressing
-    ide_setup_lba(channel, drive, lba, sectors);
-    
-    // Send write command
-    uint8_t cmd = (lba >= 0x100000000) ? IDE_CMD_WRITE_SECTORS_EXT : IDE_CMD_WRITE_SECTORS;
     outb(base_port + IDE_COMMAND, cmd);
-    
-    // Write data
-    const uint16_t* data = (const uint16_t*)buffer;
-    for (int sector = 0; sector < sectors; sector++) {
-        if (!ide_wait_data(channel)) {
-            return false;
+    outb(bm_port + IDE_BM_COMMAND, direction | IDE_BM_CMD_START);
+}
+
+// Give up on the head request after a timeout: stop the bus master,
+// reset the channel and move on
+static void ide_abort(uint8_t channel) {
+    const ide_channel_t* ch = (channel == 0) ? &ide_ctrl.primary : &ide_ctrl.secondary;
+    if (ch->bmide_port) {
+        outb(ch->bmide_port + IDE_BM_COMMAND, 0);
+    }
+    outb(ch->ctrl_port, 0x04); // Set reset bit
+    for (volatile int i = 0; i < 1000; i++); // Small delay
+    outb(ch->ctrl_port, 0x00); // Clear reset bit
+    ide_wait_ready(channel);
+    printf("IDE: %s channel timed out, reset\n", channel == 0 ? "Primary" : "Secondary");
+    ide_finish(channel, false);
+}
+
+bool ide_dma_enabled(uint8_t channel, uint8_t drive) {
+    const ide_channel_t* ch = (channel == 0) ? &ide_ctrl.primary : &ide_ctrl.secondary;
+    return drive < 2 && ch->bmide_port && ch->drive_dma[drive];
+}
+
+void ide_irq_handler(uint8_t channel) {
+    const ide_channel_t* ch = (channel == 0) ? &ide_ctrl.primary : &ide_ctrl.secondary;
+    uint16_t base_port = (channel == 0) ? IDE_PRIMARY_BASE : IDE_SECONDARY_BASE;
+    struct ide_queue* q = &queues[channel];
+    struct ide_request* request = q->head;
+
+    // Reading the status register acknowledges the drive's interrupt
+    uint8_t status = inb(base_port + IDE_STATUS);
+    uint8_t bm_status = 0;
+    if (ch->bmide_port) {
+        bm_status = inb(ch->bmide_port + IDE_BM_STATUS);
+        if (bm_status & IDE_BM_SR_IRQ) {
+            outb(ch->bmide_port + IDE_BM_STATUS, (bm_status & IDE_BM_SR_DMA_CAP) | IDE_BM_SR_IRQ);
         }
-        
-        // Write 256 words (512 bytes) per sector
-        for (int word = 0; word < 256; word++) {
-            ide_write_data(channel, data[word]);
+    }
+    if (!request || (status & IDE_SR_BSY)) {
+        return; // Nothing in flight, or a stale edge
+    }
+
+    if (q->stage == IDE_STAGE_FLUSH) {
+        ide_finish(channel, !(status & (IDE_SR_ERR | IDE_SR_DF)));
+        return;
+    }
+
+    if (q->dma) {
+        if (!(bm_status & IDE_BM_SR_IRQ)) {
+            return;
         }
-        data += 256;
-        
-        // Check for errors
-        uint8_t status = inb(base_port + IDE_STATUS);
-        if (status & IDE_SR_ERR) {
-            return false;
+        outb(ch->bmide_port + IDE_BM_COMMAND, 0);
+        if ((bm_status & IDE_BM_SR_ERR) || (status & (IDE_SR_ERR | IDE_SR_DF))) {
+            ide_finish(channel, false);
+            return;
         }
-    }
-    
-    // Wait for write to complete
-    uint32_t timeout = 1000000;
-    while (timeout--) {
-        uint8_t status = inb(base_port + IDE_STATUS);
-        if (!(status & IDE_SR_BSY)) {
-            break;
+        if (!request->write && q->bounce) {
+            memcpy(request->buffer, dma_bounce[channel], (uint32_t)request->sectors * 512);
         }
-        if (status & IDE_SR_ERR) {
-            return false;
+    } else {
+        if (status & (IDE_SR_ERR | IDE_SR_DF)) {
+            ide_finish(channel, false);
+            return;
+        }
+        if (!request->write) {
+            // One interrupt per sector, with its data ready
+            if (!(status & IDE_SR_DRQ)) {
+                return;
+            }
+            ide_pio_sector(channel, q, false);
+            if (--q->remaining) {
+                return;
+            }
+        } else if (--q->remaining) {
+            // The last sector was taken; send the next one
+            ide_pio_sector(channel, q, true);
+            return;
         }
     }
-    
-    if (timeout == 0) {
+
+    if (request->write) {
+        q->stage = IDE_STAGE_FLUSH;
+        q->started = timer_get_ticks();
+        outb(base_port + IDE_COMMAND, IDE_CMD_FLUSH_CACHE);
+        return;
+    }
+    ide_finish(channel, true);
+}
+
+// With interrupts off, check for the condition the IRQ would report
+static bool ide_irq_pending(uint8_t channel) {
+    const ide_channel_t* ch = (channel == 0) ? &ide_ctrl.primary : &ide_ctrl.secondary;
+    struct ide_queue* q = &queues[channel];
+    if (!q->head) {
         return false;
     }
-    
-    // Flush cache
-    outb(base_port + IDE_COMMAND, IDE_CMD_FLUSH_CACHE);
-    
-    // Wait for flush to complete
-    timeout = 1000000;
-    while (timeout--) {
-        uint8_t status = inb(base_port + IDE_STATUS);
-        if (!(status & IDE_SR_BSY)) {
-            break;
+    if (q->dma && q->stage == IDE_STAGE_DATA) {
+        return inb(ch->bmide_port + IDE_BM_STATUS) & IDE_BM_SR_IRQ;
+    }
+
+    // Alternate status doesn't acknowledge anything
+    uint8_t status = inb(ch->ctrl_port);
+    if (status & IDE_SR_BSY) {
+        return false;
+    }
+    if (q->stage == IDE_STAGE_DATA && !q->head->write) {
+        return status & (IDE_SR_DRQ | IDE_SR_ERR);
+    }
+    return true;
+}
+
+bool ide_submit(struct ide_request* request, ide_callback_t callback) {
+    if (!request || request->channel > 1 || !ide_drive_present(request->channel, request->drive) ||
+        request->sectors == 0 || request->sectors > IDE_MAX_SECTORS) {
+        return false;
+    }
+    request->callback = callback;
+    request->next = NULL;
+    request->ok = false;
+    request->done = false;
+
+    uint32_t eflags;
+    asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+    struct ide_queue* q = &queues[request->channel];
+    if (q->tail) {
+        q->tail->next = request;
+    } else {
+        q->head = request;
+    }
+    q->tail = request;
+    if (q->head == request) {
+        ide_start(request->channel);
+    }
+    if (eflags & 0x200) {
+        asm volatile("sti");
+    }
+    return true;
+}
+
+bool ide_wait(struct ide_request* request) {
+    uint8_t channel = request->channel;
+    struct ide_queue* q = &queues[channel];
+    uint32_t eflags;
+    asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+
+    if (!(eflags & 0x200)) {
+        // Interrupts are off: run the handler whenever the drive is ready
+        uint32_t timeout = 10000000;
+        while (!request->done) {
+            if (ide_irq_pending(channel)) {
+                ide_irq_handler(channel);
+                timeout = 10000000;
+            } else if (--timeout == 0) {
+                ide_abort(channel);
+                timeout = 10000000;
+            }
         }
-        if (status & IDE_SR_ERR) {
-            return false;
+        return request->ok;
+    }
+
+    // Sleep until the IRQ handler completes the request. sti takes effect
+    // after hlt starts, so the IRQ can't slip in between.
+    while (!request->done) {
+        if (q->head && timer_get_ticks() - q->started > IDE_TIMEOUT) {
+            ide_abort(channel);
+            continue;
         }
+        asm volatile("sti; hlt; cli");
     }
-    
-    return timeout > 0;
+    asm volatile("sti");
+    return request->ok;
+}
+
+// Synchronous transfers are one request each, slept on until done
+static bool ide_transfer(uint8_t channel, uint8_t drive, uint64_t lba, uint16_t sectors, void* buffer, bool write) {
+    struct ide_request request;
+    request.channel = channel;
+    request.drive = drive;
+    request.write = write;
+    request.lba = lba;
+    request.sectors = sectors;
+    request.buffer = buffer;
+    request.context = NULL;
+    return ide_submit(&request, NULL) && ide_wait(&request);
+}
+
+// Read sectors from IDE drive
+bool ide_read_sectors(uint8_t channel, uint8_t drive, uint64_t lba, uint16_t sectors, void* buffer) {
+    return ide_transfer(channel, drive, lba, sectors, buffer, false);
+}
+
+// Write sectors to IDE drive
+bool ide_write_sectors(uint8_t channel, uint8_t drive, uint64_t lba, uint16_t sectors, const void* buffer) {
+    return ide_transfer(channel, drive, lba, sectors, (void*)buffer, true);
 }
 
 // Get IDE controller status
@@ -400,6 +683,20 @@ bool ide_channel_has_devices(uint8_t channel) {
     }
 }
 
+// Check if a drive answered IDENTIFY
+bool ide_drive_present(uint8_t channel, uint8_t drive) {
+    const ide_channel_t* ch = (channel == 0) ? &ide_ctrl.primary : &ide_ctrl.secondary;
+    return drive < 2 && ch->drive_present[drive];
+}
+
+// Get drive capacity in sectors (0 if not present)
+uint32_t ide_get_total_sectors(uint8_t channel, uint8_t drive) {
+    if (!ide_drive_present(channel, drive)) {
+        return 0;
+    }
+    return (channel == 0) ? ide_ctrl.primary.drive_sectors[drive] : ide_ctrl.secondary.drive_sectors[drive];
+}
+
 // Initialize IDE channel
 static bool ide_init_channel(uint8_t channel) {
     uint16_t base_port = (channel == 0) ? IDE_PRIMARY_BASE : IDE_SECONDARY_BASE;
@@ -421,6 +718,38 @@ static bool ide_init_channel(uint8_t channel) {
     return true;
 }
 
+// Enable bus mastering and give each channel with a DMA capable drive a
+// PRD table and bounce buffer. Channels without them keep using PIO.
+static void ide_dma_init(void) {
+    uint32_t bar4 = pci_config_read(piiX3_bus, piiX3_slot, piiX3_func, PIIX3_IDE_BMIBA);
+    if (!(bar4 & 0x01) || (bar4 & 0xFFFC) == 0) {
+        printf("IDE: no bus master registers, using PIO\n");
+        return;
+    }
+    uint16_t bm_base = bar4 & 0xFFFC;
+
+    // PCI command register: I/O space and bus master enable
+    uint32_t command = pci_config_read(piiX3_bus, piiX3_slot, piiX3_func, 0x04);
+    pci_config_write(piiX3_bus, piiX3_slot, piiX3_func, 0x04, (command & 0xFFFF) | 0x05);
+
+    for (uint8_t channel = 0; channel < 2; channel++) {
+        ide_channel_t* ch = (channel == 0) ? &ide_ctrl.primary : &ide_ctrl.secondary;
+        if (!ch->drive_dma[0] && !ch->drive_dma[1]) continue;
+
+        if (!dma_prdt[channel]) {
+            // A page-aligned table never crosses a 64 KB boundary
+            dma_prdt[channel] = (struct ide_prd*)pmm_alloc_pages(1, PAGE_SIZE);
+            dma_bounce[channel] = (uint8_t*)pmm_alloc_pages(IDE_DMA_BOUNCE_PAGES, 0x10000);
+        }
+        if (!dma_prdt[channel] || !dma_bounce[channel]) {
+            printf("IDE: out of memory for DMA buffers, using PIO\n");
+            continue;
+        }
+        ch->bmide_port = bm_base + channel * 8;
+        printf("IDE: %s channel bus master DMA at 0x%04x\n", channel == 0 ? "Primary" : "Secondary", ch->bmide_port);
+    }
+}
+
 // Check PIIX3 IDE configuration
 static void check_piiX3_configuration(void) {
     if (!find_piiX3_controller()) {
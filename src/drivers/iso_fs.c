@@ -1,4 +1,5 @@
 #include "../../include/drivers/iso_fs.h"
+#include "../../include/string.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -22,6 +23,21 @@ void iso_fs_set_size(uint32_t size) {
     fs_size = size & ~0x1FF;
 }
 
+// Get the size of the filesystem
+uint32_t iso_fs_get_size(void) {
+    return fs_size;
+}
+
+// Map sectors in place
+const void* iso_fs_map_sectors(uint32_t lba, uint32_t sectors) {
+    uint32_t addr = fs_base + (lba * 512);
+    uint32_t size = sectors * 512;
+    if (fs_size > 0 && (addr + size > fs_base + fs_size)) {
+        return NULL;
+    }
+    return (const void*)addr;
+}
+
 // Read sectors from the ISO filesystem
 bool iso_fs_read_sectors(uint32_t lba, uint8_t sectors, void* buffer) {
     // Validate parameters
@@ -41,11 +57,7 @@ bool iso_fs_read_sectors(uint32_t lba, uint8_t sectors, void* buffer) {
     }
 
     // Copy the data
-    uint8_t* src = (uint8_t*)addr;
-    uint8_t* dst = (uint8_t*)buffer;
-    for (int i = 0; i < size; i++) {
-        dst[i] = src[i];
-    }
+    memcpy(buffer, (const void*)addr, size);
     return true;
 }
 
@@ -66,11 +78,7 @@ bool iso_fs_write_sectors(uint32_t lba, uint8_t sectors, const void* buffer) {
     }
 
     // Copy the data
-    uint8_t* dst = (uint8_t*)addr;
-    const uint8_t* src = (const uint8_t*)buffer;
-    for (int i = 0; i < size; i++) {
-        dst[i] = src[i];
-    }
+    memcpy((void*)addr, buffer, size);
     return true;
 }
 
@@ -117,6 +117,8 @@ void keyboard_handler(struct regs *r) {
             case 0x50: keyboard_buffer_add('\033'); keyboard_buffer_add('['); keyboard_buffer_add('B'); break;  // Down arrow
             case 0x4D: keyboard_buffer_add('\033'); keyboard_buffer_add('['); keyboard_buffer_add('C'); break;  // Right arrow
             case 0x4B: keyboard_buffer_add('\033'); keyboard_buffer_add('['); keyboard_buffer_add('D'); break;  // Left arrow
+            case 0x49: keyboard_buffer_add('\033'); keyboard_buffer_add('['); keyboard_buffer_add('5'); break;  // Page Up
+            case 0x51: keyboard_buffer_add('\033'); keyboard_buffer_add('['); keyboard_buffer_add('6'); break;  // Page Down
             default: {
                 // Only process scancodes within our mapping range
                 if (scancode < sizeof(scancode_to_ascii)) {
@@ -48,6 +48,12 @@ uint32_t pci_config_read(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset
     outl(0xCF8, address);
     return inl(0xCFC);
 }
+void pci_config_write(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value){
+    uint32_t address;
+    address = (uint32_t)((bus << 16) | (slot<< 11) | (func <<8) | (offset & 0xFC) | ((uint32_t)0x80000000));
+    outl(0xCF8, address);
+    outl(0xCFC, value);
+}
 void pci_scan() {
     for (int bus = 0; bus < 256; bus++) {
         for (int device = 0; device < 32; device++) {
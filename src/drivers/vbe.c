@@ -3,6 +3,12 @@
 #include "../../include/string.h"
 #include "../../include/multiboot.h"
 #include "../../include/PSF1_parser/psf1_parser.h"
+#include "../../include/drivers/font_loader.h"
+#include "../../include/memory/vmm.h"
+#include "../../include/memory/heap.h"
+#include "../../include/memory/pmm.h"
+#include "../../include/timerDriver.h"
+#include "../../include/stdio.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdarg.h>
@@ -21,15 +27,38 @@ static struct {
     uint32_t pitch;
     uint32_t bpp;
     bool initialized;
+    bool write_combining;
+    uint32_t* surface;        // Where primitives draw: back buffer, or framebuffer before it exists
+    uint32_t surface_stride;  // Pixels per surface row
+    uint32_t* back_buffer;    // RAM frame all drawing goes to
+    uint32_t* shadow;         // RAM copy of what the framebuffer currently shows
+    bool shadow_valid;        // False forces the next present to copy every dirty row
 } vbe_state = {
     .framebuffer = NULL,
     .width = VBE_WIDTH,
     .height = VBE_HEIGHT,
     .pitch = VBE_PITCH,
     .bpp = VBE_BPP,
-    .initialized = false
+    .initialized = false,
+    .write_combining = false,
+    .surface = NULL,
+    .surface_stride = VBE_PITCH / 4,
+    .back_buffer = NULL,
+    .shadow = NULL,
+    .shadow_valid = false
 };
 
+// Dirty rectangles waiting for vbe_present, as [x0, x1) x [y0, y1)
+#define VBE_MAX_DIRTY 16
+struct dirty_rect {
+    int x0, y0, x1, y1;
+};
+static struct dirty_rect dirty_rects[VBE_MAX_DIRTY];
+static int dirty_count = 0;
+
+// Nesting depth of vbe_begin_update; primitives present on their own at 0
+static int update_depth = 0;
+
 // Current cursor position
 int vbe_cursor_x = 0;
 int vbe_cursor_y = 0;
@@ -43,10 +72,362 @@ static uint32_t cursor_blink_time = 0;
 static const uint32_t CURSOR_BLINK_INTERVAL = 30; // Blink every 300ms (30 ticks at 100Hz)
 bool cursor_active = false;  // Track if cursor is being actively used
 
+// Pixel in the current drawing surface
+static inline uint32_t* pixel_at(int x, int y) {
+    return vbe_state.surface + y * vbe_state.surface_stride + x;
+}
+
+// Forward dword copy, also safe for overlapping moves towards lower addresses
+static inline void copy_dwords(uint32_t* dst, const uint32_t* src, uint32_t count) {
+    asm volatile ("rep movsl" : "+D"(dst), "+S"(src), "+c"(count) : : "memory");
+}
+
+static inline void fill_dwords(uint32_t* dst, uint32_t value, uint32_t count) {
+    asm volatile ("rep stosl" : "+D"(dst), "+c"(count) : "a"(value) : "memory");
+}
+
+static inline bool spans_equal(const uint32_t* a, const uint32_t* b, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+// Record a changed area of the back buffer. Touching or overlapping
+// rectangles are merged; when the list is full everything collapses
+// into one bounding box.
+static void mark_dirty(int x, int y, int width, int height) {
+    if (!vbe_state.back_buffer) return;
+
+    int x0 = x < 0 ? 0 : x;
+    int y0 = y < 0 ? 0 : y;
+    int x1 = x + width > (int)vbe_state.width ? (int)vbe_state.width : x + width;
+    int y1 = y + height > (int)vbe_state.height ? (int)vbe_state.height : y + height;
+    if (x0 >= x1 || y0 >= y1) return;
+
+    for (int i = 0; i < dirty_count; i++) {
+        struct dirty_rect* r = &dirty_rects[i];
+        if (x0 <= r->x1 && x1 >= r->x0 && y0 <= r->y1 && y1 >= r->y0) {
+            if (x0 < r->x0) r->x0 = x0;
+            if (y0 < r->y0) r->y0 = y0;
+            if (x1 > r->x1) r->x1 = x1;
+            if (y1 > r->y1) r->y1 = y1;
+            return;
+        }
+    }
+
+    if (dirty_count == VBE_MAX_DIRTY) {
+        struct dirty_rect* r = &dirty_rects[0];
+        for (int i = 1; i < dirty_count; i++) {
+            if (dirty_rects[i].x0 < r->x0) r->x0 = dirty_rects[i].x0;
+            if (dirty_rects[i].y0 < r->y0) r->y0 = dirty_rects[i].y0;
+            if (dirty_rects[i].x1 > r->x1) r->x1 = dirty_rects[i].x1;
+            if (dirty_rects[i].y1 > r->y1) r->y1 = dirty_rects[i].y1;
+        }
+        dirty_count = 1;
+        if (x0 < r->x0) r->x0 = x0;
+        if (y0 < r->y0) r->y0 = y0;
+        if (x1 > r->x1) r->x1 = x1;
+        if (y1 > r->y1) r->y1 = y1;
+        return;
+    }
+
+    dirty_rects[dirty_count].x0 = x0;
+    dirty_rects[dirty_count].y0 = y0;
+    dirty_rects[dirty_count].x1 = x1;
+    dirty_rects[dirty_count].y1 = y1;
+    dirty_count++;
+}
+
+// Present right away unless a batch is open
+static inline void auto_present(void) {
+    if (update_depth == 0) {
+        vbe_present();
+    }
+}
+
+// Allocate the back buffer and its shadow copy. Until this runs the
+// primitives draw straight into the framebuffer.
+bool vbe_init_back_buffer(void) {
+    if (!vbe_state.initialized || vbe_state.back_buffer) return false;
+
+    uint32_t frame_pixels = vbe_state.width * vbe_state.height;
+    size_t pages = (frame_pixels * 4 + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t* back = (uint32_t*)pmm_alloc_pages(pages, 0);
+    uint32_t* shadow = (uint32_t*)pmm_alloc_pages(pages, 0);
+    if (!back || !shadow) {
+        if (back) pmm_free_pages(back, pages);
+        if (shadow) pmm_free_pages(shadow, pages);
+        return false;
+    }
+
+    // Pick up whatever is already on screen; the last VRAM read-back we do
+    uint32_t fb_stride = vbe_state.pitch / 4;
+    for (uint32_t y = 0; y < vbe_state.height; y++) {
+        copy_dwords(back + y * vbe_state.width, vbe_state.framebuffer + y * fb_stride, vbe_state.width);
+    }
+    copy_dwords(shadow, back, frame_pixels);
+
+    vbe_state.back_buffer = back;
+    vbe_state.shadow = shadow;
+    vbe_state.shadow_valid = true;
+    vbe_state.surface = back;
+    vbe_state.surface_stride = vbe_state.width;
+    dirty_count = 0;
+    return true;
+}
+
+// Text console. The terminal keeps a grid of character cells (glyph +
+// color attribute) and only renders cells that changed. Screen rows are
+// a window into a ring of lines, so scrolling moves an offset instead of
+// cells, and the lines that fall off the top stay around as scrollback.
+#define CONSOLE_CELL_WIDTH  8
+#define CONSOLE_CELL_HEIGHT 16
+#define CONSOLE_MAX_COLS    160   // Enough for 1280 pixels
+#define CONSOLE_MAX_ROWS    64    // Enough for 1024 pixels, one dirty bit each
+#define CONSOLE_SCROLLBACK  256   // Lines kept above the screen
+#define CONSOLE_LINES       (CONSOLE_MAX_ROWS + CONSOLE_SCROLLBACK)
+#define CONSOLE_BG          0x00000000
+
+struct console_cell {
+    char ch;
+    uint8_t attr;   // Index into console_palette
+};
+
+static struct console_cell console_lines[CONSOLE_LINES][CONSOLE_MAX_COLS];
+
+// Cell attributes index a palette filled with colors as they are used
+static uint32_t console_palette[256];
+static int console_palette_used = 0;
+
+static struct {
+    int cols;
+    int rows;
+    int top;              // Ring index of the first live screen row
+    int history;          // Scrollback lines available above the screen
+    int view;             // Lines scrolled back (0 = live)
+    uint64_t row_dirty;   // Screen rows with cells to render
+    uint8_t dirty_from[CONSOLE_MAX_ROWS];  // Dirty column span per row
+    uint8_t dirty_to[CONSOLE_MAX_ROWS];
+    int pending_scroll;   // Rows scrolled since the last render
+    bool full_redraw;     // Render every cell on the next render
+} console;
+
+static uint8_t console_attr(uint32_t color) {
+    static int last = 0;
+    if (console_palette_used > 0 && console_palette[last] == color) {
+        return (uint8_t)last;
+    }
+    for (int i = 0; i < console_palette_used; i++) {
+        if (console_palette[i] == color) {
+            last = i;
+            return (uint8_t)i;
+        }
+    }
+    if (console_palette_used == 256) {
+        return (uint8_t)last;  // Palette full, reuse the last color
+    }
+    console_palette[console_palette_used] = color;
+    last = console_palette_used++;
+    return (uint8_t)last;
+}
+
+// Ring line shown at a screen row, live or scrolled back
+static inline struct console_cell* console_line(int row, int view) {
+    int index = (console.top - view + row) % CONSOLE_LINES;
+    if (index < 0) index += CONSOLE_LINES;
+    return console_lines[index];
+}
+
+static void console_mark(int row, int from, int to) {
+    uint64_t bit = (uint64_t)1 << row;
+    if (!(console.row_dirty & bit)) {
+        console.row_dirty |= bit;
+        console.dirty_from[row] = from;
+        console.dirty_to[row] = to;
+        return;
+    }
+    if (from < console.dirty_from[row]) console.dirty_from[row] = from;
+    if (to > console.dirty_to[row]) console.dirty_to[row] = to;
+}
+
+// Store a cell; unchanged cells are not redrawn
+static void console_put(int col, int row, char ch, uint32_t color) {
+    if (col < 0 || col >= console.cols || row < 0 || row >= console.rows) return;
+
+    struct console_cell* cell = &console_line(row, 0)[col];
+    uint8_t attr = console_attr(color);
+    if (cell->ch == ch && cell->attr == attr) return;
+    cell->ch = ch;
+    cell->attr = attr;
+    if (console.view == 0) {
+        console_mark(row, col, col + 1);
+    }
+}
+
+// Scroll the live screen up one row: O(1) cell work, the pixels are
+// moved once at render time however many rows were scrolled
+static void console_scroll(void) {
+    console.top = (console.top + 1) % CONSOLE_LINES;
+    if (console.history < CONSOLE_SCROLLBACK) {
+        console.history++;
+    }
+
+    struct console_cell* line = console_line(console.rows - 1, 0);
+    for (int col = 0; col < console.cols; col++) {
+        line[col].ch = ' ';
+        line[col].attr = 0;
+    }
+
+    // Pending dirty rows move up with their cells
+    console.row_dirty >>= 1;
+    for (int row = 0; row < console.rows - 1; row++) {
+        console.dirty_from[row] = console.dirty_from[row + 1];
+        console.dirty_to[row] = console.dirty_to[row + 1];
+    }
+    console.row_dirty &= ~((uint64_t)1 << (console.rows - 1));
+    console_mark(console.rows - 1, 0, console.cols);
+    console.pending_scroll++;
+}
+
+// Return to the live screen before output changes it
+static void console_snap_to_live(void) {
+    if (console.view != 0) {
+        console.view = 0;
+        console.full_redraw = true;
+    }
+}
+
+static void console_render_cell(int col, int row, const struct console_cell* cell) {
+    uint32_t* pixel = pixel_at(col * CONSOLE_CELL_WIDTH, row * CONSOLE_CELL_HEIGHT);
+    const font_row_t* lut = font_color_rows(console_palette[cell->attr], CONSOLE_BG);
+    const uint8_t* rows = font_get_char_bitmap(cell->ch);
+    int height = font_get_height();
+    if (height > CONSOLE_CELL_HEIGHT) height = CONSOLE_CELL_HEIGHT;
+
+    // Each glyph row is one table lookup and an 8-dword store
+    for (int py = 0; py < CONSOLE_CELL_HEIGHT; py++) {
+        const uint32_t* src = lut[py < height ? rows[py] : 0];
+        for (int px = 0; px < CONSOLE_CELL_WIDTH; px++) {
+            pixel[px] = src[px];
+        }
+        pixel += vbe_state.surface_stride;
+    }
+}
+
+// Bring the pixels up to date with the cell grid
+static void console_render(void) {
+    if (console.rows == 0) return;
+
+    int text_width = console.cols * CONSOLE_CELL_WIDTH;
+    int text_height = console.rows * CONSOLE_CELL_HEIGHT;
+
+    if (console.pending_scroll) {
+        if (console.pending_scroll < console.rows && !console.full_redraw) {
+            // Everything still on screen moves up in one RAM copy
+            int shift = console.pending_scroll * CONSOLE_CELL_HEIGHT;
+            for (int y = 0; y < text_height - shift; y++) {
+                copy_dwords(pixel_at(0, y), pixel_at(0, y + shift), text_width);
+            }
+            mark_dirty(0, 0, text_width, text_height - shift);
+        } else {
+            console.full_redraw = true;
+        }
+        console.pending_scroll = 0;
+    }
+
+    if (console.full_redraw) {
+        for (int row = 0; row < console.rows; row++) {
+            console.dirty_from[row] = 0;
+            console.dirty_to[row] = console.cols;
+        }
+        console.row_dirty = console.rows == 64 ? ~(uint64_t)0 : ((uint64_t)1 << console.rows) - 1;
+        console.full_redraw = false;
+    }
+
+    while (console.row_dirty) {
+        uint32_t low = (uint32_t)console.row_dirty;
+        int row = low ? __builtin_ctz(low) : 32 + __builtin_ctz((uint32_t)(console.row_dirty >> 32));
+        console.row_dirty &= console.row_dirty - 1;
+
+        struct console_cell* line = console_line(row, console.view);
+        int from = console.dirty_from[row];
+        int to = console.dirty_to[row];
+        for (int col = from; col < to; col++) {
+            console_render_cell(col, row, &line[col]);
+        }
+        mark_dirty(from * CONSOLE_CELL_WIDTH, row * CONSOLE_CELL_HEIGHT,
+                   (to - from) * CONSOLE_CELL_WIDTH, CONSOLE_CELL_HEIGHT);
+    }
+}
+
+// Empty every live cell
+static void console_clear_cells(void) {
+    for (int row = 0; row < console.rows; row++) {
+        struct console_cell* line = console_line(row, 0);
+        for (int col = 0; col < console.cols; col++) {
+            line[col].ch = ' ';
+            line[col].attr = 0;
+        }
+    }
+    console.view = 0;
+    console.row_dirty = 0;
+    console.pending_scroll = 0;
+    console.full_redraw = false;
+}
+
+// Copy the dirty parts of the back buffer to the framebuffer. Rows that
+// already match what is on screen are skipped, so a full redraw that
+// only changed a few lines only writes those lines.
+void vbe_present(void) {
+    console_render();
+    if (!vbe_state.back_buffer) return;
+
+    uint32_t fb_stride = vbe_state.pitch / 4;
+    uint32_t stride = vbe_state.surface_stride;
+    for (int i = 0; i < dirty_count; i++) {
+        struct dirty_rect* r = &dirty_rects[i];
+        uint32_t span = r->x1 - r->x0;
+        for (int y = r->y0; y < r->y1; y++) {
+            uint32_t* src = vbe_state.back_buffer + y * stride + r->x0;
+            uint32_t* seen = vbe_state.shadow + y * stride + r->x0;
+            if (vbe_state.shadow_valid && spans_equal(src, seen, span)) {
+                continue;
+            }
+            copy_dwords(vbe_state.framebuffer + y * fb_stride + r->x0, src, span);
+            copy_dwords(seen, src, span);
+        }
+    }
+    dirty_count = 0;
+    vbe_state.shadow_valid = true;
+}
+
+// Group drawing calls so they reach the screen in one present
+void vbe_begin_update(void) {
+    update_depth++;
+}
+
+void vbe_end_update(void) {
+    if (update_depth > 0 && --update_depth == 0) {
+        vbe_present();
+    }
+}
+
+// Forget what is on screen and repaint everything on the next present,
+// for code that wrote the framebuffer behind our back
+void vbe_invalidate(void) {
+    vbe_state.shadow_valid = false;
+    mark_dirty(0, 0, vbe_state.width, vbe_state.height);
+    auto_present();
+}
+
 
 // Draw the cursor at current position
 void vbe_draw_cursor(void) {
     if (!vbe_state.initialized) return;
+
+    // The cursor is drawn over the cells, so they must be current
+    console_render();
     
     // Always show cursor when active, otherwise respect blink state
     if (!cursor_active && !cursor_visible) {
@@ -55,11 +436,13 @@ void vbe_draw_cursor(void) {
             for (int px = vbe_cursor_x; px < vbe_cursor_x + 1; px++) {  // Reduced width to 1 pixel
                 if (px >= 0 && px < vbe_state.width &&
                     py >= 0 && py < vbe_state.height) {
-                    uint32_t* pixel = vbe_state.framebuffer + py * (vbe_state.pitch / 4) + px;
+                    uint32_t* pixel = pixel_at(px, py);
                     *pixel ^= 0xFFFFFFFF;  // XOR with white to restore original pixels
                 }
             }
         }
+        mark_dirty(vbe_cursor_x, vbe_cursor_y, 1, font_8x16.height);
+        auto_present();
         return;
     }
     
@@ -72,11 +455,13 @@ void vbe_draw_cursor(void) {
         for (int px = vbe_cursor_x; px < vbe_cursor_x + cursor_width; px++) {
             if (px >= 0 && px < vbe_state.width &&
                 py >= 0 && py < vbe_state.height) {
-                uint32_t* pixel = vbe_state.framebuffer + py * (vbe_state.pitch / 4) + px;
+                uint32_t* pixel = pixel_at(px, py);
                 *pixel ^= 0xFFFFFFFF;  // XOR with white to invert pixels
             }
         }
     }
+    mark_dirty(vbe_cursor_x, vbe_cursor_y, cursor_width, cursor_height);
+    auto_present();
 }
 
 // Update cursor blink state
@@ -100,6 +485,8 @@ void vbe_update_cursor(uint32_t current_time) {
 
 // Set cursor position
 void vbe_set_cursor(int x, int y) {
+    vbe_begin_update();
+
     // Erase cursor at old position
     if (cursor_visible) {
         vbe_draw_rect(vbe_cursor_x, vbe_cursor_y, 2, font_8x16.height, 0x00000000);
@@ -112,6 +499,8 @@ void vbe_set_cursor(int x, int y) {
     if (cursor_visible) {
         vbe_draw_cursor();
     }
+
+    vbe_end_update();
 }
 
 // Set cursor active state
@@ -152,7 +541,38 @@ void vbe_init(uint32_t multiboot_magic, void* multiboot_info) {
     vbe_state.height = mode_info->height;
     vbe_state.pitch = mode_info->pitch;
     vbe_state.bpp = mode_info->bpp;
+    vbe_state.surface = vbe_state.framebuffer;
+    vbe_state.surface_stride = vbe_state.pitch / 4;
     vbe_state.initialized = true;
+
+    // Size the text console to the mode
+    console.cols = vbe_state.width / CONSOLE_CELL_WIDTH;
+    console.rows = vbe_state.height / CONSOLE_CELL_HEIGHT;
+    if (console.cols > CONSOLE_MAX_COLS) console.cols = CONSOLE_MAX_COLS;
+    if (console.rows > CONSOLE_MAX_ROWS) console.rows = CONSOLE_MAX_ROWS;
+    console_clear_cells();
+}
+
+// Draw 8-pixel glyph rows transparently. Clipping is worked out once
+// per glyph; each row is then a masked store through the row LUT.
+static void blit_glyph(int x, int y, const uint8_t* rows, int height, uint32_t color) {
+    int py0 = y < 0 ? -y : 0;
+    int py1 = y + height > (int)vbe_state.height ? (int)vbe_state.height - y : height;
+    int px0 = x < 0 ? -x : 0;
+    int px1 = x + 8 > (int)vbe_state.width ? (int)vbe_state.width - x : 8;
+    if (py0 >= py1 || px0 >= px1) return;
+
+    uint8_t clip = (uint8_t)((0xFF >> px0) & (0xFF << (8 - px1)));
+    for (int py = py0; py < py1; py++) {
+        uint8_t bits = rows[py] & clip;
+        if (!bits) continue;
+
+        const uint32_t* mask = font_row_mask(bits);
+        uint32_t* pixel = pixel_at(x, y + py);
+        for (int px = px0; px < px1; px++) {
+            pixel[px] = (pixel[px] & ~mask[px]) | (color & mask[px]);
+        }
+    }
 }
 
 // Draw a single character
@@ -162,34 +582,15 @@ void vbe_draw_char(int x, int y, char c, uint32_t color, const struct font* font
     // Convert char to unsigned to properly handle extended ASCII
     unsigned char uc = (unsigned char)c;
     
-    // Calculate the correct index in the font data
-    // For standard ASCII (32-127), subtract 0x20
-    // For extended ASCII (128-255), use the character code directly
-    size_t index;
-    if (uc < 128) {
-        index = (uc - 0x20) * font->height;
-    } else {
-        index = uc * font->height;
-    }
+    // Characters the font does not cover draw nothing
+    if (uc < font->first_char || uc > font->last_char) return;
+    size_t index = (uc - font->first_char) * font->height;
     
     // Get character bitmap
     const uint8_t* bitmap = &font->data[index];
-    
-    // Draw each pixel of the character
-    for (int py = 0; py < font->height; py++) {
-        for (int px = 0; px < font->width; px++) {
-            if (bitmap[py] & (1 << (7 - px))) {
-                int screen_x = x + px;
-                int screen_y = y + py;
-                
-                if (screen_x >= 0 && screen_x < vbe_state.width &&
-                    screen_y >= 0 && screen_y < vbe_state.height) {
-                    uint32_t* pixel = vbe_state.framebuffer + screen_y * (vbe_state.pitch / 4) + screen_x;
-                    *pixel = color;
-                }
-            }
-        }
-    }
+    blit_glyph(x, y, bitmap, font->height, color);
+    mark_dirty(x, y, font->width, font->height);
+    auto_present();
 }
 
 // Draw a string
@@ -199,6 +600,7 @@ void vbe_draw_string(int x, int y, const char* str, uint32_t color, const struct
     int current_x = x;
     int current_y = y;
     
+    vbe_begin_update();
     while (*str) {
         if (*str == '\n') {
             current_x = x;
@@ -215,6 +617,7 @@ void vbe_draw_string(int x, int y, const char* str, uint32_t color, const struct
         }
         str++;
     }
+    vbe_end_update();
 }
 
 // Draw a string centered horizontally
@@ -230,15 +633,18 @@ void vbe_draw_string_centered(int y, const char* str, uint32_t color, const stru
 void vbe_draw_rect(int x, int y, int width, int height, uint32_t color) {
     if (!vbe_state.initialized) return;
     
-    for (int py = y; py < y + height; py++) {
-        for (int px = x; px < x + width; px++) {
-            if (px >= 0 && px < vbe_state.width &&
-                py >= 0 && py < vbe_state.height) {
-                uint32_t* pixel = vbe_state.framebuffer + py * (vbe_state.pitch / 4) + px;
-                *pixel = color;
-            }
-        }
+    // Clip once, then fill whole rows
+    int x0 = x < 0 ? 0 : x;
+    int y0 = y < 0 ? 0 : y;
+    int x1 = x + width > (int)vbe_state.width ? (int)vbe_state.width : x + width;
+    int y1 = y + height > (int)vbe_state.height ? (int)vbe_state.height : y + height;
+    if (x0 >= x1 || y0 >= y1) return;
+
+    for (int py = y0; py < y1; py++) {
+        fill_dwords(pixel_at(x0, py), color, x1 - x0);
     }
+    mark_dirty(x0, y0, x1 - x0, y1 - y0);
+    auto_present();
 }
 
 // Clear the screen
@@ -246,11 +652,10 @@ void vbe_clear_screen(uint32_t color) {
     if (!vbe_state.initialized) return;
     
     for (int y = 0; y < vbe_state.height; y++) {
-        for (int x = 0; x < vbe_state.width; x++) {
-            uint32_t* pixel = vbe_state.framebuffer + y * (vbe_state.pitch / 4) + x;
-            *pixel = color;
-        }
+        fill_dwords(pixel_at(0, y), color, vbe_state.width);
     }
+    mark_dirty(0, 0, vbe_state.width, vbe_state.height);
+    auto_present();
 }
 
 // Get screen width
@@ -281,97 +686,139 @@ void terminal_initialize(void) {
 }
 
 void terminal_clear(void) {
-    vbe_clear_screen(0x00000000); // Black background
+    vbe_begin_update();
+    console_clear_cells();
+    vbe_clear_screen(CONSOLE_BG); // Blank cells need no rendering, one fill covers them
     vbe_cursor_x = 0;
     vbe_cursor_y = 0;
     cursor_visible = true;  // Reset cursor visibility
     // Don't change cursor_active state here
     cursor_blink_time = timer_get_ticks();  // Reset blink timer
     vbe_draw_cursor();  // Draw cursor with current state
+    vbe_end_update();
 }
 
-void terminal_putchar(char c) {
-    // Only set cursor as active if it's already active
-    if (cursor_active) {
-        vbe_set_cursor_active(true);
-    }
-    
-    // Erase current cursor before drawing new content
-    if (cursor_active) {
-        vbe_draw_rect(vbe_cursor_x, vbe_cursor_y, 2, font_8x16.height, 0x00000000);
+// Write one character at the cursor into the cell grid
+static void console_putchar(char c, uint32_t color) {
+    if (!vbe_state.initialized) return;
+
+    vbe_begin_update();
+    console_snap_to_live();
+
+    int col = vbe_cursor_x / CONSOLE_CELL_WIDTH;
+    int row = vbe_cursor_y / CONSOLE_CELL_HEIGHT;
+
+    // Erase current cursor by rendering the cell under it again
+    if (cursor_active && row < console.rows && col < console.cols) {
+        console_mark(row, col, col + 1);
     }
     
     if (c == '\n') {
-        vbe_cursor_x = 0;
-        vbe_cursor_y += font_get_char_height(c);
+        col = 0;
+        row++;
     } else if (c == '\b') {  // Handle backspace
-        if (vbe_cursor_x > 0) {
-            vbe_cursor_x -= font_get_char_width(' ');  // Move cursor back
-            // Clear the character at cursor position
-            vbe_draw_rect(vbe_cursor_x, vbe_cursor_y, font_get_char_width(' '), font_8x16.height, 0x00000000);
+        if (col > 0) {
+            col--;
+            console_put(col, row, ' ', color);
         }
     } else {
-        vbe_draw_char_font_loader(vbe_cursor_x, vbe_cursor_y, c, current_color);
-        vbe_cursor_x += font_get_char_width(c);
+        console_put(col, row, c, color);
+        col++;
         
         // Check for line wrapping
-        if (vbe_cursor_x + font_get_char_width(c) > vbe_state.width) {
-            vbe_cursor_x = 0;
-            vbe_cursor_y += font_get_char_height(c);
+        if (col >= console.cols) {
+            col = 0;
+            row++;
         }
     }
     
     // Handle scrolling if we're at the bottom of the screen
-    if (vbe_cursor_y >= vbe_state.height) {
-        // Calculate line height
-        int line_height = font_get_char_height(c);
-        
-        // Move everything up by one line
-        for (int y = 0; y < vbe_state.height - line_height; y++) {
-            for (int x = 0; x < vbe_state.width; x++) {
-                uint32_t* src = vbe_state.framebuffer + (y + line_height) * (vbe_state.pitch / 4) + x;
-                uint32_t* dst = vbe_state.framebuffer + y * (vbe_state.pitch / 4) + x;
-                *dst = *src;
-            }
-        }
-        
-        // Clear the last line
-        for (int y = vbe_state.height - line_height; y < vbe_state.height; y++) {
-            for (int x = 0; x < vbe_state.width; x++) {
-                uint32_t* pixel = vbe_state.framebuffer + y * (vbe_state.pitch / 4) + x;
-                *pixel = 0;
-            }
-        }
-        
-        // Adjust cursor position
-        vbe_cursor_y = vbe_state.height - line_height;
+    while (row >= console.rows) {
+        console_scroll();
+        row--;
     }
+
+    vbe_cursor_x = col * CONSOLE_CELL_WIDTH;
+    vbe_cursor_y = row * CONSOLE_CELL_HEIGHT;
     
     // Draw new cursor position only if active
     if (cursor_active) {
         vbe_draw_cursor();
     }
+
+    vbe_end_update();
+}
+
+void terminal_putchar(char c) {
+    console_putchar(c, current_color);
 }
 
 void terminal_putentryat(char c, uint8_t color, size_t x, size_t y) {
-    // Convert from character coordinates to pixel coordinates
-    int pixel_x = x * font_get_char_width(c);
-    int pixel_y = y * font_get_char_height(c);
-    
-    // Draw the character
-    vbe_draw_char_font_loader(pixel_x, pixel_y, c, color);
+    terminal_putcell(x, y, c, color);
     
     // Update cursor position
-    vbe_cursor_x = pixel_x + font_get_char_width(c);
-    vbe_cursor_y = pixel_y;
+    vbe_cursor_x = (x + 1) * CONSOLE_CELL_WIDTH;
+    vbe_cursor_y = y * CONSOLE_CELL_HEIGHT;
+}
+
+// Put a character in a cell without moving the cursor
+void terminal_putcell(size_t x, size_t y, char c, uint32_t color) {
+    if (!vbe_state.initialized) return;
+    console_snap_to_live();
+    console_put(x, y, c, color);
+    auto_present();
+}
+
+void terminal_writestring_at(size_t x, size_t y, const char* data, uint32_t color) {
+    if (!data) return;
+    vbe_begin_update();
+    while (*data && x < (size_t)console.cols) {
+        terminal_putcell(x++, y, *data++, color);
+    }
+    vbe_end_update();
+}
+
+// Blank the cursor's row from the cursor to the right edge
+void terminal_clear_to_eol(void) {
+    if (!vbe_state.initialized) return;
+    vbe_begin_update();
+    int row = vbe_cursor_y / CONSOLE_CELL_HEIGHT;
+    for (int col = vbe_cursor_x / CONSOLE_CELL_WIDTH; col < console.cols; col++) {
+        terminal_putcell(col, row, ' ', CONSOLE_BG);
+    }
+    vbe_end_update();
+}
+
+// Move the view into the scrollback; positive 'lines' goes back in
+// history. Any output returns to the live screen.
+void terminal_scroll_view(int lines) {
+    int view = console.view + lines;
+    if (view < 0) view = 0;
+    if (view > console.history) view = console.history;
+    if (view == console.view) return;
+
+    console.view = view;
+    console.full_redraw = true;
+    vbe_present();
 }
 
 void terminal_writestring(const char* data) {
     if (!data) return;
     
+    // One present for the whole string
+    vbe_begin_update();
     while (*data) {
         terminal_putchar(*data++);
     }
+    vbe_end_update();
+}
+
+void terminal_write(const char* data, size_t size) {
+    vbe_begin_update();
+    for (size_t i = 0; i < size; i++) {
+        terminal_putchar(data[i]);
+    }
+    vbe_end_update();
 }
 
 void terminal_writehex(uint32_t n) {
@@ -386,18 +833,18 @@ void terminal_writehex(uint32_t n) {
 }
 
 void terminal_get_cursor(size_t* x, size_t* y) {
-    if (x) *x = vbe_cursor_x / font_get_char_width(' ');
-    if (y) *y = vbe_cursor_y / font_get_char_height(' ');
+    if (x) *x = vbe_cursor_x / CONSOLE_CELL_WIDTH;
+    if (y) *y = vbe_cursor_y / CONSOLE_CELL_HEIGHT;
 }
 
 void terminal_update_cursor(void) {
     // Ensure cursor stays within screen bounds
     if (vbe_cursor_x >= vbe_state.width) {
         vbe_cursor_x = 0;
-        vbe_cursor_y += font_get_char_height(' ');
+        vbe_cursor_y += CONSOLE_CELL_HEIGHT;
     }
     if (vbe_cursor_y >= vbe_state.height) {
-        vbe_cursor_y = vbe_state.height - font_get_char_height(' ');
+        vbe_cursor_y = vbe_state.height - CONSOLE_CELL_HEIGHT;
     }
 }
 
@@ -407,24 +854,16 @@ void vbe_setcolor(uint32_t color) {
 }
 
 void terminal_putchar_color(char c, uint32_t color) {
-    if (c == '\n') {
-        vbe_cursor_x = 0;
-        vbe_cursor_y += font_8x16.height;
-    } else {
-        vbe_draw_char(vbe_cursor_x, vbe_cursor_y, c, color, &font_8x16);
-        vbe_cursor_x += font_8x16.width;
-        if (vbe_cursor_x + font_8x16.width > vbe_state.width) {
-            vbe_cursor_x = 0;
-            vbe_cursor_y += font_8x16.height;
-        }
-    }
+    console_putchar(c, color);
 }
 
 void terminal_writestring_color(const char* data, uint32_t color) {
     if (!data) return;
+    vbe_begin_update();
     while (*data) {
         terminal_putchar_color(*data++, color);
     }
+    vbe_end_update();
 }
 
 // Draw a character using a PSF1 font
@@ -432,23 +871,10 @@ void vbe_draw_char_psf1(int x, int y, char c, uint32_t color, const PSF1Font* fo
     if (!font || x < 0 || y < 0 || x >= vbe_state.width || y >= vbe_state.height) return;
     
     // Get the glyph for this character
-    uint8_t* glyph = &font->glyphs[c * font->header.char_height];
-    
-    // Draw each pixel of the glyph
-    for (int row = 0; row < font->header.char_height; row++) {
-        uint8_t bits = glyph[row];
-        for (int col = 0; col < 8; col++) {  // PSF1 fonts are always 8 pixels wide
-            // Check if the bit is set (1 means draw the pixel)
-            if (bits & (0x80 >> col)) {
-                int pixel_x = x + col;
-                int pixel_y = y + row;
-                if (pixel_x < vbe_state.width && pixel_y < vbe_state.height) {
-                    uint32_t* pixel = vbe_state.framebuffer + pixel_y * (vbe_state.pitch / 4) + pixel_x;
-                    *pixel = color;
-                }
-            }
-        }
-    }
+    const uint8_t* glyph = &font->glyphs[(unsigned char)c * font->header.char_height];
+    blit_glyph(x, y, glyph, font->header.char_height, color);
+    mark_dirty(x, y, 8, font->header.char_height);
+    auto_present();
 }
 
 // Draw a string using a PSF1 font
@@ -456,11 +882,13 @@ void vbe_draw_string_psf1(int x, int y, const char* str, uint32_t color, const P
     if (!str || !font) return;
     
     int current_x = x;
+    vbe_begin_update();
     while (*str) {
         vbe_draw_char_psf1(current_x, y, *str, color, font);
         current_x += 8;  // PSF1 fonts are always 8 pixels wide
         str++;
     }
+    vbe_end_update();
 }
 
 // Draw a string centered horizontally using a PSF1 font
@@ -476,29 +904,12 @@ void vbe_draw_string_centered_psf1(int y, const char* str, uint32_t color, const
 void vbe_draw_char_font_loader(int x, int y, char c, uint32_t color) {
     if (!vbe_state.initialized) return;
     
-    // Get character bitmap and dimensions
+    // Glyph rows come straight from the font loader's cache
     const uint8_t* bitmap = font_get_char_bitmap(c);
-    int width = font_get_char_width(c);
-    int height = font_get_char_height(c);
-    
-    // Draw each pixel of the character
-    for (int py = 0; py < height; py++) {
-        for (int px = 0; px < width; px++) {
-            int byte_index = py * ((width + 7) / 8);
-            int bit_index = 7 - (px % 8);  // Most significant bit first
-            
-            if (bitmap[byte_index] & (1 << bit_index)) {
-                int screen_x = x + px;
-                int screen_y = y + py;
-                
-                if (screen_x >= 0 && screen_x < vbe_state.width &&
-                    screen_y >= 0 && screen_y < vbe_state.height) {
-                    uint32_t* pixel = vbe_state.framebuffer + screen_y * (vbe_state.pitch / 4) + screen_x;
-                    *pixel = color;
-                }
-            }
-        }
-    }
+    int height = font_get_height();
+    blit_glyph(x, y, bitmap, height, color);
+    mark_dirty(x, y, 8, height);
+    auto_present();
 }
 
 // Draw a string using the font loader
@@ -508,6 +919,7 @@ void vbe_draw_string_font_loader(int x, int y, const char* str, uint32_t color)
     int current_x = x;
     int current_y = y;
     
+    vbe_begin_update();
     while (*str) {
         if (*str == '\n') {
             current_x = x;
@@ -524,6 +936,7 @@ void vbe_draw_string_font_loader(int x, int y, const char* str, uint32_t color)
         }
         str++;
     }
+    vbe_end_update();
 }
 
 // Draw a string centered horizontally using the font loader
@@ -560,7 +973,126 @@ void vbe_put_pixel(int x, int y, uint32_t color) {
         return;
     }
 
-    uint32_t* pixel = vbe_state.framebuffer + y * (vbe_state.pitch / 4) + x;
+    uint32_t* pixel = pixel_at(x, y);
     *pixel = color;
+    mark_dirty(x, y, 1, 1);
+    auto_present();
+}
+
+// Map the framebuffer write-combining (needs paging for PAT, else an MTRR)
+bool vbe_enable_write_combining(void) {
+    if (!vbe_state.initialized) return false;
+
+    uint32_t size = vbe_state.pitch * vbe_state.height;
+    vbe_state.write_combining = vmm_set_write_combining((uint32_t)vbe_state.framebuffer, size);
+    return vbe_state.write_combining;
+}
+
+// Each bench pattern runs for this many timer ticks (100 Hz)
+#define VBE_BENCH_TICKS 25
+
+static uint32_t bench_mbps(uint64_t bytes, uint32_t ticks) {
+    if (ticks == 0) ticks = 1;
+    return (uint32_t)((bytes * 100) / ((uint64_t)ticks * 1024 * 1024));
+}
+
+// Measure fill, RAM->VRAM copy and VRAM->VRAM scroll throughput
+static void bench_pass(uint32_t results[3], const uint32_t* row) {
+    volatile uint32_t* fb = vbe_state.framebuffer;
+    uint32_t stride = vbe_state.pitch / 4;
+    uint32_t frame_bytes = vbe_state.pitch * vbe_state.height;
+    uint32_t line_height = 16;
+    uint64_t bytes;
+    uint32_t start;
+
+    // Solid fills, like vbe_clear_screen
+    bytes = 0;
+    start = timer_get_ticks();
+    uint32_t color = 0;
+    while (timer_get_ticks() - start < VBE_BENCH_TICKS) {
+        for (uint32_t i = 0; i < stride * vbe_state.height; i++) {
+            fb[i] = color;
+        }
+        color += 0x00010101;
+        bytes += frame_bytes;
+    }
+    results[0] = bench_mbps(bytes, timer_get_ticks() - start);
+
+    // Copies from RAM, like blitting rendered text
+    bytes = 0;
+    start = timer_get_ticks();
+    while (timer_get_ticks() - start < VBE_BENCH_TICKS) {
+        for (uint32_t y = 0; y < vbe_state.height; y++) {
+            volatile uint32_t* dst = fb + y * stride;
+            for (uint32_t x = 0; x < vbe_state.width; x++) {
+                dst[x] = row[x];
+            }
+        }
+        bytes += vbe_state.width * 4 * vbe_state.height;
+    }
+    results[1] = bench_mbps(bytes, timer_get_ticks() - start);
+
+    // Framebuffer to framebuffer, like the terminal scroll
+    bytes = 0;
+    start = timer_get_ticks();
+    while (timer_get_ticks() - start < VBE_BENCH_TICKS) {
+        for (uint32_t y = line_height; y < vbe_state.height; y++) {
+            volatile uint32_t* src = fb + y * stride;
+            volatile uint32_t* dst = fb + (y - line_height) * stride;
+            for (uint32_t x = 0; x < vbe_state.width; x++) {
+                dst[x] = src[x];
+            }
+        }
+        bytes += vbe_state.width * 4 * (vbe_state.height - line_height);
+    }
+    results[2] = bench_mbps(bytes, timer_get_ticks() - start);
 }
 
+void vbe_bench(void) {
+    if (!vbe_state.initialized) {
+        terminal_writestring("No framebuffer available\n");
+        return;
+    }
+
+    uint32_t* row = (uint32_t*)kmalloc(vbe_state.width * 4);
+    if (!row) {
+        terminal_writestring("Failed to allocate memory\n");
+        return;
+    }
+    for (uint32_t x = 0; x < vbe_state.width; x++) {
+        row[x] = x * 0x00010203;
+    }
+
+    void* fb = vbe_state.framebuffer;
+    uint32_t size = vbe_state.pitch * vbe_state.height;
+    uint32_t before[3];
+    uint32_t after[3];
+
+    // With PAT the mapping can be flipped back to uncached for a baseline
+    bool compare = vbe_state.write_combining && vmm_has_pat();
+    if (compare) {
+        vmm_set_cache_flags(fb, size, VMM_NO_CACHE);
+        bench_pass(before, row);
+        vmm_set_cache_flags(fb, size, VMM_WRITE_COMBINING);
+    }
+    bench_pass(after, row);
+    kfree(row);
+
+    // The passes wrote the framebuffer directly, so repaint all of it
+    vbe_begin_update();
+    vbe_invalidate();
+    terminal_clear();
+    static const char* names[3] = { "fill             ", "copy RAM->VRAM   ", "scroll VRAM->VRAM" };
+    if (compare) {
+        printf("Framebuffer MB/s     uncached  write-combining\n");
+        for (int i = 0; i < 3; i++) {
+            printf("  %s %9u %16u\n", names[i], before[i], after[i]);
+        }
+    } else {
+        printf("Framebuffer MB/s (%s)\n", vbe_state.write_combining ? "write-combining via MTRR" : "default caching");
+        for (int i = 0; i < 3; i++) {
+            printf("  %s %9u\n", names[i], after[i]);
+        }
+    }
+    vbe_end_update();
+}
@@ -0,0 +1,349 @@
+#include "../../include/drivers/virtio_blk.h"
+#include "../../include/drivers/pci.h"
+#include "../../include/io.h"
+#include "../../include/stdio.h"
+#include "../../include/string.h"
+#include "../../include/timerDriver.h"
+#include "../../include/memory/pmm.h"
+#include "../../include/memory/vmm.h"
+#include <stddef.h>
+
+// One request in flight: its header, status byte and the indirect table
+// that the single ring descriptor of the request points at
+struct virtio_blk_slot {
+    struct virtio_blk_req header;
+    struct virtq_desc table[VIRTIO_BLK_SEGS + 2];
+    volatile uint8_t status;
+} __attribute__((aligned(16)));
+
+static uint16_t io_base = 0;
+static bool initialized = false;
+static uint32_t features;
+static uint64_t capacity;
+static uint32_t max_segs = VIRTIO_BLK_SEGS;
+
+// Queue 0
+static uint16_t queue_size;
+static struct virtq_desc* desc;
+static struct virtq_avail* avail;
+static struct virtq_used* used;
+static uint16_t avail_idx;      // Next free avail ring entry
+static uint16_t last_used;      // Next used entry to reap
+static struct virtio_blk_slot* slots;
+static uint8_t* queue_memory;
+static uint32_t queue_pages;
+
+#define USED_EVENT   (*(volatile uint16_t*)&avail->ring[queue_size])
+#define AVAIL_EVENT  (*(volatile uint16_t*)((uint8_t*)used + 4 + 8 * queue_size))
+
+#define barrier() __sync_synchronize()
+#define ALL_SLOTS ((uint32_t)(((uint64_t)1 << VIRTIO_BLK_DEPTH) - 1))
+
+// Physical address of a buffer byte. RAM below VMM_KERNEL_TOP is
+// identity mapped; the windows above it have to be translated.
+static uint32_t virtio_physical(const uint8_t* addr) {
+    if ((uint32_t)addr < VMM_KERNEL_TOP) {
+        return (uint32_t)addr;
+    }
+    return vmm_get_physical(NULL, (void*)addr);
+}
+
+// Fill a slot's indirect table: header, data segments merged where the
+// buffer is physically contiguous, status. Returns the sectors covered.
+static uint32_t virtio_blk_prepare(int s, uint32_t type, uint64_t sector, uint32_t count, uint8_t* buffer) {
+    struct virtio_blk_slot* slot = &slots[s];
+    slot->header.type = type;
+    slot->header.reserved = 0;
+    slot->header.sector = sector;
+    slot->status = 0xFF;
+
+    struct virtq_desc* table = slot->table;
+    table[0].addr = (uint32_t)&slot->header;
+    table[0].len = sizeof(slot->header);
+    table[0].flags = VIRTQ_DESC_F_NEXT;
+
+    uint16_t n = 1;
+    uint32_t bytes = count * 512;
+    uint32_t done = 0;
+    uint16_t data_flags = VIRTQ_DESC_F_NEXT | (type == VIRTIO_BLK_T_IN ? VIRTQ_DESC_F_WRITE : 0);
+    while (done < bytes) {
+        uint32_t phys = virtio_physical(buffer + done);
+        uint32_t chunk = PAGE_SIZE - (phys & (PAGE_SIZE - 1));
+        if (chunk > bytes - done) chunk = bytes - done;
+        if (n > 1 && table[n - 1].addr + table[n - 1].len == phys) {
+            table[n - 1].len += chunk;
+        } else {
+            if (n - 1u == max_segs) break;
+            table[n].addr = phys;
+            table[n].len = chunk;
+            table[n].flags = data_flags;
+            n++;
+        }
+        done += chunk;
+    }
+
+    // Only whole sectors; drop a partly described last one
+    uint32_t extra = done % 512;
+    while (extra) {
+        if (table[n - 1].len > extra) {
+            table[n - 1].len -= extra;
+            break;
+        }
+        extra -= table[n - 1].len;
+        n--;
+    }
+    count = done / 512;
+    if (count == 0 && type != VIRTIO_BLK_T_FLUSH) {
+        return 0;
+    }
+
+    table[n].addr = (uint32_t)&slot->status;
+    table[n].len = 1;
+    table[n].flags = VIRTQ_DESC_F_WRITE;
+    for (uint16_t i = 0; i < n; i++) {
+        table[i].next = i + 1;
+    }
+    n++;
+
+    // Ring descriptor 's' belongs to slot 's'
+    desc[s].addr = (uint32_t)table;
+    desc[s].len = n * sizeof(struct virtq_desc);
+    desc[s].flags = VIRTQ_DESC_F_INDIRECT;
+    desc[s].next = 0;
+    return count ? count : 1;
+}
+
+// Publish the requests added since 'old_idx' and notify the device once,
+// unless it asked not to be
+static void virtio_blk_kick(uint16_t old_idx) {
+    barrier();
+    avail->idx = avail_idx;
+    barrier();
+
+    bool notify;
+    if (features & VIRTIO_F_EVENT_IDX) {
+        // Notify only if avail_event lies in the batch just published
+        uint16_t event = AVAIL_EVENT;
+        notify = (uint16_t)(avail_idx - event - 1) < (uint16_t)(avail_idx - old_idx);
+    } else {
+        notify = !(used->flags & VIRTQ_USED_F_NO_NOTIFY);
+    }
+    if (notify) {
+        outw(io_base + VIRTIO_PCI_QUEUE_NOTIFY, 0);
+    }
+}
+
+// Reset the device and bring queue 0 up empty. The queue memory is
+// allocated on the first call and reused after a reset.
+static bool virtio_blk_start(void) {
+    // Reset, then acknowledge the device
+    outb(io_base + VIRTIO_PCI_STATUS, 0);
+    outb(io_base + VIRTIO_PCI_STATUS, VIRTIO_STATUS_ACK);
+    outb(io_base + VIRTIO_PCI_STATUS, VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER);
+
+    uint32_t offered = inl(io_base + VIRTIO_PCI_HOST_FEATURES);
+    if (!(offered & VIRTIO_F_INDIRECT_DESC)) {
+        printf("virtio-blk: device lacks indirect descriptors\n");
+        outb(io_base + VIRTIO_PCI_STATUS, VIRTIO_STATUS_FAILED);
+        return false;
+    }
+    features = offered & (VIRTIO_F_INDIRECT_DESC | VIRTIO_F_EVENT_IDX | VIRTIO_BLK_F_RO |
+                          VIRTIO_BLK_F_FLUSH | VIRTIO_BLK_F_SEG_MAX);
+    outl(io_base + VIRTIO_PCI_GUEST_FEATURES, features);
+
+    capacity = inl(io_base + VIRTIO_PCI_CONFIG + VIRTIO_BLK_CFG_CAPACITY) |
+               ((uint64_t)inl(io_base + VIRTIO_PCI_CONFIG + VIRTIO_BLK_CFG_CAPACITY + 4) << 32);
+    if (features & VIRTIO_BLK_F_SEG_MAX) {
+        uint32_t seg_max = inl(io_base + VIRTIO_PCI_CONFIG + VIRTIO_BLK_CFG_SEG_MAX);
+        if (seg_max && seg_max < max_segs) {
+            max_segs = seg_max;
+        }
+    }
+
+    // Queue 0: the legacy layout is descriptors and avail ring, then the
+    // used ring on the next page boundary, all physically contiguous
+    outw(io_base + VIRTIO_PCI_QUEUE_SELECT, 0);
+    uint16_t size = inw(io_base + VIRTIO_PCI_QUEUE_SIZE);
+    if (size < VIRTIO_BLK_DEPTH || (queue_memory && size != queue_size)) {
+        printf("virtio-blk: unusable queue size %u\n", size);
+        outb(io_base + VIRTIO_PCI_STATUS, VIRTIO_STATUS_FAILED);
+        return false;
+    }
+    queue_size = size;
+    uint32_t ring_bytes = (16 * queue_size + 6 + 2 * queue_size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    uint32_t used_bytes = (6 + 8 * queue_size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    uint32_t slot_pages = (VIRTIO_BLK_DEPTH * sizeof(struct virtio_blk_slot) + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (!queue_memory) {
+        queue_pages = (ring_bytes + used_bytes) / PAGE_SIZE;
+        queue_memory = (uint8_t*)pmm_alloc_pages(queue_pages, PAGE_SIZE);
+        slots = (struct virtio_blk_slot*)pmm_alloc_pages(slot_pages, PAGE_SIZE);
+        if (!queue_memory || !slots) {
+            printf("virtio-blk: out of memory for the queue\n");
+            if (queue_memory) pmm_free_pages(queue_memory, queue_pages);
+            if (slots) pmm_free_pages(slots, slot_pages);
+            queue_memory = NULL;
+            slots = NULL;
+            outb(io_base + VIRTIO_PCI_STATUS, VIRTIO_STATUS_FAILED);
+            return false;
+        }
+    }
+    memset(queue_memory, 0, queue_pages * PAGE_SIZE);
+    memset(slots, 0, slot_pages * PAGE_SIZE);
+    desc = (struct virtq_desc*)queue_memory;
+    avail = (struct virtq_avail*)(queue_memory + 16 * queue_size);
+    used = (struct virtq_used*)(queue_memory + ring_bytes);
+    avail_idx = 0;
+    last_used = 0;
+
+    // Completions are polled, so the device never needs to interrupt.
+    // With EVENT_IDX the flag is ignored and used_event does the same job.
+    avail->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+    USED_EVENT = (uint16_t)(last_used - 1);
+    outl(io_base + VIRTIO_PCI_QUEUE_PFN, (uint32_t)queue_memory / PAGE_SIZE);
+    outb(io_base + VIRTIO_PCI_STATUS, VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+    return true;
+}
+
+// After a timeout the device may still own the slots in flight. A reset
+// makes it drop the queue, so the slots and rings can be reused.
+static void virtio_blk_recover(void) {
+    initialized = false;
+    if (virtio_blk_start()) {
+        initialized = true;
+        printf("virtio-blk: device reset\n");
+    }
+}
+
+// Keep up to VIRTIO_BLK_DEPTH requests in flight until the range is done.
+// New requests are published in batches with one notification each.
+static bool virtio_blk_transfer(uint32_t type, uint64_t sector, uint32_t count, uint8_t* buffer) {
+    if (!initialized) return false;
+
+    uint32_t busy = 0;
+    bool ok = true;
+    uint32_t start = timer_get_ticks();
+    uint32_t spins = 0;
+    bool flush = type == VIRTIO_BLK_T_FLUSH;
+    while (count || flush || busy) {
+        uint16_t old_idx = avail_idx;
+        while ((count || flush) && busy != ALL_SLOTS) {
+            int s = __builtin_ctz(~busy);
+            uint32_t n = count > VIRTIO_BLK_REQ_SECTORS ? VIRTIO_BLK_REQ_SECTORS : count;
+            n = virtio_blk_prepare(s, type, sector, n, buffer);
+            if (n == 0) {
+                count = 0;  // Misaligned buffer; fail after draining
+                ok = false;
+                break;
+            }
+            avail->ring[avail_idx % queue_size] = s;
+            avail_idx++;
+            busy |= 1u << s;
+            if (flush) {
+                flush = false;
+                break;
+            }
+            sector += n;
+            count -= n;
+            buffer += n * 512;
+        }
+        if (avail_idx != old_idx) {
+            virtio_blk_kick(old_idx);
+        }
+
+        // Reap completions
+        barrier();
+        if (last_used == used->idx) {
+            if (timer_get_ticks() - start > VIRTIO_BLK_TIMEOUT || ++spins > 50000000) {
+                printf("virtio-blk: request timed out\n");
+                virtio_blk_recover();
+                return false;
+            }
+            continue;
+        }
+        while (last_used != used->idx) {
+            uint32_t s = used->ring[last_used % queue_size].id;
+            if (slots[s].status != VIRTIO_BLK_S_OK) {
+                ok = false;
+            }
+            busy &= ~(1u << s);
+            last_used++;
+        }
+        // Keep used_event just behind the reaped entries, so the device
+        // never sees a reason to interrupt
+        if (features & VIRTIO_F_EVENT_IDX) {
+            USED_EVENT = (uint16_t)(last_used - 1);
+        }
+        start = timer_get_ticks();
+        spins = 0;
+    }
+    return ok;
+}
+
+bool virtio_blk_read_sectors(uint64_t sector, uint32_t count, void* buffer) {
+    return virtio_blk_transfer(VIRTIO_BLK_T_IN, sector, count, (uint8_t*)buffer);
+}
+
+bool virtio_blk_write_sectors(uint64_t sector, uint32_t count, const void* buffer) {
+    if (features & VIRTIO_BLK_F_RO) {
+        return false;
+    }
+    if (!virtio_blk_transfer(VIRTIO_BLK_T_OUT, sector, count, (uint8_t*)buffer)) {
+        return false;
+    }
+    // Writes are durable once the device's cache is flushed
+    if (features & VIRTIO_BLK_F_FLUSH) {
+        return virtio_blk_transfer(VIRTIO_BLK_T_FLUSH, 0, 0, NULL);
+    }
+    return true;
+}
+
+// Find the device and its I/O BAR, enabling I/O space and bus mastering
+static bool find_virtio_blk(void) {
+    for (int bus = 0; bus < 256; bus++) {
+        for (int device = 0; device < 32; device++) {
+            for (int function = 0; function < 8; function++) {
+                uint32_t id = pci_config_read(bus, device, function, 0x00);
+                if ((id & 0xFFFF) != VIRTIO_VENDOR_ID || (id >> 16) != VIRTIO_BLK_DEVICE_ID) {
+                    continue;
+                }
+                uint32_t bar0 = pci_config_read(bus, device, function, 0x10);
+                if (!(bar0 & 0x01)) {
+                    continue;  // Modern-only layout, no legacy I/O BAR
+                }
+                io_base = bar0 & 0xFFFC;
+                uint32_t command = pci_config_read(bus, device, function, 0x04);
+                pci_config_write(bus, device, function, 0x04, (command & 0xFFFF) | 0x05);
+                printf("Found virtio-blk at PCI %d:%d.%d, I/O 0x%04x\n", bus, device, function, io_base);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool virtio_blk_init(void) {
+    if (initialized) {
+        return true;
+    }
+    if (!find_virtio_blk()) {
+        printf("virtio-blk device not found\n");
+        return false;
+    }
+    if (!virtio_blk_start()) {
+        return false;
+    }
+
+    initialized = true;
+    printf("virtio-blk: %u sectors, queue %u, %s%s\n", (uint32_t)capacity, queue_size,
+           (features & VIRTIO_F_EVENT_IDX) ? "event index" : "no event index",
+           (features & VIRTIO_BLK_F_RO) ? ", read-only" : "");
+    return true;
+}
+
+bool virtio_blk_is_initialized(void) {
+    return initialized;
+}
+
+uint32_t virtio_blk_get_total_sectors(void) {
+    return capacity > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)capacity;
+}
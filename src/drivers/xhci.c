@@ -3,6 +3,7 @@
 #include "../../include/io.h"
 #include "../../include/stdio.h"
 #include "../../include/memory/heap.h"
+#include "../../include/memory/vmm.h"
 #include "../../include/string.h"
 #include <stddef.h>
 
@@ -433,6 +434,13 @@ bool xhci_detect_controller(uint8_t bus, uint8_t device, uint8_t function) {
     uint32_t bar0 = pci_config_read(bus, device, function, 0x10);
     g_xhci->base_addr = (uint8_t*)(bar0 & 0xFFFFFFF0); // Mask off lower bits
     
+    // Registers must be mapped uncached now that paging is on
+    if (!vmm_map_mmio((uint32_t)g_xhci->base_addr, 0x10000, VMM_WRITE | VMM_NO_CACHE)) {
+        free(g_xhci);
+        g_xhci = NULL;
+        return false;
+    }
+    
     printf("xHCI Base Address: 0x%08x\n", (uint32_t)g_xhci->base_addr);
     
     // Read capability registers
@@ -100,6 +100,9 @@ void editor_free(Editor* editor) {
 
 // Draw the editor interface
 void editor_draw(Editor* editor) {
+    // Batch the redraw; only lines that actually changed reach the screen
+    vbe_begin_update();
+
     // Clear the screen
     vbe_clear_screen(editor->bg_color);
     
@@ -186,6 +189,8 @@ void editor_draw(Editor* editor) {
             display_y * 16  // Convert to pixel coordinates
         );
     }
+
+    vbe_end_update();
 }
 
 // Handle a single character input
@@ -349,55 +354,48 @@ bool editor_load_file(Editor* editor, const char* filename) {
     editor->cursor_y = 0;
     editor->scroll_offset = 0;
 
-    // Allocate buffer for file content
-    char* buffer = (char*)kmalloc(4096);
-    if (!buffer) return false;
-
-    // Read file content
-    int result = fat16_read_file(filename, buffer, 4096);
-    if (result == 0) {  // File not found
-        kfree(buffer);
+    // Read the file in place
+    struct fat16_map map;
+    if (!fat16_map_file(filename, &map)) {  // File not found
         return false;
     }
 
-    // If file is empty (result == -1), just return true with empty editor
-    if (result == -1) {
-        kfree(buffer);
-        editor->filename = strdup(filename);
-        editor->modified = false;
-        return true;
-    }
-
-    // Parse file content into lines
-    char* line_start = buffer;
-    char* current = buffer;
+    // Parse file content into lines, which may span extents
     int line_count = 0;
-
-    while (*current && line_count < EDITOR_MAX_LINES) {
-        if (*current == '\n' || *current == '\0') {
-            // Calculate line length
-            int line_length = current - line_start;
-            if (line_length >= EDITOR_MAX_LINE_LENGTH) {
-                line_length = EDITOR_MAX_LINE_LENGTH - 1;
+    int line_length = 0;
+    bool stop = false;
+    for (int i = 0; i < map.count && !stop; i++) {
+        const char* data = (const char*)map.extents[i].data;
+        for (uint32_t j = 0; j < map.extents[i].length; j++) {
+            char c = data[j];
+            if (c == '\0') {
+                stop = true;
+                break;
+            }
+            if (c == '\n') {
+                editor->lines[line_count][line_length] = '\0';
+                line_length = 0;
+                if (++line_count == EDITOR_MAX_LINES) {
+                    stop = true;
+                    break;
+                }
+            } else if (line_length < EDITOR_MAX_LINE_LENGTH - 1) {
+                editor->lines[line_count][line_length++] = c;
             }
-
-            // Copy line content
-            memcpy(editor->lines[line_count], line_start, line_length);
-            editor->lines[line_count][line_length] = '\0';
-            line_count++;
-
-            // Move to next line
-            line_start = current + 1;
         }
-        current++;
     }
 
+    // Keep a last line that has no newline
+    if (line_length > 0 && line_count < EDITOR_MAX_LINES) {
+        editor->lines[line_count][line_length] = '\0';
+        line_count++;
+    }
+    fat16_unmap_file(&map);
+
     // Set editor state
     editor->num_lines = line_count > 0 ? line_count : 1;
     editor->filename = strdup(filename);
     editor->modified = false;
-
-    kfree(buffer);
     return true;
 }
 
@@ -482,19 +480,19 @@ void editor_insert_char(Editor* editor, char c) {
 
         // Draw only if the line is on screen
         if (display_y >= 0 && display_y < EDITOR_EDITABLE_HEIGHT) {
-            // Redraw the entire line from the modified position
-            vbe_draw_string(LINE_NUMBER_GUTTER_WIDTH * 8, display_y * 16, &line[editor->cursor_x - 1], editor->text_color, &font_8x16);
-
-            // Clear the rest of the line visually
-            for (int i = strlen(line); i < VBE_WIDTH / 8 - LINE_NUMBER_GUTTER_WIDTH; i++) {
-                vbe_draw_char((i + LINE_NUMBER_GUTTER_WIDTH) * 8, display_y * 16, ' ', editor->bg_color, &font_8x16);
-            }
+            // Repaint the line from the modified position to the right edge
+            int col = editor->cursor_x - 1;
+            vbe_begin_update();
+            vbe_draw_rect((col + LINE_NUMBER_GUTTER_WIDTH) * 8, display_y * 16,
+                          VBE_WIDTH - (col + LINE_NUMBER_GUTTER_WIDTH) * 8, 16, editor->bg_color);
+            vbe_draw_string((col + LINE_NUMBER_GUTTER_WIDTH) * 8, display_y * 16, &line[col], editor->text_color, &font_8x16);
 
             // Update VBE cursor position
             vbe_set_cursor(
                 (editor->cursor_x + LINE_NUMBER_GUTTER_WIDTH) * 8,
                 display_y * 16
             );
+            vbe_end_update();
         }
     }
 }
@@ -516,19 +514,19 @@ void editor_delete_char(Editor* editor) {
         
         // Draw only if the line is on screen
         if (display_y >= 0 && display_y < EDITOR_EDITABLE_HEIGHT) {
-            // Redraw the entire line from the modified position
-            vbe_draw_string(LINE_NUMBER_GUTTER_WIDTH * 8, display_y * 16, &line[editor->cursor_x], editor->text_color, &font_8x16);
-            
-            // Clear the rest of the line visually
-            for (int i = strlen(line); i < VBE_WIDTH / 8 - LINE_NUMBER_GUTTER_WIDTH; i++) {
-                vbe_draw_char((i + LINE_NUMBER_GUTTER_WIDTH) * 8, display_y * 16, ' ', editor->bg_color, &font_8x16);
-            }
+            // Repaint the line from the modified position to the right edge
+            int col = editor->cursor_x;
+            vbe_begin_update();
+            vbe_draw_rect((col + LINE_NUMBER_GUTTER_WIDTH) * 8, display_y * 16,
+                          VBE_WIDTH - (col + LINE_NUMBER_GUTTER_WIDTH) * 8, 16, editor->bg_color);
+            vbe_draw_string((col + LINE_NUMBER_GUTTER_WIDTH) * 8, display_y * 16, &line[col], editor->text_color, &font_8x16);
 
             // Update VBE cursor position
             vbe_set_cursor(
                 (editor->cursor_x + LINE_NUMBER_GUTTER_WIDTH) * 8,
                 display_y * 16
             );
+            vbe_end_update();
         }
     }
 }
@@ -595,11 +593,11 @@ void editor_edit_command(const char* filename) {
     editor_free(&editor);
     
     // Clear the screen and restore shell state
-    vbe_clear_screen(0x000000);
+    terminal_clear();
     draw_header();
     
     // Reset cursor position to where the shell expects it
     vbe_cursor_x = 0;
-    vbe_cursor_y = 125;  // Same as in shell_init
+    vbe_cursor_y = 128;  // Same as in shell_init
     draw_prompt();
 }
\ No newline at end of file
@@ -0,0 +1,445 @@
+#include "../../include/fs/bcache.h"
+#include "../../include/memory/heap.h"
+#include "../../include/stdio.h"
+#include "../../include/string.h"
+#include <stddef.h>
+
+#define BCACHE_HASH_SIZE 256
+#define BCACHE_NONE      -1
+
+static struct bcache_buf bufs[BCACHE_BLOCKS];
+static int16_t hash_heads[BCACHE_HASH_SIZE];
+static uint8_t* block_memory = NULL;
+static int clock_hand = 0;
+
+static block_device_t* cache_device = NULL;
+static uint32_t cache_base;
+static uint32_t cache_block_sectors;
+static uint32_t sector_size;
+static uint32_t block_bytes;
+static uint32_t last_flush = 0;
+static struct bcache_stats stats;
+
+static uint32_t block_lba(uint32_t block) {
+    return cache_base + block * cache_block_sectors;
+}
+
+static void hash_insert(int16_t i) {
+    uint32_t bucket = bufs[i].block % BCACHE_HASH_SIZE;
+    bufs[i].hash_next = hash_heads[bucket];
+    hash_heads[bucket] = i;
+}
+
+static void hash_remove(int16_t i) {
+    int16_t* link = &hash_heads[bufs[i].block % BCACHE_HASH_SIZE];
+    while (*link != BCACHE_NONE) {
+        if (*link == i) {
+            *link = bufs[i].hash_next;
+            return;
+        }
+        link = &bufs[*link].hash_next;
+    }
+}
+
+static int16_t hash_find(uint32_t block) {
+    int16_t i = hash_heads[block % BCACHE_HASH_SIZE];
+    while (i != BCACHE_NONE && bufs[i].block != block) {
+        i = bufs[i].hash_next;
+    }
+    return i;
+}
+
+static bool write_back(struct bcache_buf* buf) {
+    if (!cache_device->write_sectors(block_lba(buf->block), cache_block_sectors, buf->data)) {
+        return false;
+    }
+    buf->dirty = false;
+    stats.writebacks++;
+    return true;
+}
+
+static void write_done(struct bio* bio) {
+    struct bcache_buf* buf = (struct bcache_buf*)bio->context;
+    if (bio->ok) {
+        buf->dirty = false;
+        stats.writebacks++;
+    }
+}
+
+// A failed read-ahead leaves nothing cached
+static void read_done(struct bio* bio) {
+    struct bcache_buf* buf = (struct bcache_buf*)bio->context;
+    buf->busy = false;
+    if (!bio->ok) {
+        hash_remove(buf - bufs);
+        buf->valid = false;
+    }
+    bcache_release(buf);
+}
+
+// Queue a transfer of a whole buffer
+static void submit_block(struct bcache_buf* buf, bool write) {
+    struct bio* bio = &buf->bio;
+    bio->write = write;
+    bio->sector = block_lba(buf->block);
+    bio->count = cache_block_sectors;
+    bio->buffer = buf->data;
+    bio->callback = write ? write_done : read_done;
+    bio->context = buf;
+    buf->busy = !write;
+    block_submit(cache_device, bio);
+}
+
+// CLOCK: sweep past referenced buffers, clearing their bit, and take the
+// first unpinned one that was not used since the last sweep
+static int16_t pick_victim(void) {
+    for (int n = 0; n < 2 * BCACHE_BLOCKS; n++) {
+        int16_t i = clock_hand;
+        clock_hand = (clock_hand + 1) % BCACHE_BLOCKS;
+
+        if (bufs[i].refcount) continue;
+        if (!bufs[i].valid) return i;
+        if (bufs[i].referenced) {
+            bufs[i].referenced = false;
+            continue;
+        }
+        return i;
+    }
+    return BCACHE_NONE;
+}
+
+// Find or load a block and pin it. 'fill' is false when the caller is
+// about to overwrite the whole block, so a miss needs no device read.
+static struct bcache_buf* get_block(uint32_t block, bool fill) {
+    int16_t i = hash_find(block);
+    while (i != BCACHE_NONE && bufs[i].busy) {
+        // Read-ahead in flight; a failed one drops the block
+        block_wait(cache_device, &bufs[i].bio);
+        i = hash_find(block);
+    }
+    if (i != BCACHE_NONE) {
+        stats.hits++;
+        bufs[i].referenced = true;
+        bufs[i].refcount++;
+        return &bufs[i];
+    }
+
+    stats.misses++;
+    i = pick_victim();
+    if (i == BCACHE_NONE) {
+        printf("bcache: all buffers pinned\n");
+        return NULL;
+    }
+
+    struct bcache_buf* buf = &bufs[i];
+    if (buf->valid) {
+        if (buf->dirty && !write_back(buf)) {
+            return NULL;
+        }
+        hash_remove(i);
+        buf->valid = false;
+        stats.evictions++;
+    }
+
+    if (fill && !cache_device->read_sectors(block_lba(block), cache_block_sectors, buf->data)) {
+        return NULL;
+    }
+
+    buf->block = block;
+    buf->valid = true;
+    buf->dirty = false;
+    buf->referenced = true;
+    buf->refcount = 1;
+    hash_insert(i);
+    return buf;
+}
+
+bool bcache_init(block_device_t* device, uint32_t base_sector, uint32_t block_sectors) {
+    if (!device || block_sectors == 0) {
+        return false;
+    }
+
+    if (cache_device) {
+        bcache_flush();
+    }
+
+    uint32_t new_sector_size = device->get_sector_size ? device->get_sector_size() : 512;
+    uint32_t new_block_bytes = block_sectors * new_sector_size;
+    if (!block_memory || new_block_bytes != block_bytes) {
+        free(block_memory);
+        block_memory = (uint8_t*)malloc(BCACHE_BLOCKS * new_block_bytes);
+        if (!block_memory) {
+            printf("bcache: failed to allocate %u KB\n", (BCACHE_BLOCKS * new_block_bytes) / 1024);
+            cache_device = NULL;
+            return false;
+        }
+    }
+
+    cache_device = device;
+    cache_base = base_sector;
+    cache_block_sectors = block_sectors;
+    sector_size = new_sector_size;
+    block_bytes = new_block_bytes;
+
+    for (int i = 0; i < BCACHE_HASH_SIZE; i++) {
+        hash_heads[i] = BCACHE_NONE;
+    }
+    for (int i = 0; i < BCACHE_BLOCKS; i++) {
+        bufs[i].data = block_memory + i * block_bytes;
+        bufs[i].refcount = 0;
+        bufs[i].valid = false;
+        bufs[i].dirty = false;
+        bufs[i].referenced = false;
+        bufs[i].busy = false;
+        bufs[i].hash_next = BCACHE_NONE;
+    }
+    clock_hand = 0;
+    memset(&stats, 0, sizeof(stats));
+    return true;
+}
+
+struct bcache_buf* bcache_get(uint32_t lba) {
+    if (!cache_device || lba < cache_base || (lba - cache_base) % cache_block_sectors) {
+        return NULL;
+    }
+    return get_block((lba - cache_base) / cache_block_sectors, true);
+}
+
+struct bcache_buf* bcache_get_nofill(uint32_t lba) {
+    if (!cache_device || lba < cache_base || (lba - cache_base) % cache_block_sectors) {
+        return NULL;
+    }
+    return get_block((lba - cache_base) / cache_block_sectors, false);
+}
+
+void bcache_release(struct bcache_buf* buf) {
+    if (buf && buf->refcount) {
+        buf->refcount--;
+    }
+}
+
+void bcache_mark_dirty(struct bcache_buf* buf) {
+    if (buf) {
+        buf->dirty = true;
+    }
+}
+
+bool bcache_read(uint32_t lba, uint32_t count, void* buffer) {
+    if (!cache_device) return false;
+
+    uint8_t* out = (uint8_t*)buffer;
+    while (count) {
+        if (lba < cache_base) {
+            uint32_t n = cache_base - lba;
+            if (n > count) n = count;
+            if (!cache_device->read_sectors(lba, n, out)) return false;
+            lba += n;
+            count -= n;
+            out += n * sector_size;
+            continue;
+        }
+
+        uint32_t block = (lba - cache_base) / cache_block_sectors;
+        uint32_t offset = (lba - cache_base) % cache_block_sectors;
+        uint32_t n = cache_block_sectors - offset;
+        if (n > count) n = count;
+
+        struct bcache_buf* buf = get_block(block, true);
+        if (!buf) return false;
+        memcpy(out, buf->data + offset * sector_size, n * sector_size);
+        bcache_release(buf);
+
+        lba += n;
+        count -= n;
+        out += n * sector_size;
+    }
+    return true;
+}
+
+bool bcache_write(uint32_t lba, uint32_t count, const void* buffer) {
+    if (!cache_device) return false;
+
+    const uint8_t* in = (const uint8_t*)buffer;
+    while (count) {
+        if (lba < cache_base) {
+            uint32_t n = cache_base - lba;
+            if (n > count) n = count;
+            if (!cache_device->write_sectors(lba, n, in)) return false;
+            lba += n;
+            count -= n;
+            in += n * sector_size;
+            continue;
+        }
+
+        uint32_t block = (lba - cache_base) / cache_block_sectors;
+        uint32_t offset = (lba - cache_base) % cache_block_sectors;
+        uint32_t n = cache_block_sectors - offset;
+        if (n > count) n = count;
+
+        // A partial block has to be read first to keep the rest of it
+        struct bcache_buf* buf = get_block(block, n != cache_block_sectors);
+        if (!buf) return false;
+        memcpy(buf->data + offset * sector_size, in, n * sector_size);
+        buf->dirty = true;
+        bcache_release(buf);
+
+        lba += n;
+        count -= n;
+        in += n * sector_size;
+    }
+    return true;
+}
+
+// Sectors from 'lba' to the end of its block, or up to the cached area
+static uint32_t block_span(uint32_t lba) {
+    if (lba < cache_base) return cache_base - lba;
+    return cache_block_sectors - (lba - cache_base) % cache_block_sectors;
+}
+
+static int16_t cached_block(uint32_t lba) {
+    if (lba < cache_base) return BCACHE_NONE;
+    return hash_find((lba - cache_base) / cache_block_sectors);
+}
+
+bool bcache_read_direct(uint32_t lba, uint32_t count, void* buffer) {
+    if (!cache_device) return false;
+
+    uint8_t* out = (uint8_t*)buffer;
+    while (count) {
+        // Gather every sector up to the next cached block into one read
+        uint32_t n = 0;
+        while (n < count && cached_block(lba + n) == BCACHE_NONE) {
+            n += block_span(lba + n);
+        }
+        if (n > count) n = count;
+        if (n) {
+            if (!cache_device->read_sectors(lba, n, out)) return false;
+            stats.direct_reads++;
+            lba += n;
+            count -= n;
+            out += n * sector_size;
+            continue;
+        }
+
+        // Cached blocks may be newer than the device
+        int16_t i = cached_block(lba);
+        if (bufs[i].busy) {
+            block_wait(cache_device, &bufs[i].bio);
+            continue;
+        }
+        uint32_t offset = (lba - cache_base) % cache_block_sectors;
+        n = cache_block_sectors - offset;
+        if (n > count) n = count;
+        memcpy(out, bufs[i].data + offset * sector_size, n * sector_size);
+        bufs[i].referenced = true;
+        stats.hits++;
+        lba += n;
+        count -= n;
+        out += n * sector_size;
+    }
+    return true;
+}
+
+void bcache_prefetch(uint32_t lba, uint32_t count) {
+    if (!cache_device || count == 0) return;
+
+    uint32_t last = lba + count - 1;
+    if (last < cache_base) return;
+    if (lba < cache_base) lba = cache_base;
+
+    uint32_t first_block = (lba - cache_base) / cache_block_sectors;
+    uint32_t last_block = (last - cache_base) / cache_block_sectors;
+    for (uint32_t block = first_block; block <= last_block; block++) {
+        if (hash_find(block) != BCACHE_NONE) continue;
+        // Pinned until read_done
+        struct bcache_buf* buf = get_block(block, false);
+        if (!buf) break;
+        // Not referenced yet, so an unused prefetch is the first to go
+        buf->referenced = false;
+        submit_block(buf, false);
+    }
+    // Start the reads without waiting for them
+    block_queue_kick(cache_device);
+}
+
+bool bcache_flush(void) {
+    if (!cache_device) return false;
+
+    for (int i = 0; i < BCACHE_BLOCKS; i++) {
+        if (bufs[i].valid && bufs[i].dirty) {
+            submit_block(&bufs[i], true);
+        }
+    }
+    bool ok = block_queue_run(cache_device);
+    stats.flushes++;
+    return ok;
+}
+
+bool bcache_sync(uint32_t lba, uint32_t count) {
+    if (!cache_device) return false;
+    if (count == 0) return true;
+
+    uint32_t last = lba + count - 1;
+    if (last < cache_base) return true;
+    if (lba < cache_base) lba = cache_base;
+
+    uint32_t first_block = (lba - cache_base) / cache_block_sectors;
+    uint32_t last_block = (last - cache_base) / cache_block_sectors;
+    for (uint32_t block = first_block; block <= last_block; block++) {
+        int16_t i = hash_find(block);
+        if (i != BCACHE_NONE && bufs[i].dirty) {
+            submit_block(&bufs[i], true);
+        }
+    }
+    return block_queue_run(cache_device);
+}
+
+void bcache_periodic(uint32_t ticks) {
+    block_queue_poll(cache_device);
+    if (ticks - last_flush < BCACHE_FLUSH_TICKS) return;
+    last_flush = ticks;
+
+    for (int i = 0; i < BCACHE_BLOCKS; i++) {
+        if (bufs[i].valid && bufs[i].dirty) {
+            bcache_flush();
+            return;
+        }
+    }
+}
+
+uint32_t bcache_block_size(void) {
+    return block_bytes;
+}
+
+void bcache_get_stats(struct bcache_stats* out) {
+    *out = stats;
+}
+
+void bcache_print_stats(void) {
+    if (!cache_device) {
+        printf("Buffer cache not initialized\n");
+        return;
+    }
+
+    uint32_t used = 0, dirty = 0, pinned = 0;
+    for (int i = 0; i < BCACHE_BLOCKS; i++) {
+        if (!bufs[i].valid) continue;
+        used++;
+        if (bufs[i].dirty) dirty++;
+        if (bufs[i].refcount) pinned++;
+    }
+
+    uint32_t lookups = stats.hits + stats.misses;
+    uint32_t hit_rate = 0;
+    if (lookups >= 0x1000000) {
+        hit_rate = stats.hits / (lookups / 100);
+    } else if (lookups) {
+        hit_rate = stats.hits * 100 / lookups;
+    }
+    printf("Buffer cache: %u x %u byte blocks\n", BCACHE_BLOCKS, block_bytes);
+    printf("  In use: %u  Dirty: %u  Pinned: %u\n", used, dirty, pinned);
+    printf("  Hits: %u  Misses: %u  Hit rate: %u%%\n", stats.hits, stats.misses, hit_rate);
+    printf("  Evictions: %u  Write-backs: %u  Flushes: %u\n",
+           stats.evictions, stats.writebacks, stats.flushes);
+    printf("  Direct reads: %u\n", stats.direct_reads);
+}
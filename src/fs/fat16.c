@@ -1,49 +1,13 @@
 #include "../../include/fs/fat16.h"
 #include "../../include/drivers/iso_fs.h"
+#include "../../include/fs/bcache.h"
 #include "../../include/drivers/vbe.h"
+#include "../../include/memory/heap.h"
 #include <string.h>
 
-// Custom strtok implementation
-static char* custom_strtok(char* str, const char* delim) {
-    static char* last = NULL;
-    char* token;
-    
-    if (str) {
-        last = str;
-    }
-    
-    if (!last) {
-        return NULL;
-    }
-    
-    // Skip leading delimiters
-    while (*last && strchr(delim, *last)) {
-        last++;
-    }
-    
-    if (!*last) {
-        return NULL;
-    }
-    
-    token = last;
-    
-    // Find end of token
-    while (*last && !strchr(delim, *last)) {
-        last++;
-    }
-    
-    if (*last) {
-        *last = '\0';
-        last++;
-    } else {
-        last = NULL;
-    }
-    
-    return token;
-}
-
 // Function declarations
-static fat16_dir_entry_t* find_directory_entry(fat16_dir_entry_t* dir, int num_entries, const char* name);
+static void parse_filename(const char* filename, char* name, char* ext);
+static bool compare_filenames(const char* name1, const char* name2);
 
 // Simple toupper implementation
 static char toupper(char c) {
@@ -63,8 +27,1025 @@ uint32_t sectors_per_fat;
 uint32_t root_dir_sectors;
 uint16_t current_cluster = 0;  // Current directory cluster (0 for root)
 uint16_t user_dir_cluster = 0;  // Define the variable
+static block_device_t* fat_device = NULL;  // Mounted volume
+
+// Cluster allocation state, built from the FAT at init. A set bit in
+// free_map means the cluster is free. Allocation is next-fit from
+// next_free and modified FAT sectors are tracked in fat_dirty so only
+// those are written back.
+static uint32_t* free_map = NULL;
+static uint8_t* fat_dirty = NULL;
+static uint32_t cluster_count;      // Valid clusters are 2 .. cluster_count - 1
+static uint32_t free_clusters;
+static uint32_t next_free = 2;
+static uint32_t fat_entries_per_sector;
+
+static bool fat_build_free_map(void) {
+    uint32_t total_sectors = boot_sector.total_sectors_16 ? boot_sector.total_sectors_16
+                                                          : boot_sector.total_sectors_32;
+    uint32_t fat_entries = sectors_per_fat * boot_sector.bytes_per_sector / 2;
+
+    cluster_count = 2;
+    if (total_sectors > data_start_sector && boot_sector.sectors_per_cluster) {
+        cluster_count += (total_sectors - data_start_sector) / boot_sector.sectors_per_cluster;
+    }
+    if (cluster_count > fat_entries) cluster_count = fat_entries;
+    if (cluster_count > 0xFFF7) cluster_count = 0xFFF7;
+    fat_entries_per_sector = boot_sector.bytes_per_sector / 2;
+
+    free(free_map);
+    free(fat_dirty);
+    uint32_t map_words = (cluster_count + 31) / 32;
+    uint32_t dirty_bytes = (sectors_per_fat + 7) / 8;
+    free_map = (uint32_t*)malloc(map_words * sizeof(uint32_t));
+    fat_dirty = (uint8_t*)malloc(dirty_bytes);
+    if (!free_map || !fat_dirty) {
+        return false;
+    }
+    memset(free_map, 0, map_words * sizeof(uint32_t));
+    memset(fat_dirty, 0, dirty_bytes);
+
+    free_clusters = 0;
+    for (uint32_t cluster = 2; cluster < cluster_count; cluster++) {
+        if (fat_table[cluster] == 0x0000) {
+            free_map[cluster >> 5] |= 1u << (cluster & 31);
+            free_clusters++;
+        }
+    }
+    next_free = 2;
+    return true;
+}
+
+// Update a FAT entry, keeping the free map, free count and dirty sectors in step
+static void fat_set(uint16_t cluster, uint16_t value) {
+    if (cluster < 2 || cluster >= cluster_count) return;
+
+    bool was_free = fat_table[cluster] == 0x0000;
+    fat_table[cluster] = value;
+    if (was_free && value != 0x0000) {
+        free_map[cluster >> 5] &= ~(1u << (cluster & 31));
+        free_clusters--;
+    } else if (!was_free && value == 0x0000) {
+        free_map[cluster >> 5] |= 1u << (cluster & 31);
+        free_clusters++;
+    }
+
+    uint32_t sector = cluster / fat_entries_per_sector;
+    fat_dirty[sector >> 3] |= 1 << (sector & 7);
+}
+
+// First free cluster in [from, to), or 0
+static uint32_t scan_free(uint32_t from, uint32_t to) {
+    uint32_t i = from;
+    while (i < to) {
+        uint32_t word = free_map[i >> 5] >> (i & 31);
+        if (word) {
+            uint32_t cluster = i + __builtin_ctz(word);
+            return cluster < to ? cluster : 0;
+        }
+        i = (i | 31) + 1;
+    }
+    return 0;
+}
+
+// Number of free clusters following 'start' (inclusive), at most 'max'
+static uint32_t free_run_length(uint32_t start, uint32_t max) {
+    uint32_t len = 0;
+    while (len < max && start + len < cluster_count &&
+           (free_map[(start + len) >> 5] & (1u << ((start + len) & 31)))) {
+        len++;
+    }
+    return len;
+}
+
+// Start of a free run of 'count' clusters in [from, to), or 0
+static uint32_t find_free_run(uint32_t from, uint32_t to, uint32_t count) {
+    uint32_t cluster = scan_free(from, to);
+    while (cluster) {
+        uint32_t len = free_run_length(cluster, count);
+        if (len == count) return cluster;
+        cluster = scan_free(cluster + len, to);
+    }
+    return 0;
+}
+
+// Allocate a chain of 'count' clusters, terminated with an end-of-chain
+// marker. A single contiguous run is preferred so files are laid out
+// sequentially; otherwise free runs are taken in next-fit order.
+// Returns the first cluster, or 0 if there is not enough space.
+static uint16_t fat_alloc_chain(uint32_t count) {
+    if (count == 0 || count > free_clusters) return 0;
+    if (next_free < 2 || next_free >= cluster_count) next_free = 2;
+
+    uint32_t start = find_free_run(next_free, cluster_count, count);
+    if (!start && next_free > 2) start = find_free_run(2, next_free, count);
+
+    uint16_t first = 0;
+    uint16_t prev = 0;
+    uint32_t pos = start ? start : next_free;
+    while (count) {
+        uint32_t cluster = scan_free(pos, cluster_count);
+        if (!cluster) cluster = scan_free(2, pos);
+        if (!cluster) break;  // Cannot happen while free_clusters is right
+
+        uint32_t len = free_run_length(cluster, count);
+        for (uint32_t i = 0; i < len; i++) {
+            fat_set(cluster + i, 0xFFF8);
+            if (prev) fat_set(prev, cluster + i);
+            else first = cluster + i;
+            prev = cluster + i;
+        }
+        count -= len;
+        pos = cluster + len;
+        if (pos >= cluster_count) pos = 2;
+    }
+
+    next_free = pos;
+    return first;
+}
+
+// Return every cluster of a chain to the free pool
+static void fat_free_chain(uint16_t cluster) {
+    while (cluster >= 2 && cluster < cluster_count) {
+        uint16_t next_cluster = fat_table[cluster];
+        fat_set(cluster, 0x0000);
+        cluster = next_cluster;
+    }
+}
+
+// Write the modified FAT sectors back to every FAT copy
+static bool fat_flush(void) {
+    uint32_t sector = 0;
+    while (sector < sectors_per_fat) {
+        if (!(fat_dirty[sector >> 3] & (1 << (sector & 7)))) {
+            sector++;
+            continue;
+        }
+
+        // Coalesce neighbouring dirty sectors into one write
+        uint32_t run = 1;
+        while (sector + run < sectors_per_fat &&
+               (fat_dirty[(sector + run) >> 3] & (1 << ((sector + run) & 7)))) {
+            run++;
+        }
+
+        uint8_t* data = (uint8_t*)fat_table + sector * boot_sector.bytes_per_sector;
+        for (uint32_t copy = 0; copy < boot_sector.num_fats; copy++) {
+            if (!bcache_write(fat_start_sector + copy * sectors_per_fat + sector, run, data)) {
+                return false;
+            }
+        }
+        for (uint32_t i = sector; i < sector + run; i++) {
+            fat_dirty[i >> 3] &= ~(1 << (i & 7));
+        }
+        sector += run;
+    }
+    return true;
+}
+
+uint32_t fat16_get_free_clusters(void) {
+    return free_clusters;
+}
+
+// Directory entry cache. Entries found by name are kept keyed by
+// (parent cluster, 8.3 name) so repeated lookups and path walks do not
+// re-read the directory. Hash chains and the LRU list are array indices;
+// the LRU list always holds every slot, invalid ones at the tail.
+#define DENTRY_CACHE_SIZE 64
+#define DENTRY_HASH_SIZE  64
+#define DENTRY_NONE       -1
+
+struct dentry {
+    uint16_t parent;
+    uint8_t name[11];
+    bool valid;
+    fat16_dir_entry_t entry;
+    uint16_t index;            // Entry slot in the parent directory
+    int16_t hash_next;
+    int16_t lru_prev;
+    int16_t lru_next;
+};
+
+static struct dentry dentry_cache[DENTRY_CACHE_SIZE];
+static int16_t dentry_hash[DENTRY_HASH_SIZE];
+static int16_t lru_head = DENTRY_NONE;  // Most recently used
+static int16_t lru_tail = DENTRY_NONE;
+
+static void lru_unlink(int16_t i) {
+    struct dentry* d = &dentry_cache[i];
+    if (d->lru_prev != DENTRY_NONE) dentry_cache[d->lru_prev].lru_next = d->lru_next;
+    else lru_head = d->lru_next;
+    if (d->lru_next != DENTRY_NONE) dentry_cache[d->lru_next].lru_prev = d->lru_prev;
+    else lru_tail = d->lru_prev;
+}
+
+static void lru_push_front(int16_t i) {
+    dentry_cache[i].lru_prev = DENTRY_NONE;
+    dentry_cache[i].lru_next = lru_head;
+    if (lru_head != DENTRY_NONE) dentry_cache[lru_head].lru_prev = i;
+    else lru_tail = i;
+    lru_head = i;
+}
+
+static void lru_push_back(int16_t i) {
+    dentry_cache[i].lru_next = DENTRY_NONE;
+    dentry_cache[i].lru_prev = lru_tail;
+    if (lru_tail != DENTRY_NONE) dentry_cache[lru_tail].lru_next = i;
+    else lru_head = i;
+    lru_tail = i;
+}
+
+static void dentry_init(void) {
+    lru_head = lru_tail = DENTRY_NONE;
+    for (int i = 0; i < DENTRY_HASH_SIZE; i++) {
+        dentry_hash[i] = DENTRY_NONE;
+    }
+    for (int i = 0; i < DENTRY_CACHE_SIZE; i++) {
+        dentry_cache[i].valid = false;
+        dentry_cache[i].hash_next = DENTRY_NONE;
+        lru_push_back(i);
+    }
+}
+
+// Build the space padded, upper case 8.3 key for a name. Returns false for
+// names that cannot match a short entry, which then bypass the cache.
+static bool dentry_key(const char* name, uint8_t key[11]) {
+    memset(key, ' ', 11);
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+        memcpy(key, name, strlen(name));
+        return true;
+    }
+
+    int i = 0;
+    int len = 0;
+    for (; name[i] && name[i] != '.'; i++) {
+        if (len == 8 || name[i] == ' ') return false;
+        key[len++] = toupper(name[i]);
+    }
+    if (len == 0) return false;
+    if (name[i] == '.') {
+        i++;
+        if (!name[i]) return false;
+        for (len = 0; name[i]; i++) {
+            if (len == 3 || name[i] == '.' || name[i] == ' ') return false;
+            key[8 + len++] = toupper(name[i]);
+        }
+    }
+    return true;
+}
+
+static uint32_t dentry_bucket(uint16_t parent, const uint8_t key[11]) {
+    uint32_t hash = 2166136261u ^ parent;
+    for (int i = 0; i < 11; i++) {
+        hash = (hash ^ key[i]) * 16777619u;
+    }
+    return hash % DENTRY_HASH_SIZE;
+}
+
+static int16_t dentry_find(uint16_t parent, const uint8_t key[11]) {
+    int16_t i = dentry_hash[dentry_bucket(parent, key)];
+    while (i != DENTRY_NONE) {
+        if (dentry_cache[i].parent == parent && memcmp(dentry_cache[i].name, key, 11) == 0) {
+            return i;
+        }
+        i = dentry_cache[i].hash_next;
+    }
+    return DENTRY_NONE;
+}
+
+static void dentry_drop(int16_t i) {
+    struct dentry* d = &dentry_cache[i];
+    int16_t* link = &dentry_hash[dentry_bucket(d->parent, d->name)];
+    while (*link != i) {
+        link = &dentry_cache[*link].hash_next;
+    }
+    *link = d->hash_next;
+    d->valid = false;
+    lru_unlink(i);
+    lru_push_back(i);
+}
+
+static void dentry_insert(uint16_t parent, const uint8_t key[11], const fat16_dir_entry_t* entry, uint16_t index) {
+    int16_t i = dentry_find(parent, key);
+    if (i == DENTRY_NONE) {
+        // Reuse the least recently used slot
+        i = lru_tail;
+        if (dentry_cache[i].valid) dentry_drop(i);
+
+        uint32_t bucket = dentry_bucket(parent, key);
+        dentry_cache[i].parent = parent;
+        memcpy(dentry_cache[i].name, key, 11);
+        dentry_cache[i].valid = true;
+        dentry_cache[i].hash_next = dentry_hash[bucket];
+        dentry_hash[bucket] = i;
+    }
+    dentry_cache[i].entry = *entry;
+    dentry_cache[i].index = index;
+    lru_unlink(i);
+    lru_push_front(i);
+}
+
+// Forget the cached name of a directory slot that changed on disk
+static void dentry_invalidate(uint16_t parent, uint32_t index) {
+    for (int16_t i = 0; i < DENTRY_CACHE_SIZE; i++) {
+        if (dentry_cache[i].valid && dentry_cache[i].parent == parent && dentry_cache[i].index == index) {
+            dentry_drop(i);
+        }
+    }
+}
+
+// Forget every cached name in a directory that is being removed
+static void dentry_invalidate_dir(uint16_t parent) {
+    for (int16_t i = 0; i < DENTRY_CACHE_SIZE; i++) {
+        if (dentry_cache[i].valid && dentry_cache[i].parent == parent) dentry_drop(i);
+    }
+}
+
+// Resolved directory paths. Each slot maps a start directory plus an
+// upper case path of two or more components to the directory it names,
+// so deep paths skip the walk over their leading components.
+#define PATH_CACHE_SIZE 16
+#define PATH_CACHE_LEN  64
+
+struct path_cache_entry {
+    bool valid;
+    uint16_t base;
+    uint16_t cluster;
+    uint32_t last_used;
+    char path[PATH_CACHE_LEN];
+};
+
+static struct path_cache_entry path_cache[PATH_CACHE_SIZE];
+static uint32_t path_cache_clock = 0;
+
+// Removed directories can leave stale prefixes anywhere below them
+static void path_cache_clear(void) {
+    for (int i = 0; i < PATH_CACHE_SIZE; i++) {
+        path_cache[i].valid = false;
+    }
+}
+
+static bool path_cache_find(uint16_t base, const char* path, uint16_t* cluster) {
+    for (int i = 0; i < PATH_CACHE_SIZE; i++) {
+        if (path_cache[i].valid && path_cache[i].base == base && strcmp(path_cache[i].path, path) == 0) {
+            path_cache[i].last_used = ++path_cache_clock;
+            *cluster = path_cache[i].cluster;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void path_cache_insert(uint16_t base, const char* path, uint16_t cluster) {
+    if (strlen(path) >= PATH_CACHE_LEN) return;
+
+    int slot = 0;
+    for (int i = 0; i < PATH_CACHE_SIZE; i++) {
+        if (!path_cache[i].valid) {
+            slot = i;
+            break;
+        }
+        if (path_cache[i].last_used < path_cache[slot].last_used) slot = i;
+    }
+    path_cache[slot].valid = true;
+    path_cache[slot].base = base;
+    path_cache[slot].cluster = cluster;
+    path_cache[slot].last_used = ++path_cache_clock;
+    strcpy(path_cache[slot].path, path);
+}
+
+// Directories are read one sector at a time. The root directory is a
+// fixed region; subdirectories follow their cluster chain and grow.
+#define DIR_ENTRIES_PER_SECTOR (512 / sizeof(fat16_dir_entry_t))
+
+struct dir_iter {
+    uint16_t dir;
+    uint16_t cluster;          // Cluster holding the loaded sector
+    uint32_t sector;           // Sector within the root region or the cluster
+    uint32_t index;            // Directory index of entries[0]
+    fat16_dir_entry_t entries[DIR_ENTRIES_PER_SECTOR];
+};
+
+static bool dir_iter_load(struct dir_iter* it) {
+    uint32_t lba;
+    if (it->dir == 0) {
+        if (it->sector >= root_dir_sectors) return false;
+        lba = root_dir_start_sector + it->sector;
+    } else {
+        if (it->sector == boot_sector.sectors_per_cluster) {
+            it->cluster = fat16_get_next_cluster(it->cluster);
+            it->sector = 0;
+        }
+        if (it->cluster < 2 || fat16_is_end_of_chain(it->cluster)) return false;
+        lba = fat16_cluster_to_lba(it->cluster) + it->sector;
+    }
+    return bcache_read(lba, 1, it->entries);
+}
+
+static bool dir_iter_start(struct dir_iter* it, uint16_t dir) {
+    it->dir = dir;
+    it->cluster = dir;
+    it->sector = 0;
+    it->index = 0;
+    return dir_iter_load(it);
+}
+
+static bool dir_iter_next(struct dir_iter* it) {
+    it->sector++;
+    it->index += DIR_ENTRIES_PER_SECTOR;
+    return dir_iter_load(it);
+}
+
+// Entries that name a file or directory
+static bool entry_visible(const fat16_dir_entry_t* entry) {
+    if (entry->filename[0] == 0x00 || entry->filename[0] == 0xE5) return false;
+    if ((entry->attributes & FAT16_ATTR_LONG_NAME) == FAT16_ATTR_LONG_NAME) return false;
+    return !(entry->attributes & FAT16_ATTR_VOLUME_ID);
+}
+
+// Format an entry's 8.3 name as NAME.EXT
+static void entry_name(const fat16_dir_entry_t* entry, char name[13]) {
+    int name_idx = 0;
+    for (int j = 0; j < 8; j++) {
+        if (entry->filename[j] != ' ') name[name_idx++] = entry->filename[j];
+    }
+    if (entry->extension[0] != ' ') {
+        name[name_idx++] = '.';
+        for (int j = 0; j < 3; j++) {
+            if (entry->extension[j] != ' ') name[name_idx++] = entry->extension[j];
+        }
+    }
+    name[name_idx] = '\0';
+}
+
+// Walks the visible entries of a directory. VFAT long name fragments
+// are joined and handed out with the short entry they precede, if their
+// checksum matches it; otherwise the 8.3 name is used.
+struct dir_walk {
+    struct dir_iter it;
+    uint32_t next;             // Next slot in it.entries
+    bool more;
+    bool lfn_valid;
+    uint8_t lfn_seq;           // Order of the last fragment seen
+    uint8_t lfn_sum;
+    uint32_t lfn_first;        // Slot of the first fragment
+    uint32_t lfn_len;
+    char lfn[FAT16_MAX_NAME + 1];
+};
+
+static uint8_t lfn_checksum(const uint8_t* short_name) {
+    uint8_t sum = 0;
+    for (int i = 0; i < 11; i++) {
+        sum = ((sum & 1) << 7) + (sum >> 1) + short_name[i];
+    }
+    return sum;
+}
+
+static void dir_walk_start(struct dir_walk* w, uint16_t dir) {
+    w->more = dir_iter_start(&w->it, dir);
+    w->next = 0;
+    w->lfn_valid = false;
+}
+
+// Collect one long name fragment. Characters outside ASCII become '?'.
+static void dir_walk_fragment(struct dir_walk* w, const fat16_lfn_entry_t* lfn, uint32_t index) {
+    uint8_t order = lfn->order & 0x1F;
+    if (lfn->order & FAT16_LFN_LAST) {
+        w->lfn_valid = order >= 1 && order * 13 <= FAT16_MAX_NAME + 12;
+        w->lfn_sum = lfn->checksum;
+        w->lfn_first = index;
+        w->lfn_len = order * 13;
+    } else if (!w->lfn_valid || order != w->lfn_seq - 1 || lfn->checksum != w->lfn_sum) {
+        w->lfn_valid = false;
+    }
+    if (!w->lfn_valid) return;
+    w->lfn_seq = order;
+
+    uint16_t chars[13];
+    memcpy(chars, lfn->name1, sizeof(lfn->name1));
+    memcpy(chars + 5, lfn->name2, sizeof(lfn->name2));
+    memcpy(chars + 11, lfn->name3, sizeof(lfn->name3));
+    uint32_t pos = (order - 1) * 13;
+    for (int i = 0; i < 13; i++, pos++) {
+        if (chars[i] == 0x0000) {
+            if (pos < w->lfn_len) w->lfn_len = pos;
+            break;
+        }
+        if (pos < FAT16_MAX_NAME) {
+            w->lfn[pos] = chars[i] < 0x80 ? (char)chars[i] : '?';
+        }
+    }
+    if (w->lfn_len > FAT16_MAX_NAME) w->lfn_len = FAT16_MAX_NAME;
+}
+
+// Next visible entry, its slot, the slot of its first long name fragment
+// and its name. The entry points into the walker and is valid until the
+// next call.
+static bool dir_walk_next(struct dir_walk* w, fat16_dir_entry_t** out, uint32_t* index, uint32_t* first, char* name) {
+    while (w->more) {
+        if (w->next == DIR_ENTRIES_PER_SECTOR) {
+            w->more = dir_iter_next(&w->it);
+            w->next = 0;
+            continue;
+        }
+        uint32_t slot = w->it.index + w->next;
+        fat16_dir_entry_t* entry = &w->it.entries[w->next++];
+
+        if (entry->filename[0] == 0x00) {
+            w->more = false;
+            break;
+        }
+        if (entry->filename[0] == 0xE5) {
+            w->lfn_valid = false;
+            continue;
+        }
+        if ((entry->attributes & FAT16_ATTR_LONG_NAME) == FAT16_ATTR_LONG_NAME) {
+            dir_walk_fragment(w, (const fat16_lfn_entry_t*)entry, slot);
+            continue;
+        }
+        if (entry->attributes & FAT16_ATTR_VOLUME_ID) {
+            w->lfn_valid = false;
+            continue;
+        }
+
+        if (w->lfn_valid && w->lfn_seq == 1 && w->lfn_sum == lfn_checksum(entry->filename)) {
+            memcpy(name, w->lfn, w->lfn_len);
+            name[w->lfn_len] = '\0';
+            *first = w->lfn_first;
+        } else {
+            entry_name(entry, name);
+            *first = slot;
+        }
+        w->lfn_valid = false;
+        *out = entry;
+        *index = slot;
+        return true;
+    }
+    return false;
+}
+
+// Name index. The first lookup in a directory records every entry and
+// hashes its long and short names, case folded, so later lookups are
+// O(1) however many fragments the directory holds. Indexes of the most
+// recently used directories are kept; any write to a directory drops
+// its index.
+#define NAME_INDEX_DIRS 8
+#define NAME_INDEX_NONE 0xFFFFFFFF
+
+struct name_record {
+    fat16_dir_entry_t entry;
+    uint32_t index;            // Slot of the short entry
+    uint32_t first;            // Slot of its first long name fragment
+};
+
+struct name_slot {
+    uint32_t hash;
+    uint32_t record;
+    uint32_t name;             // Offset in the name pool
+    uint32_t next;
+};
+
+struct name_index {
+    bool valid;
+    uint16_t dir;
+    uint32_t last_used;
+    struct name_record* records;
+    uint32_t record_count;
+    struct name_slot* slots;
+    uint32_t slot_count;
+    uint32_t* buckets;
+    uint32_t bucket_mask;
+    char* names;
+    uint32_t names_used;
+};
+
+static struct name_index name_indexes[NAME_INDEX_DIRS];
+static uint32_t name_index_clock = 0;
+
+static uint32_t name_hash(const char* name) {
+    uint32_t hash = 2166136261u;
+    for (; *name; name++) {
+        hash = (hash ^ (uint8_t)toupper(*name)) * 16777619u;
+    }
+    return hash;
+}
+
+static void name_index_free(struct name_index* ni) {
+    free(ni->records);
+    free(ni->slots);
+    free(ni->buckets);
+    free(ni->names);
+    memset(ni, 0, sizeof(*ni));
+}
+
+static void name_index_drop(uint16_t dir) {
+    for (int i = 0; i < NAME_INDEX_DIRS; i++) {
+        if (name_indexes[i].valid && name_indexes[i].dir == dir) name_index_free(&name_indexes[i]);
+    }
+}
+
+static void name_index_clear(void) {
+    for (int i = 0; i < NAME_INDEX_DIRS; i++) {
+        name_index_free(&name_indexes[i]);
+    }
+}
+
+// Grow an array by doubling; false if out of memory
+static bool grow(void** array, uint32_t* capacity, uint32_t needed, uint32_t size) {
+    if (needed <= *capacity) return true;
+    uint32_t new_capacity = *capacity ? *capacity : 16;
+    while (new_capacity < needed) new_capacity *= 2;
+    void* grown = realloc(*array, new_capacity * size);
+    if (!grown) return false;
+    *array = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+static bool name_index_add(struct name_index* ni, uint32_t record, const char* name,
+                           uint32_t* slot_capacity, uint32_t* names_capacity) {
+    uint32_t len = strlen(name) + 1;
+    if (!grow((void**)&ni->slots, slot_capacity, ni->slot_count + 1, sizeof(struct name_slot)) ||
+        !grow((void**)&ni->names, names_capacity, ni->names_used + len, 1)) {
+        return false;
+    }
+    struct name_slot* slot = &ni->slots[ni->slot_count++];
+    slot->hash = name_hash(name);
+    slot->record = record;
+    slot->name = ni->names_used;
+    memcpy(ni->names + ni->names_used, name, len);
+    ni->names_used += len;
+    return true;
+}
+
+static struct name_index* name_index_build(uint16_t dir) {
+    // Reuse the least recently used index
+    struct name_index* ni = &name_indexes[0];
+    for (int i = 0; i < NAME_INDEX_DIRS; i++) {
+        if (!name_indexes[i].valid) {
+            ni = &name_indexes[i];
+            break;
+        }
+        if (name_indexes[i].last_used < ni->last_used) ni = &name_indexes[i];
+    }
+    name_index_free(ni);
+
+    uint32_t record_capacity = 0, slot_capacity = 0, names_capacity = 0;
+    struct dir_walk w;
+    fat16_dir_entry_t* entry;
+    uint32_t index, first;
+    char name[FAT16_MAX_NAME + 1];
+    bool ok = true;
+    dir_walk_start(&w, dir);
+    while (ok && dir_walk_next(&w, &entry, &index, &first, name)) {
+        ok = grow((void**)&ni->records, &record_capacity, ni->record_count + 1, sizeof(struct name_record));
+        if (!ok) break;
+        uint32_t record = ni->record_count++;
+        ni->records[record].entry = *entry;
+        ni->records[record].index = index;
+        ni->records[record].first = first;
+
+        char short_name[13];
+        entry_name(entry, short_name);
+        ok = name_index_add(ni, record, name, &slot_capacity, &names_capacity);
+        if (ok && !compare_filenames(name, short_name)) {
+            ok = name_index_add(ni, record, short_name, &slot_capacity, &names_capacity);
+        }
+    }
+
+    // Power of two buckets, at least twice the names
+    uint32_t buckets = 16;
+    while (buckets < ni->slot_count * 2) buckets *= 2;
+    ni->buckets = ok ? (uint32_t*)malloc(buckets * sizeof(uint32_t)) : NULL;
+    if (!ni->buckets) {
+        name_index_free(ni);
+        return NULL;
+    }
+    ni->bucket_mask = buckets - 1;
+    for (uint32_t i = 0; i < buckets; i++) {
+        ni->buckets[i] = NAME_INDEX_NONE;
+    }
+    for (uint32_t i = 0; i < ni->slot_count; i++) {
+        uint32_t bucket = ni->slots[i].hash & ni->bucket_mask;
+        ni->slots[i].next = ni->buckets[bucket];
+        ni->buckets[bucket] = i;
+    }
+
+    ni->valid = true;
+    ni->dir = dir;
+    return ni;
+}
+
+// Find a name in a directory through its name index. 'index' and
+// 'first' are optional and receive the short entry's slot and the slot
+// of its first long name fragment.
+static bool dir_scan(uint16_t dir, const char* name, fat16_dir_entry_t* out, uint32_t* index, uint32_t* first) {
+    struct name_index* ni = NULL;
+    for (int i = 0; i < NAME_INDEX_DIRS; i++) {
+        if (name_indexes[i].valid && name_indexes[i].dir == dir) {
+            ni = &name_indexes[i];
+            break;
+        }
+    }
+    if (!ni) ni = name_index_build(dir);
+
+    if (!ni) {
+        // Out of memory: fall back to walking the directory
+        struct dir_walk w;
+        fat16_dir_entry_t* entry;
+        uint32_t slot, first_slot;
+        char entry_long[FAT16_MAX_NAME + 1], short_name[13];
+        dir_walk_start(&w, dir);
+        while (dir_walk_next(&w, &entry, &slot, &first_slot, entry_long)) {
+            entry_name(entry, short_name);
+            if (compare_filenames(entry_long, name) || compare_filenames(short_name, name)) {
+                *out = *entry;
+                if (index) *index = slot;
+                if (first) *first = first_slot;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    ni->last_used = ++name_index_clock;
+    uint32_t hash = name_hash(name);
+    for (uint32_t i = ni->buckets[hash & ni->bucket_mask]; i != NAME_INDEX_NONE; i = ni->slots[i].next) {
+        if (ni->slots[i].hash == hash && compare_filenames(ni->names + ni->slots[i].name, name)) {
+            struct name_record* record = &ni->records[ni->slots[i].record];
+            *out = record->entry;
+            if (index) *index = record->index;
+            if (first) *first = record->first;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Sector and byte offset of directory entry 'index'
+static bool dir_entry_lba(uint16_t dir, uint32_t index, uint32_t* lba, uint32_t* offset) {
+    uint32_t sector = index / DIR_ENTRIES_PER_SECTOR;
+    *offset = (index % DIR_ENTRIES_PER_SECTOR) * sizeof(fat16_dir_entry_t);
+    if (dir == 0) {
+        if (sector >= root_dir_sectors) return false;
+        *lba = root_dir_start_sector + sector;
+        return true;
+    }
+
+    uint16_t cluster = dir;
+    for (uint32_t i = sector / boot_sector.sectors_per_cluster; i > 0; i--) {
+        cluster = fat16_get_next_cluster(cluster);
+        if (cluster < 2 || fat16_is_end_of_chain(cluster)) return false;
+    }
+    *lba = fat16_cluster_to_lba(cluster) + sector % boot_sector.sectors_per_cluster;
+    return true;
+}
+
+static bool dir_write_entry(uint16_t dir, uint32_t index, const fat16_dir_entry_t* entry) {
+    uint32_t lba, offset;
+    uint8_t sector[512];
+    if (!dir_entry_lba(dir, index, &lba, &offset) || !bcache_read(lba, 1, sector)) {
+        return false;
+    }
+    memcpy(sector + offset, entry, sizeof(fat16_dir_entry_t));
+    name_index_drop(dir);
+    dentry_invalidate(dir, index);
+    return bcache_write(lba, 1, sector);
+}
+
+// Fill a cluster with zeros through the buffer cache
+static bool zero_cluster(uint16_t cluster) {
+    struct bcache_buf* buf = bcache_get_nofill(fat16_cluster_to_lba(cluster));
+    if (!buf) return false;
+    memset(buf->data, 0, bcache_block_size());
+    bcache_mark_dirty(buf);
+    bcache_release(buf);
+    return true;
+}
+
+// Find 'count' consecutive free entry slots. A subdirectory without
+// room grows by zeroed clusters; the root directory has a fixed size.
+static bool dir_find_slots(uint16_t dir, uint32_t count, uint32_t* index) {
+    struct dir_iter it;
+    uint16_t last = dir;
+    uint32_t run = 0;
+    for (bool ok = dir_iter_start(&it, dir); ok; ok = dir_iter_next(&it)) {
+        for (uint32_t i = 0; i < DIR_ENTRIES_PER_SECTOR; i++) {
+            if (it.entries[i].filename[0] == 0x00 || it.entries[i].filename[0] == 0xE5) {
+                if (++run == count) {
+                    *index = it.index + i + 1 - count;
+                    return true;
+                }
+            } else {
+                run = 0;
+            }
+        }
+        last = it.cluster;
+    }
+    if (dir == 0) return false;
+
+    uint32_t per_cluster = boot_sector.sectors_per_cluster * DIR_ENTRIES_PER_SECTOR;
+    uint32_t clusters = (count - run + per_cluster - 1) / per_cluster;
+    uint16_t first = fat_alloc_chain(clusters);
+    if (first == 0) return false;
+    for (uint16_t cluster = first; cluster >= 2 && !fat16_is_end_of_chain(cluster);
+         cluster = fat16_get_next_cluster(cluster)) {
+        if (!zero_cluster(cluster)) {
+            fat_free_chain(first);
+            return false;
+        }
+    }
+    fat_set(last, first);
+    *index = it.index - run;
+    return true;
+}
+
+// True if 'name' fits an 8.3 entry as is, apart from case
+static bool is_short_name(const char* name) {
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) return true;
+
+    int base = 0, ext = -1;
+    for (const char* p = name; *p; p++) {
+        char c = *p;
+        if (c == '.') {
+            if (ext >= 0) return false;
+            ext = 0;
+            continue;
+        }
+        if (c <= ' ' || strchr("\"*+,/:;<=>?[\\]|", c) || (uint8_t)c >= 0x80) return false;
+        if (ext >= 0) ext++;
+        else base++;
+    }
+    return base >= 1 && base <= 8 && ext != 0 && ext <= 3;
+}
+
+// Make a unique "BASE~N.EXT" alias for a long name
+static bool make_short_alias(uint16_t dir, const char* name, fat16_dir_entry_t* entry) {
+    char base[9] = {0}, ext[4] = {0};
+    const char* dot = strrchr(name, '.');
+    int len = 0;
+    for (const char* p = name; *p && p != dot && len < 6; p++) {
+        char c = toupper(*p);
+        if (c == ' ' || c == '.') continue;
+        base[len++] = (c < ' ' || strchr("\"*+,/:;<=>?[\\]|", c) || (uint8_t)c >= 0x80) ? '_' : c;
+    }
+    if (len == 0) base[len++] = '_';
+    len = 0;
+    for (const char* p = dot ? dot + 1 : ""; *p && len < 3; p++) {
+        char c = toupper(*p);
+        if (c == ' ') continue;
+        ext[len++] = (c < ' ' || strchr("\"*+,/:;<=>?[\\]|", c) || (uint8_t)c >= 0x80) ? '_' : c;
+    }
+
+    for (int n = 1; n < 10000; n++) {
+        char suffix[8];
+        itoa_custom(n, suffix, 10);
+        int keep = 8 - 1 - (int)strlen(suffix);
+        int base_len = strlen(base);
+        if (base_len > keep) base_len = keep;
+
+        // "BASE" + "~N" + "." + "EXT"
+        char candidate[14];
+        int pos = 0;
+        memcpy(candidate, base, base_len);
+        pos += base_len;
+        candidate[pos++] = '~';
+        for (const char* p = suffix; *p; p++) candidate[pos++] = *p;
+        if (ext[0]) {
+            candidate[pos++] = '.';
+            for (const char* p = ext; *p; p++) candidate[pos++] = *p;
+        }
+        candidate[pos] = '\0';
+
+        fat16_dir_entry_t existing;
+        if (!dir_scan(dir, candidate, &existing, NULL, NULL)) {
+            parse_filename(candidate, (char*)entry->filename, (char*)entry->extension);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Add a new entry named 'name' to a directory. Names that don't fit 8.3
+// get a short alias preceded by long name fragments. 'entry' carries
+// everything but the name; its slot is returned in 'index'.
+static bool dir_add_entry(uint16_t dir, const char* name, fat16_dir_entry_t* entry, uint32_t* index) {
+    uint32_t fragments = 0;
+    if (is_short_name(name)) {
+        parse_filename(name, (char*)entry->filename, (char*)entry->extension);
+    } else {
+        if (!make_short_alias(dir, name, entry)) return false;
+        fragments = (strlen(name) + 12) / 13;
+    }
+
+    uint32_t first;
+    if (!dir_find_slots(dir, fragments + 1, &first)) {
+        return false; // No free entry
+    }
+
+    // Fragments are stored last first, each holding 13 UCS-2 characters
+    uint32_t len = strlen(name);
+    uint8_t sum = lfn_checksum(entry->filename);
+    for (uint32_t f = 0; f < fragments; f++) {
+        uint32_t order = fragments - f;
+        fat16_lfn_entry_t lfn;
+        memset(&lfn, 0, sizeof(lfn));
+        lfn.order = order | (f == 0 ? FAT16_LFN_LAST : 0);
+        lfn.attributes = FAT16_ATTR_LONG_NAME;
+        lfn.checksum = sum;
+
+        uint16_t chars[13];
+        for (uint32_t i = 0; i < 13; i++) {
+            uint32_t pos = (order - 1) * 13 + i;
+            chars[i] = pos < len ? (uint8_t)name[pos] : (pos == len ? 0x0000 : 0xFFFF);
+        }
+        memcpy(lfn.name1, chars, sizeof(lfn.name1));
+        memcpy(lfn.name2, chars + 5, sizeof(lfn.name2));
+        memcpy(lfn.name3, chars + 11, sizeof(lfn.name3));
+        if (!dir_write_entry(dir, first + f, (const fat16_dir_entry_t*)&lfn)) {
+            return false;
+        }
+    }
+
+    *index = first + fragments;
+    return dir_write_entry(dir, *index, entry);
+}
+
+// Mark an entry and its long name fragments deleted
+static bool dir_delete_entry(uint16_t dir, uint32_t first, uint32_t index, fat16_dir_entry_t* entry) {
+    entry->filename[0] = 0xE5;
+    entry->starting_cluster = 0;
+    entry->file_size = 0;
+    for (uint32_t slot = first; slot < index; slot++) {
+        fat16_dir_entry_t deleted;
+        memset(&deleted, 0, sizeof(deleted));
+        deleted.filename[0] = 0xE5;
+        if (!dir_write_entry(dir, slot, &deleted)) return false;
+    }
+    return dir_write_entry(dir, index, entry);
+}
+
+// Split a path into its directory, resolved from 'base', and the last
+// component, which needs FAT16_MAX_NAME + 1 bytes. "/NAME" lives in the
+// root directory.
+static bool split_path(const char* path, uint16_t base, uint16_t* dir, char* leaf) {
+    char dir_path[256] = {0};
+    const char* last_slash = strrchr(path, '/');
+
+    *dir = base;
+    if (last_slash) {
+        size_t dir_len = last_slash - path;
+        if (dir_len >= sizeof(dir_path)) return false;
+        strncpy(dir_path, path, dir_len);
+        dir_path[dir_len] = '\0';
+        path = last_slash + 1;
+        if (dir_len == 0) {
+            *dir = 0;
+        } else if (!fat16_change_directory(dir_path, dir)) {
+            return false;
+        }
+    }
+
+    if (path[0] == '\0' || strlen(path) > FAT16_MAX_NAME) return false;
+    strcpy(leaf, path);
+    return true;
+}
+
+// Look up a name in a directory, through the dentry cache. 'index' is
+// optional and receives the entry's slot in the directory.
+static bool lookup_entry_at(uint16_t dir_cluster, const char* name, fat16_dir_entry_t* out, uint16_t* index) {
+    uint8_t key[11];
+    bool cacheable = dentry_key(name, key);
+    if (cacheable) {
+        int16_t i = dentry_find(dir_cluster, key);
+        if (i != DENTRY_NONE) {
+            lru_unlink(i);
+            lru_push_front(i);
+            *out = dentry_cache[i].entry;
+            if (index) *index = dentry_cache[i].index;
+            return true;
+        }
+    }
 
-// Initialize FAT16 filesystem
+    uint32_t slot;
+    if (!dir_scan(dir_cluster, name, out, &slot, NULL)) {
+        return false;
+    }
+    if (index) *index = slot;
+
+    // Cache only names that are the entry's own 8.3 name, so the key
+    // always matches what is on disk
+    if (cacheable && memcmp(key, out->filename, 8) == 0 && memcmp(key + 8, out->extension, 3) == 0) {
+        dentry_insert(dir_cluster, key, out, slot);
+    }
+    return true;
+}
+
+static bool lookup_entry(uint16_t dir_cluster, const char* name, fat16_dir_entry_t* out) {
+    return lookup_entry_at(dir_cluster, name, out, NULL);
+}
+
+// Initialize FAT16 filesystem on the RAM image
 bool fat16_init(void) {
     terminal_writestring("FAT16: Initializing filesystem...\n");
     
@@ -74,26 +1055,42 @@ bool fat16_init(void) {
         return false;
     }
 
+    return fat16_mount(block_device_iso());
+}
+
+// Mount the FAT16 volume on a block device, replacing the current one
+bool fat16_mount(block_device_t* device) {
+    if (!device) {
+        return false;
+    }
+
     // Read boot sector
     uint8_t sector_buffer[512];
-    if (!iso_fs_read_sectors(0, 1, sector_buffer)) {
+    if (!device->read_sectors(0, 1, sector_buffer)) {
         terminal_writestring("FAT16: Failed to read boot sector\n");
         return false;
     }
-    memcpy(&boot_sector, sector_buffer, sizeof(fat16_boot_sector_t));
+    fat16_boot_sector_t* new_boot = (fat16_boot_sector_t*)sector_buffer;
 
     // Verify FAT16 signature
-    if (boot_sector.fs_type[0] != 'F' || 
-        boot_sector.fs_type[1] != 'A' || 
-        boot_sector.fs_type[2] != 'T' || 
-        boot_sector.fs_type[3] != '1' || 
-        boot_sector.fs_type[4] != '6') {
+    if (new_boot->fs_type[0] != 'F' || 
+        new_boot->fs_type[1] != 'A' || 
+        new_boot->fs_type[2] != 'T' || 
+        new_boot->fs_type[3] != '1' || 
+        new_boot->fs_type[4] != '6' ||
+        new_boot->bytes_per_sector != 512 ||
+        new_boot->sectors_per_cluster == 0) {
         terminal_writestring("FAT16: Invalid filesystem type\n");
         return false;
     }
 
     terminal_writestring("FAT16: Filesystem type verified\n");
 
+    // The old volume is written back by bcache_init below
+    memcpy(&boot_sector, sector_buffer, sizeof(fat16_boot_sector_t));
+    fat_device = device;
+    user_dir_cluster = 0;
+
     // Calculate important sector locations
     fat_start_sector = boot_sector.reserved_sectors;
     sectors_per_fat = boot_sector.fat_size_16;
@@ -103,7 +1100,15 @@ bool fat16_init(void) {
 
     terminal_writestring("FAT16: Sector locations calculated\n");
 
+    // Cache cluster-sized blocks aligned so that every data cluster is one block
+    if (!bcache_init(device, data_start_sector % boot_sector.sectors_per_cluster,
+                     boot_sector.sectors_per_cluster)) {
+        terminal_writestring("FAT16: Failed to initialize buffer cache\n");
+        return false;
+    }
+
     // Allocate memory for FAT table
+    free(fat_table);
     fat_table = (uint16_t*)malloc(sectors_per_fat * boot_sector.bytes_per_sector);
     if (!fat_table) {
         terminal_writestring("FAT16: Failed to allocate memory for FAT table\n");
@@ -111,13 +1116,21 @@ bool fat16_init(void) {
     }
 
     // Read FAT table
-    if (!iso_fs_read_sectors(fat_start_sector, sectors_per_fat, fat_table)) {
+    if (!bcache_read(fat_start_sector, sectors_per_fat, fat_table)) {
         terminal_writestring("FAT16: Failed to read FAT table\n");
         free(fat_table);
         fat_table = NULL;
         return false;
     }
 
+    if (!fat_build_free_map()) {
+        terminal_writestring("FAT16: Failed to allocate cluster bitmap\n");
+        return false;
+    }
+    dentry_init();
+    path_cache_clear();
+    name_index_clear();
+
     // After reading FAT table, find USER directory
     fat16_dir_entry_t* root_dir = (fat16_dir_entry_t*)malloc(root_dir_sectors * boot_sector.bytes_per_sector);
     if (!root_dir) {
@@ -125,7 +1138,7 @@ bool fat16_init(void) {
         return false;
     }
 
-    if (!iso_fs_read_sectors(root_dir_start_sector, root_dir_sectors, root_dir)) {
+    if (!bcache_read(root_dir_start_sector, root_dir_sectors, root_dir)) {
         free(root_dir);
         return false;
     }
@@ -146,10 +1159,15 @@ bool fat16_init(void) {
     }
 
     free(root_dir);
+    current_cluster = user_dir_cluster;
     terminal_writestring("FAT16: Filesystem initialized successfully\n");
     return true;
 }
 
+block_device_t* fat16_get_device(void) {
+    return fat_device;
+}
+
 // Convert cluster number to LBA
 uint32_t fat16_cluster_to_lba(uint16_t cluster) {
     return data_start_sector + ((cluster - 2) * boot_sector.sectors_per_cluster);
@@ -201,14 +1219,11 @@ const char* get_file_type(const fat16_dir_entry_t* entry) {
 }
 
 // Read root directory
-bool fat16_read_root_dir(void) {
-    fat16_dir_entry_t* root_dir = (fat16_dir_entry_t*)malloc(root_dir_sectors * boot_sector.bytes_per_sector);
-    if (!root_dir) {
-        return false;
-    }
-
-    if (!iso_fs_read_sectors(root_dir_start_sector, root_dir_sectors, root_dir)) {
-        free(root_dir);
+// Print a directory listing
+static bool print_directory(uint16_t dir) {
+    struct dir_walk w;
+    dir_walk_start(&w, dir);
+    if (!w.more) {
         return false;
     }
 
@@ -216,47 +1231,26 @@ bool fat16_read_root_dir(void) {
     terminal_writestring("Name           Size    Type\n");
     terminal_writestring("----------------------------------------\n");
 
-    for (int i = 0; i < boot_sector.root_entries; i++) {
-        // End of directory
-        if (root_dir[i].filename[0] == 0x00) break;
-        // Deleted entry
-        if (root_dir[i].filename[0] == 0xE5) continue;
-        // Skip long filename entries
-        if ((root_dir[i].attributes & FAT16_ATTR_LONG_NAME) == FAT16_ATTR_LONG_NAME) continue;
-        // Skip volume labels
-        if (root_dir[i].attributes & FAT16_ATTR_VOLUME_ID) continue;
-
-        // Format filename
-        char name[13] = {0};
-        int name_idx = 0;
-        for (int j = 0; j < 8; j++) {
-            if (root_dir[i].filename[j] != ' ') {
-                name[name_idx++] = root_dir[i].filename[j];
-            }
-        }
-        if (root_dir[i].extension[0] != ' ') {
-            name[name_idx++] = '.';
-            for (int j = 0; j < 3; j++) {
-                if (root_dir[i].extension[j] != ' ') {
-                    name[name_idx++] = root_dir[i].extension[j];
-                }
-            }
-        }
-        name[name_idx] = '\0';
-
+    fat16_dir_entry_t* entry;
+    uint32_t index, first;
+    char name[FAT16_MAX_NAME + 1];
+    while (dir_walk_next(&w, &entry, &index, &first, name)) {
         // Print name, padded to 16 chars
         terminal_writestring(name);
         int name_len = strlen(name);
         for (int s = name_len; s < 16; s++) {
             terminal_putchar(' ');
         }
+        if (name_len >= 16) {
+            terminal_putchar(' ');
+        }
 
         // Print size or blank for directories
-        if (root_dir[i].attributes & FAT16_ATTR_DIRECTORY) {
+        if (entry->attributes & FAT16_ATTR_DIRECTORY) {
             terminal_writestring("        ");
         } else {
             char size_str[16];
-            itoa_custom(root_dir[i].file_size, size_str, 10);
+            itoa_custom(entry->file_size, size_str, 10);
             terminal_writestring(size_str);
             int size_len = strlen(size_str);
             for (int s = size_len; s < 8; s++) {
@@ -265,104 +1259,210 @@ bool fat16_read_root_dir(void) {
         }
 
         // Print type
-        const char* type_str = get_file_type(&root_dir[i]);
-        terminal_writestring(type_str);
+        terminal_writestring(get_file_type(entry));
         terminal_putchar('\n');
     }
-
-    free(root_dir);
     return true;
 }
 
+bool fat16_read_root_dir(void) {
+    return print_directory(0);
+}
+
+// Look up a file by path. The directory part is resolved from the
+// current directory, which is left unchanged. 'dir' and 'index' are
+// optional and receive where the entry lives.
+static bool find_file_at(const char* filename, fat16_dir_entry_t* out, uint16_t* dir, uint16_t* index) {
+    uint16_t dir_cluster;
+    char file_name[FAT16_MAX_NAME + 1];
+    if (!split_path(filename, current_cluster, &dir_cluster, file_name)) {
+        return false;
+    }
+    if (dir) *dir = dir_cluster;
+    return lookup_entry_at(dir_cluster, file_name, out, index);
+}
+
+static bool find_file(const char* filename, fat16_dir_entry_t* out) {
+    return find_file_at(filename, out, NULL, NULL);
+}
+
 // Read file contents
 int fat16_read_file(const char* filename, void* buffer, uint32_t max_size) {
-    // Parse path into directory and filename
-    char dir_path[256] = {0};
-    char file_name[13] = {0};
-    const char* last_slash = strrchr(filename, '/');
-    
-    if (last_slash) {
-        // Copy directory path
-        int dir_len = last_slash - filename;
-        if (dir_len >= sizeof(dir_path)) return 0;
-        strncpy(dir_path, filename, dir_len);
-        dir_path[dir_len] = '\0';
-        
-        // Copy filename
-        strncpy(file_name, last_slash + 1, sizeof(file_name) - 1);
-    } else {
-        // No directory specified, use current directory
-        strncpy(file_name, filename, sizeof(file_name) - 1);
+    // Find file in directory
+    fat16_dir_entry_t file_entry;
+    if (!find_file(filename, &file_entry)) {
+        return 0;
     }
-    
-    // Save current directory
-    uint16_t saved_cluster = current_cluster;
-    
-    // If directory path exists, change to it
-    if (dir_path[0] != '\0') {
-        if (!fat16_change_directory(dir_path, &current_cluster)) {
+
+    // Check for empty file
+    if (file_entry.file_size == 0) {
+        return -1; // Special value for empty file
+    }
+
+    uint32_t cluster_size = boot_sector.sectors_per_cluster * boot_sector.bytes_per_sector;
+    uint32_t size = file_entry.file_size < max_size ? file_entry.file_size : max_size;
+    uint16_t cluster = file_entry.starting_cluster;
+    uint32_t bytes_read = 0;
+    uint8_t* data_buffer = (uint8_t*)buffer;
+
+    // Whole clusters go straight into the buffer, one read per run of
+    // consecutive clusters
+    while (size - bytes_read >= cluster_size && cluster >= 2 && !fat16_is_end_of_chain(cluster)) {
+        uint16_t first = cluster;
+        uint32_t run = 1;
+        cluster = fat16_get_next_cluster(cluster);
+        while (bytes_read + (run + 1) * cluster_size <= size && cluster == first + run) {
+            run++;
+            cluster = fat16_get_next_cluster(cluster);
+        }
+        if (!bcache_read_direct(fat16_cluster_to_lba(first), run * boot_sector.sectors_per_cluster,
+                                data_buffer + bytes_read)) {
             return 0;
         }
+        bytes_read += run * cluster_size;
     }
-    
-    fat16_dir_entry_t* dir_entries = (fat16_dir_entry_t*)malloc(root_dir_sectors * boot_sector.bytes_per_sector);
-    if (!dir_entries) {
-        current_cluster = saved_cluster; // Restore directory
-        return 0;
+
+    // Then the part of the last cluster that fits
+    if (bytes_read < size && cluster >= 2 && !fat16_is_end_of_chain(cluster)) {
+        struct bcache_buf* buf = bcache_get(fat16_cluster_to_lba(cluster));
+        if (!buf) {
+            return 0;
+        }
+        memcpy(data_buffer + bytes_read, buf->data, size - bytes_read);
+        bcache_release(buf);
     }
 
-    // Read current directory
-    if (!fat16_read_directory(current_cluster, dir_entries, boot_sector.root_entries)) {
-        free(dir_entries);
-        current_cluster = saved_cluster; // Restore directory
-        return 0;
+    return 1;
+}
+
+// Read a whole file into one heap buffer, for volumes that can't be mapped
+static bool map_file_copy(uint16_t cluster, struct fat16_map* map) {
+    uint32_t cluster_size = boot_sector.sectors_per_cluster * boot_sector.bytes_per_sector;
+    uint32_t clusters = (map->size + cluster_size - 1) / cluster_size;
+    map->copy = (uint8_t*)malloc(clusters * cluster_size);
+    if (!map->copy) {
+        return false;
     }
 
-    // Find file in directory
-    fat16_dir_entry_t* file_entry = find_directory_entry(dir_entries, boot_sector.root_entries, file_name);
-    if (!file_entry) {
-        free(dir_entries);
-        current_cluster = saved_cluster; // Restore directory
-        return 0;
+    for (uint32_t i = 0; i < clusters; i++) {
+        if (cluster < 2 || fat16_is_end_of_chain(cluster) ||
+            !bcache_read(fat16_cluster_to_lba(cluster), boot_sector.sectors_per_cluster,
+                         map->copy + i * cluster_size)) {
+            free(map->copy);
+            map->copy = NULL;
+            return false;
+        }
+        cluster = fat16_get_next_cluster(cluster);
+    }
+
+    map->count = 1;
+    map->extents[0].data = map->copy;
+    map->extents[0].length = map->size;
+    return true;
+}
+
+bool fat16_map_file(const char* filename, struct fat16_map* map) {
+    map->size = 0;
+    map->count = 0;
+    map->copy = NULL;
+
+    fat16_dir_entry_t file_entry;
+    if (!fat_table || !find_file(filename, &file_entry)) {
+        return false;
+    }
+    if (file_entry.attributes & FAT16_ATTR_DIRECTORY) {
+        return false;
+    }
+
+    map->size = file_entry.file_size;
+    if (map->size == 0) {
+        return true;
     }
 
-    // Check for empty file
-    if (file_entry->file_size == 0) {
-        free(dir_entries);
-        current_cluster = saved_cluster; // Restore directory
-        return -1; // Special value for empty file
+    uint16_t cluster = file_entry.starting_cluster;
+    if (!fat_device->map_sectors) {
+        return map_file_copy(cluster, map);
     }
 
-    // Read file data
-    uint16_t cluster = file_entry->starting_cluster;
-    uint32_t bytes_read = 0;
-    uint8_t* data_buffer = (uint8_t*)buffer;
+    // Walk the chain, merging physically adjacent clusters into one extent
+    uint32_t spc = boot_sector.sectors_per_cluster;
+    uint32_t cluster_size = spc * boot_sector.bytes_per_sector;
+    uint32_t remaining = map->size;
+    while (remaining) {
+        if (cluster < 2 || fat16_is_end_of_chain(cluster)) {
+            map->count = 0;
+            return false;  // Chain shorter than the file size
+        }
 
-    while (cluster != 0xFFFF && !fat16_is_end_of_chain(cluster)) {
-        uint32_t lba = fat16_cluster_to_lba(cluster);
-        if (!iso_fs_read_sectors(lba, boot_sector.sectors_per_cluster, data_buffer + bytes_read)) {
-            free(dir_entries);
-            current_cluster = saved_cluster; // Restore directory
-            return 0;
+        uint16_t first = cluster;
+        uint32_t run = 1;
+        uint32_t bytes = cluster_size;
+        while (bytes < remaining) {
+            uint16_t next = fat16_get_next_cluster(cluster);
+            if (next != cluster + 1) break;
+            cluster = next;
+            run++;
+            bytes += cluster_size;
+        }
+        if (bytes > remaining) bytes = remaining;
+
+        // Too fragmented to describe; hand out a copy instead
+        if (map->count == FAT16_MAP_EXTENTS) {
+            map->count = 0;
+            return map_file_copy(file_entry.starting_cluster, map);
+        }
+
+        uint32_t lba = fat16_cluster_to_lba(first);
+        const void* data = NULL;
+        if (bcache_sync(lba, run * spc)) {
+            data = fat_device->map_sectors(lba, run * spc);
+        }
+        if (!data) {
+            map->count = 0;
+            return false;
         }
-        bytes_read += boot_sector.sectors_per_cluster * boot_sector.bytes_per_sector;
-        if (bytes_read >= max_size) break;
+
+        map->extents[map->count].data = (const uint8_t*)data;
+        map->extents[map->count].length = bytes;
+        map->count++;
+        remaining -= bytes;
         cluster = fat16_get_next_cluster(cluster);
     }
+    return true;
+}
 
-    free(dir_entries);
-    current_cluster = saved_cluster; // Restore directory
-    return 1;
+void fat16_unmap_file(struct fat16_map* map) {
+    free(map->copy);
+    map->copy = NULL;
+    map->count = 0;
+    map->size = 0;
+}
+
+uint32_t fat16_map_read(const struct fat16_map* map, uint32_t offset, void* buffer, uint32_t size) {
+    uint8_t* out = (uint8_t*)buffer;
+    uint32_t done = 0;
+    for (int i = 0; i < map->count && done < size; i++) {
+        const struct fat16_extent* extent = &map->extents[i];
+        if (offset >= extent->length) {
+            offset -= extent->length;
+            continue;
+        }
+        uint32_t n = extent->length - offset;
+        if (n > size - done) n = size - done;
+        memcpy(out + done, extent->data + offset, n);
+        done += n;
+        offset = 0;
+    }
+    return done;
 }
 
 // List directory contents
 bool fat16_list_directory(const char* path) {
-    // For now, we only support root directory
-    if (path[0] != '\0' && strcmp(path, "/") != 0) {
+    uint16_t dir = current_cluster;
+    if (path && path[0] != '\0' && !fat16_change_directory(path, &dir)) {
         return false;
     }
-
-    return fat16_read_root_dir();
+    return print_directory(dir);
 }
 
 // Helper function to parse filename and extension
@@ -377,8 +1477,7 @@ static void parse_filename(const char* filename, char* name, char* ext) {
     // Handle name (up to 8 chars)
     if (name_len > 8) name_len = 8;
     for (int i = 0; i < name_len; i++) {
-        // Preserve original case
-        name[i] = filename[i];
+        name[i] = toupper(filename[i]);
     }
     
     // Handle extension (up to 3 chars)
@@ -386,511 +1485,268 @@ static void parse_filename(const char* filename, char* name, char* ext) {
         int ext_len = strlen(dot + 1);
         if (ext_len > 3) ext_len = 3;
         for (int i = 0; i < ext_len; i++) {
-            // Preserve original case
-            ext[i] = dot[1 + i];
+            ext[i] = toupper(dot[1 + i]);
         }
     }
 }
 
 // Helper function to compare filenames case-insensitively
 static bool compare_filenames(const char* name1, const char* name2) {
-    char upper1[13] = {0};
-    char upper2[13] = {0};
-    int idx1 = 0, idx2 = 0;
-    
-    // Convert first name to uppercase
-    for (int i = 0; name1[i]; i++) {
-        upper1[idx1++] = toupper(name1[i]);
-    }
-    
-    // Convert second name to uppercase
-    for (int i = 0; name2[i]; i++) {
-        upper2[idx2++] = toupper(name2[i]);
-    }
-    
-    return strcmp(upper1, upper2) == 0;
-}
-
-// Helper function to find first free cluster
-static uint16_t find_free_cluster(void) {
-    // Start from cluster 2 (first data cluster)
-    for (uint16_t cluster = 2; cluster < 0xFFF8; cluster++) {
-        if (fat_table[cluster] == 0x0000) {
-            return cluster;
-        }
+    while (*name1 && toupper(*name1) == toupper(*name2)) {
+        name1++;
+        name2++;
     }
-    return 0xFFFF;  // No free clusters found
+    return toupper(*name1) == toupper(*name2);
 }
 
 bool fat16_remove_file(const char* filename) {
-    // Only support root directory
-    fat16_dir_entry_t* root_dir = (fat16_dir_entry_t*)malloc(root_dir_sectors * boot_sector.bytes_per_sector);
-    if (!root_dir) return false;
-    
-    // Read root directory
-    if (!iso_fs_read_sectors(root_dir_start_sector, root_dir_sectors, root_dir)) {
-        free(root_dir);
-        return false;
-    }
-
-    // Find file entry
-    int file_index = -1;
-    for (int i = 0; i < boot_sector.root_entries; i++) {
-        if (root_dir[i].filename[0] == 0x00) break;
-        if (root_dir[i].filename[0] == 0xE5) continue;
-        if ((root_dir[i].attributes & FAT16_ATTR_LONG_NAME) == FAT16_ATTR_LONG_NAME) continue;
-        if (root_dir[i].attributes & FAT16_ATTR_VOLUME_ID) continue;
-        
-        // Compare name
-        char entry_name[13];
-        int name_idx = 0;
-        for (int j = 0; j < 8; j++) if (root_dir[i].filename[j] != ' ') entry_name[name_idx++] = root_dir[i].filename[j];
-        if (root_dir[i].extension[0] != ' ') {
-            entry_name[name_idx++] = '.';
-            for (int j = 0; j < 3; j++) if (root_dir[i].extension[j] != ' ') entry_name[name_idx++] = root_dir[i].extension[j];
-        }
-        entry_name[name_idx] = '\0';
-        
-        if (compare_filenames(entry_name, filename)) {
-            file_index = i;
-            break;
-        }
-    }
-
-    if (file_index == -1) {
-        free(root_dir);
+    uint16_t dir;
+    char name[FAT16_MAX_NAME + 1];
+    fat16_dir_entry_t entry;
+    uint32_t index, first;
+    if (!split_path(filename, current_cluster, &dir, name) || !dir_scan(dir, name, &entry, &index, &first)) {
         return false; // File not found
     }
+    if (entry.attributes & FAT16_ATTR_DIRECTORY) {
+        return false; // Directories go through fat16_rmdir
+    }
 
     // Free all clusters used by the file
-    uint16_t cluster = root_dir[file_index].starting_cluster;
-    if (cluster != 0) {  // Only try to free clusters if the file has any
-        while (cluster != 0xFFFF && !fat16_is_end_of_chain(cluster)) {
-            uint16_t next_cluster = fat_table[cluster];
-            fat_table[cluster] = 0x0000;  // Mark as free
-            cluster = next_cluster;
-        }
-
-        // Write back FAT table first
-        if (!iso_fs_write_sectors(fat_start_sector, sectors_per_fat, fat_table)) {
-            free(root_dir);
-            return false;
-        }
+    if (entry.starting_cluster != 0) {
+        fat_free_chain(entry.starting_cluster);
     }
 
     // Now mark directory entry as deleted
-    root_dir[file_index].filename[0] = 0xE5;
-    root_dir[file_index].starting_cluster = 0;  // Clear starting cluster
-    root_dir[file_index].file_size = 0;        // Clear file size
-
-    // Write back FAT table
-    if (!iso_fs_write_sectors(fat_start_sector, sectors_per_fat, fat_table)) {
-        free(root_dir);
-        return false;
-    }
-
-    // Write back root directory
-    if (!iso_fs_write_sectors(root_dir_start_sector, root_dir_sectors, root_dir)) {
-        free(root_dir);
-        return false;
-    }
-
-    free(root_dir);
-    return true;
+    return fat_flush() && dir_delete_entry(dir, first, index, &entry);
 }
 
 bool fat16_write_file(const char* filename, const void* buffer, uint32_t size) {
-    fat16_dir_entry_t* dir_entries = (fat16_dir_entry_t*)malloc(root_dir_sectors * boot_sector.bytes_per_sector);
-    if (!dir_entries) return false;
-
-    // Read current directory
-    if (!fat16_read_directory(current_cluster, dir_entries, boot_sector.root_entries)) {
-        free(dir_entries);
+    uint16_t dir;
+    char name[FAT16_MAX_NAME + 1];
+    if (!split_path(filename, current_cluster, &dir, name)) {
         return false;
     }
 
     // Find or create file entry
-    fat16_dir_entry_t* file_entry = find_directory_entry(dir_entries, boot_sector.root_entries, filename);
-    int file_index = -1;
-
-    // If file exists, free its clusters
-    if (file_entry) {
-        uint16_t cluster = file_entry->starting_cluster;
-        while (cluster != 0xFFFF && !fat16_is_end_of_chain(cluster)) {
-            uint16_t next_cluster = fat_table[cluster];
-            fat_table[cluster] = 0x0000;  // Mark as free
-            cluster = next_cluster;
-        }
-    } else {
-        // Find a free entry
-        for (int i = 0; i < boot_sector.root_entries; i++) {
-            if (dir_entries[i].filename[0] == 0x00 || dir_entries[i].filename[0] == 0xE5) {
-                file_index = i;
-                file_entry = &dir_entries[i];
-                break;
-            }
-        }
-        if (file_index == -1) {
-            free(dir_entries);
-            return false; // No free entry
-        }
+    fat16_dir_entry_t file_entry;
+    uint32_t file_index;
+    bool exists = dir_scan(dir, name, &file_entry, &file_index, NULL);
+    if (exists && (file_entry.attributes & FAT16_ATTR_DIRECTORY)) {
+        return false;
     }
 
+    // If file exists, its clusters are freed once the new data is written
+    uint16_t old_cluster = exists ? file_entry.starting_cluster : 0;
+
     // Calculate how many clusters are needed
     uint32_t bytes_per_cluster = boot_sector.sectors_per_cluster * boot_sector.bytes_per_sector;
     uint32_t clusters_needed = (size + bytes_per_cluster - 1) / bytes_per_cluster;
     if (clusters_needed == 0) clusters_needed = 1;
 
-    // Allocate clusters
-    uint16_t first_cluster = 0;
-    uint16_t prev_cluster = 0;
-    uint32_t bytes_written = 0;
-    for (uint32_t c = 0; c < clusters_needed; c++) {
-        // Find a free cluster
-        uint16_t free_cluster = find_free_cluster();
-        if (free_cluster == 0xFFFF) {
-            // If we failed to allocate all clusters, free the ones we did allocate
-            if (first_cluster != 0) {
-                uint16_t cluster = first_cluster;
-                while (cluster != 0xFFFF && !fat16_is_end_of_chain(cluster)) {
-                    uint16_t next_cluster = fat_table[cluster];
-                    fat_table[cluster] = 0x0000;  // Mark as free
-                    cluster = next_cluster;
-                }
-            }
-            free(dir_entries);
-            return false; // No free cluster
-        }
-        // Mark as end of chain for now
-        fat_table[free_cluster] = 0xFFF8;
-        if (prev_cluster != 0) fat_table[prev_cluster] = free_cluster;
-        if (first_cluster == 0) first_cluster = free_cluster;
-        prev_cluster = free_cluster;
-
-        // Write data to cluster
-        uint32_t lba = fat16_cluster_to_lba(free_cluster);
-        uint32_t to_write = (size - bytes_written > bytes_per_cluster) ? bytes_per_cluster : (size - bytes_written);
-        if (!iso_fs_write_sectors(lba, boot_sector.sectors_per_cluster, (uint8_t*)buffer + bytes_written)) {
-            // If write failed, free all allocated clusters
-            if (first_cluster != 0) {
-                uint16_t cluster = first_cluster;
-                while (cluster != 0xFFFF && !fat16_is_end_of_chain(cluster)) {
-                    uint16_t next_cluster = fat_table[cluster];
-                    fat_table[cluster] = 0x0000;  // Mark as free
-                    cluster = next_cluster;
-                }
-            }
-            free(dir_entries);
-            return false;
+    // Allocate the whole chain at once, contiguous where possible
+    uint16_t first_cluster = fat_alloc_chain(clusters_needed);
+    if (first_cluster == 0) {
+        return false; // No free cluster
+    }
+
+    // Write whole clusters, one write per contiguous run
+    uint32_t full_clusters = size / bytes_per_cluster;
+    uint32_t done = 0;
+    uint16_t cluster = first_cluster;
+    bool ok = true;
+    while (ok && done < full_clusters) {
+        uint32_t run = 1;
+        while (done + run < full_clusters && fat_table[cluster + run - 1] == cluster + run) {
+            run++;
+        }
+        ok = bcache_write(fat16_cluster_to_lba(cluster), run * boot_sector.sectors_per_cluster,
+                                  (const uint8_t*)buffer + done * bytes_per_cluster);
+        done += run;
+        cluster = fat_table[cluster + run - 1];
+    }
+
+    // The partial last cluster goes through a zero-padded buffer
+    uint32_t tail = size % bytes_per_cluster;
+    if (ok && tail) {
+        uint8_t* cluster_buffer = (uint8_t*)malloc(bytes_per_cluster);
+        ok = cluster_buffer != NULL;
+        if (ok) {
+            memcpy(cluster_buffer, (const uint8_t*)buffer + done * bytes_per_cluster, tail);
+            memset(cluster_buffer + tail, 0, bytes_per_cluster - tail);
+            ok = bcache_write(fat16_cluster_to_lba(cluster), boot_sector.sectors_per_cluster,
+                                      cluster_buffer);
+            free(cluster_buffer);
         }
-        bytes_written += to_write;
-    }
-
-    // Update directory entry
-    if (file_index != -1) {
-        // Parse filename and extension
-        char name[8], ext[3];
-        parse_filename(filename, name, ext);
-        memcpy(file_entry->filename, name, 8);
-        memcpy(file_entry->extension, ext, 3);
-        file_entry->attributes = 0;
-        memset(file_entry->reserved, 0, 10);
-        file_entry->time = 0;
-        file_entry->date = 0;
     }
-    file_entry->starting_cluster = first_cluster;
-    file_entry->file_size = size;
 
-    // Write back FAT table
-    if (!iso_fs_write_sectors(fat_start_sector, sectors_per_fat, fat_table)) {
-        free(dir_entries);
+    if (!ok) {
+        fat_free_chain(first_cluster);
         return false;
     }
+    fat_free_chain(old_cluster);
 
-    // Write back directory
-    if (current_cluster == 0) {
-        // Root directory
-        if (!iso_fs_write_sectors(root_dir_start_sector, root_dir_sectors, dir_entries)) {
-            free(dir_entries);
-            return false;
-        }
-    } else {
-        // Subdirectory - write the entire cluster chain
-        uint16_t cluster = current_cluster;
-        uint32_t bytes_written = 0;
-        uint32_t bytes_per_cluster = boot_sector.sectors_per_cluster * boot_sector.bytes_per_sector;
-        
-        while (cluster != 0xFFFF && !fat16_is_end_of_chain(cluster)) {
-            uint32_t lba = fat16_cluster_to_lba(cluster);
-            if (!iso_fs_write_sectors(lba, boot_sector.sectors_per_cluster, 
-                                   (uint8_t*)dir_entries + bytes_written)) {
-                free(dir_entries);
-                return false;
-            }
-            bytes_written += bytes_per_cluster;
-            cluster = fat16_get_next_cluster(cluster);
-        }
-        
-        // If we need more clusters for the directory
-        if (bytes_written < root_dir_sectors * boot_sector.bytes_per_sector) {
-            uint16_t new_cluster = find_free_cluster();
-            if (new_cluster == 0xFFFF) {
-                free(dir_entries);
-                return false;
-            }
-            
-            // Link the new cluster
-            fat_table[cluster] = new_cluster;
-            fat_table[new_cluster] = 0xFFF8;
-            
-            // Write the remaining data
-            uint32_t lba = fat16_cluster_to_lba(new_cluster);
-            if (!iso_fs_write_sectors(lba, boot_sector.sectors_per_cluster, 
-                                   (uint8_t*)dir_entries + bytes_written)) {
-                free(dir_entries);
-                return false;
-            }
-            
-            // Write back FAT table
-            if (!iso_fs_write_sectors(fat_start_sector, sectors_per_fat, fat_table)) {
-                free(dir_entries);
-                return false;
-            }
-        }
+    // Update directory entry, or add one for a new file
+    if (!exists) {
+        memset(&file_entry, 0, sizeof(file_entry));
     }
+    file_entry.starting_cluster = first_cluster;
+    file_entry.file_size = size;
 
-    free(dir_entries);
-    return true;
+    // Write back FAT table, then the entry
+    if (!fat_flush()) {
+        return false;
+    }
+    if (exists) {
+        return dir_write_entry(dir, file_index, &file_entry);
+    }
+    if (!dir_add_entry(dir, name, &file_entry, &file_index)) {
+        fat_free_chain(first_cluster);  // No free entry
+        fat_flush();
+        return false;
+    }
+    return fat_flush();
 }
 
 bool fat16_create_file(const char* filename, uint16_t current_cluster) {
-    fat16_dir_entry_t* dir_entries = (fat16_dir_entry_t*)malloc(root_dir_sectors * boot_sector.bytes_per_sector);
-    if (!dir_entries) return false;
-
-    // Read current directory
-    if (!fat16_read_directory(current_cluster, dir_entries, boot_sector.root_entries)) {
-        free(dir_entries);
+    uint16_t dir;
+    char name[FAT16_MAX_NAME + 1];
+    fat16_dir_entry_t entry;
+    uint32_t index;
+    if (!split_path(filename, current_cluster, &dir, name)) {
         return false;
     }
-
-    // Check if file already exists
-    for (int i = 0; i < boot_sector.root_entries; i++) {
-        if (dir_entries[i].filename[0] == 0x00) break;
-        if (dir_entries[i].filename[0] == 0xE5) continue;
-        if ((dir_entries[i].attributes & FAT16_ATTR_LONG_NAME) == FAT16_ATTR_LONG_NAME) continue;
-        if (dir_entries[i].attributes & FAT16_ATTR_VOLUME_ID) continue;
-        
-        // Compare name
-        char entry_name[13];
-        int name_idx = 0;
-        for (int j = 0; j < 8; j++) if (dir_entries[i].filename[j] != ' ') entry_name[name_idx++] = dir_entries[i].filename[j];
-        if (dir_entries[i].extension[0] != ' ') {
-            entry_name[name_idx++] = '.';
-            for (int j = 0; j < 3; j++) if (dir_entries[i].extension[j] != ' ') entry_name[name_idx++] = dir_entries[i].extension[j];
-        }
-        entry_name[name_idx] = '\0';
-        
-        if (compare_filenames(entry_name, filename)) {
-            free(dir_entries);
-            return false; // File already exists
-        }
-    }
-
-    // Find a free entry
-    int free_idx = -1;
-    for (int i = 0; i < boot_sector.root_entries; i++) {
-        if (dir_entries[i].filename[0] == 0x00 || dir_entries[i].filename[0] == 0xE5) {
-            free_idx = i;
-            break;
-        }
-    }
-    if (free_idx == -1) {
-        free(dir_entries);
-        return false; // No free entry
+    if (dir_scan(dir, name, &entry, &index, NULL)) {
+        return false; // File already exists
     }
 
     // Find a free cluster for the new file
-    uint16_t free_cluster = find_free_cluster();
-    if (free_cluster == 0xFFFF) {
-        free(dir_entries);
+    uint16_t free_cluster = fat_alloc_chain(1);
+    if (free_cluster == 0) {
         return false; // No free clusters
     }
 
-    // Parse filename and extension
-    char name[8], ext[3];
-    parse_filename(filename, name, ext);
+    memset(&entry, 0, sizeof(entry));
+    entry.starting_cluster = free_cluster;
+    if (!dir_add_entry(dir, name, &entry, &index)) {
+        fat_free_chain(free_cluster);  // No free entry
+        fat_flush();
+        return false;
+    }
+    return fat_flush();
+}
 
-    // Write entry
-    memcpy(dir_entries[free_idx].filename, name, 8);
-    memcpy(dir_entries[free_idx].extension, ext, 3);
-    dir_entries[free_idx].attributes = 0;
-    memset(dir_entries[free_idx].reserved, 0, 10);
-    dir_entries[free_idx].time = 0;
-    dir_entries[free_idx].date = 0;
-    dir_entries[free_idx].starting_cluster = free_cluster;
-    dir_entries[free_idx].file_size = 0;
+bool fat16_mkdir(const char* path) {
+    uint16_t parent;
+    char name[FAT16_MAX_NAME + 1];
+    fat16_dir_entry_t entry;
+    uint32_t index;
+    if (!split_path(path, current_cluster, &parent, name)) {
+        return false;
+    }
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0 || dir_scan(parent, name, &entry, &index, NULL)) {
+        return false; // Already exists
+    }
 
-    // Mark the cluster as end of chain
-    fat_table[free_cluster] = 0xFFF8;
+    uint16_t cluster = fat_alloc_chain(1);
+    if (cluster == 0) {
+        return false; // No free clusters
+    }
 
-    // Write back FAT table
-    if (!iso_fs_write_sectors(fat_start_sector, sectors_per_fat, fat_table)) {
-        free(dir_entries);
+    // New directory: "." and ".." followed by free entries
+    struct bcache_buf* buf = bcache_get_nofill(fat16_cluster_to_lba(cluster));
+    if (!buf) {
+        fat_free_chain(cluster);
+        return false;
+    }
+    memset(buf->data, 0, bcache_block_size());
+    fat16_dir_entry_t* dot = (fat16_dir_entry_t*)buf->data;
+    memset(dot[0].filename, ' ', 11);
+    memset(dot[1].filename, ' ', 11);
+    dot[0].filename[0] = '.';
+    dot[1].filename[0] = '.';
+    dot[1].filename[1] = '.';
+    dot[0].attributes = FAT16_ATTR_DIRECTORY;
+    dot[1].attributes = FAT16_ATTR_DIRECTORY;
+    dot[0].starting_cluster = cluster;
+    dot[1].starting_cluster = parent;
+    bcache_mark_dirty(buf);
+    bcache_release(buf);
+
+    name_index_drop(cluster);
+    memset(&entry, 0, sizeof(entry));
+    entry.attributes = FAT16_ATTR_DIRECTORY;
+    entry.starting_cluster = cluster;
+    if (!dir_add_entry(parent, name, &entry, &index)) {
+        fat_free_chain(cluster);  // No free entry
+        fat_flush();
         return false;
     }
+    return fat_flush();
+}
 
-    // Write back directory
-    if (current_cluster == 0) {
-        // Root directory
-        if (!iso_fs_write_sectors(root_dir_start_sector, root_dir_sectors, dir_entries)) {
-            free(dir_entries);
-            return false;
-        }
-    } else {
-        // Subdirectory handling
-        uint32_t entries_per_cluster = (boot_sector.sectors_per_cluster * boot_sector.bytes_per_sector) / sizeof(fat16_dir_entry_t);
-        uint32_t target_cluster = current_cluster;
-        uint32_t remaining_entries = free_idx;
-        
-        // Find the cluster containing our entry
-        while (remaining_entries >= entries_per_cluster) {
-            target_cluster = fat16_get_next_cluster(target_cluster);
-            if (target_cluster == 0xFFFF || fat16_is_end_of_chain(target_cluster)) {
-                // We need to extend the directory cluster chain
-                uint16_t new_cluster = find_free_cluster();
-                if (new_cluster == 0xFFFF) {
-                    free(dir_entries);
-                    return false;
-                }
-                
-                // Link the new cluster
-                fat_table[target_cluster] = new_cluster;
-                fat_table[new_cluster] = 0xFFF8;
-                
-                // Update target cluster
-                target_cluster = new_cluster;
-                
-                // Write back FAT table
-                if (!iso_fs_write_sectors(fat_start_sector, sectors_per_fat, fat_table)) {
-                    free(dir_entries);
-                    return false;
-                }
-                
-                break;
-            }
-            remaining_entries -= entries_per_cluster;
-        }
-        
-        // Calculate offset within the target cluster
-        uint32_t offset = remaining_entries * sizeof(fat16_dir_entry_t);
-        uint32_t lba = fat16_cluster_to_lba(target_cluster);
-        
-        // Read the target cluster
-        uint8_t* cluster_buffer = (uint8_t*)malloc(boot_sector.sectors_per_cluster * boot_sector.bytes_per_sector);
-        if (!cluster_buffer) {
-            free(dir_entries);
-            return false;
-        }
-        
-        if (!iso_fs_read_sectors(lba, boot_sector.sectors_per_cluster, cluster_buffer)) {
-            free(cluster_buffer);
-            free(dir_entries);
+// True if only "." and ".." are left in a directory
+static bool dir_is_empty(uint16_t dir) {
+    struct dir_iter it;
+    for (bool ok = dir_iter_start(&it, dir); ok; ok = dir_iter_next(&it)) {
+        for (uint32_t i = 0; i < DIR_ENTRIES_PER_SECTOR; i++) {
+            fat16_dir_entry_t* child = &it.entries[i];
+            if (child->filename[0] == 0x00) return true;
+            if (!entry_visible(child)) continue;
+            if (child->filename[0] == '.' && (child->filename[1] == ' ' ||
+                (child->filename[1] == '.' && child->filename[2] == ' '))) continue;
             return false;
         }
-        
-        // Copy our new entry to the correct position
-        memcpy(cluster_buffer + offset, &dir_entries[free_idx], sizeof(fat16_dir_entry_t));
-        
-        // Write back the modified cluster
-        if (!iso_fs_write_sectors(lba, boot_sector.sectors_per_cluster, cluster_buffer)) {
-            free(cluster_buffer);
-            free(dir_entries);
-            return false;
-        }
-        
-        free(cluster_buffer);
     }
-
-    free(dir_entries);
     return true;
 }
 
-// Function to find a directory entry by name
-static fat16_dir_entry_t* find_directory_entry(fat16_dir_entry_t* dir, int num_entries, const char* name) {
-    for (int i = 0; i < num_entries; i++) {
-        if (dir[i].filename[0] == 0x00) break;
-        if (dir[i].filename[0] == 0xE5) continue;
-        if ((dir[i].attributes & FAT16_ATTR_LONG_NAME) == FAT16_ATTR_LONG_NAME) continue;
-        if (dir[i].attributes & FAT16_ATTR_VOLUME_ID) continue;
-
-        // Format entry name
-        char entry_name[13] = {0};
-        int name_idx = 0;
-        for (int j = 0; j < 8; j++) {
-            if (dir[i].filename[j] != ' ') {
-                entry_name[name_idx++] = dir[i].filename[j];
-            }
-        }
-        if (dir[i].extension[0] != ' ') {
-            entry_name[name_idx++] = '.';
-            for (int j = 0; j < 3; j++) {
-                if (dir[i].extension[j] != ' ') {
-                    entry_name[name_idx++] = dir[i].extension[j];
-                }
-            }
-        }
-        entry_name[name_idx] = '\0';
+bool fat16_rmdir(const char* path) {
+    uint16_t parent;
+    char name[FAT16_MAX_NAME + 1];
+    fat16_dir_entry_t entry;
+    uint32_t index, first;
+    if (!split_path(path, current_cluster, &parent, name)) {
+        return false;
+    }
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+        return false;
+    }
+    if (!dir_scan(parent, name, &entry, &index, &first) || !(entry.attributes & FAT16_ATTR_DIRECTORY)) {
+        return false; // Not a directory
+    }
+    uint16_t cluster = entry.starting_cluster;
+    if (cluster < 2 || cluster == current_cluster || cluster == user_dir_cluster) {
+        return false; // Still in use
+    }
 
-        if (compare_filenames(entry_name, name)) {
-            return &dir[i];
-        }
+    if (!dir_is_empty(cluster)) {
+        return false;
     }
-    return NULL;
+
+    dentry_invalidate_dir(cluster);
+    name_index_drop(cluster);
+    path_cache_clear();
+    fat_free_chain(cluster);
+
+    return fat_flush() && dir_delete_entry(parent, first, index, &entry);
 }
 
 // Function to read a directory's contents
 bool fat16_read_directory(uint16_t cluster, fat16_dir_entry_t* entries, int max_entries) {
-    if (cluster == 0) {
-        // Root directory
-        if (!iso_fs_read_sectors(root_dir_start_sector, root_dir_sectors, entries)) {
-            return false;
-        }
-        // Clear any remaining entries
-        memset((uint8_t*)entries + (root_dir_sectors * boot_sector.bytes_per_sector), 0,
-               (max_entries * sizeof(fat16_dir_entry_t)) - (root_dir_sectors * boot_sector.bytes_per_sector));
-        return true;
+    struct dir_iter it;
+    int count = 0;
+    if (!dir_iter_start(&it, cluster)) {
+        return false;
     }
+    do {
+        int n = DIR_ENTRIES_PER_SECTOR;
+        if (n > max_entries - count) n = max_entries - count;
+        memcpy(entries + count, it.entries, n * sizeof(fat16_dir_entry_t));
+        count += n;
+    } while (count < max_entries && dir_iter_next(&it));
 
-    // Read directory clusters
-    int entry_count = 0;
-    uint32_t bytes_read = 0;
-    uint32_t bytes_per_cluster = boot_sector.sectors_per_cluster * boot_sector.bytes_per_sector;
-    
-    while (cluster != 0xFFFF && !fat16_is_end_of_chain(cluster)) {
-        uint32_t lba = fat16_cluster_to_lba(cluster);
-        
-        // Read the entire cluster
-        if (!iso_fs_read_sectors(lba, boot_sector.sectors_per_cluster, 
-                               (uint8_t*)entries + bytes_read)) {
-            return false;
-        }
-        
-        bytes_read += bytes_per_cluster;
-        entry_count += bytes_per_cluster / sizeof(fat16_dir_entry_t);
-        
-        if (entry_count >= max_entries) {
-            break;
-        }
-        
-        cluster = fat16_get_next_cluster(cluster);
-    }
-    
     // Clear any remaining entries
-    if (entry_count < max_entries) {
-        memset((uint8_t*)entries + bytes_read, 0, 
-               (max_entries - entry_count) * sizeof(fat16_dir_entry_t));
-    }
-    
+    memset(entries + count, 0, (max_entries - count) * sizeof(fat16_dir_entry_t));
     return true;
 }
 
@@ -904,75 +1760,72 @@ bool fat16_change_directory(const char* path, uint16_t* current_cluster) {
         return true;
     }
 
-    // Handle parent directory
-    if (strcmp(path, "..") == 0) {
-        if (*current_cluster == 0) {
-            // Already at root, can't go up
-            return false;
-        }
-
-        // Read current directory to find .. entry
-        fat16_dir_entry_t* dir_entries = (fat16_dir_entry_t*)malloc(root_dir_sectors * boot_sector.bytes_per_sector);
-        if (!dir_entries) return false;
-
-        bool success = false;
-        if (fat16_read_directory(*current_cluster, dir_entries, boot_sector.root_entries)) {
-            // Find the .. entry
-            for (int i = 0; i < boot_sector.root_entries; i++) {
-                if (dir_entries[i].filename[0] == 0x00) break;
-                if (dir_entries[i].filename[0] == 0xE5) continue;
-                if ((dir_entries[i].attributes & FAT16_ATTR_LONG_NAME) == FAT16_ATTR_LONG_NAME) continue;
-                if (dir_entries[i].attributes & FAT16_ATTR_VOLUME_ID) continue;
-
-                // Check if this is the .. entry
-                if (dir_entries[i].filename[0] == '.' && 
-                    dir_entries[i].filename[1] == '.' && 
-                    dir_entries[i].filename[2] == ' ' &&
-                    (dir_entries[i].attributes & FAT16_ATTR_DIRECTORY)) {
-                    *current_cluster = dir_entries[i].starting_cluster;
-                    success = true;
-                    break;
-                }
+    uint16_t base = *current_cluster;
+    if (path[0] == '/') {
+        base = 0;  // Start from root
+        path++;
+    }
+
+    // Normalize to upper case components without "." and empty parts,
+    // remembering where each one ends
+    char norm[256];
+    int ends[64];
+    int count = 0;
+    size_t len = 0;
+    while (*path) {
+        const char* end = strchr(path, '/');
+        size_t n = end ? (size_t)(end - path) : (size_t)strlen(path);
+        if (n > 0 && !(n == 1 && path[0] == '.')) {
+            if (count == 64 || len + n + 1 >= sizeof(norm)) return false;
+            if (count) norm[len++] = '/';
+            for (size_t i = 0; i < n; i++) {
+                norm[len++] = toupper(path[i]);
             }
+            ends[count++] = len;
+        }
+        path += end ? n + 1 : n;
+    }
+    norm[len] = '\0';
+
+    // Start after the longest cached prefix
+    uint16_t cluster = base;
+    int first = 0;
+    for (int k = count; k >= 2; k--) {
+        char saved = norm[ends[k - 1]];
+        norm[ends[k - 1]] = '\0';
+        bool hit = path_cache_find(base, norm, &cluster);
+        norm[ends[k - 1]] = saved;
+        if (hit) {
+            first = k;
+            break;
         }
-
-        free(dir_entries);
-        return success;
-    }
-
-    // Handle nested paths
-    char path_copy[256];
-    strncpy(path_copy, path, sizeof(path_copy) - 1);
-    path_copy[sizeof(path_copy) - 1] = '\0';
-
-    // Remove leading slash if present
-    if (path_copy[0] == '/') {
-        *current_cluster = 0;  // Start from root
-        memmove(path_copy, path_copy + 1, strlen(path_copy));
     }
 
-    // Split path into components and traverse each
-    char* component = custom_strtok(path_copy, "/");
-    while (component) {
-        fat16_dir_entry_t* dir_entries = (fat16_dir_entry_t*)malloc(root_dir_sectors * boot_sector.bytes_per_sector);
-        if (!dir_entries) return false;
+    // Walk the rest, caching each new prefix
+    for (int k = first; k < count; k++) {
+        int start = k ? ends[k - 1] + 1 : 0;
+        char component[FAT16_MAX_NAME + 1];
+        int n = ends[k] - start;
+        if (n > FAT16_MAX_NAME) return false;
+        memcpy(component, norm + start, n);
+        component[n] = '\0';
 
-        bool success = false;
-        if (fat16_read_directory(*current_cluster, dir_entries, boot_sector.root_entries)) {
-            // Find the directory entry
-            fat16_dir_entry_t* entry = find_directory_entry(dir_entries, boot_sector.root_entries, component);
-            if (entry && (entry->attributes & FAT16_ATTR_DIRECTORY)) {
-                *current_cluster = entry->starting_cluster;
-                success = true;
-            }
+        // The root directory has no ".." entry
+        fat16_dir_entry_t entry;
+        if (!lookup_entry(cluster, component, &entry) || !(entry.attributes & FAT16_ATTR_DIRECTORY)) {
+            return false;
         }
+        cluster = entry.starting_cluster;
 
-        free(dir_entries);
-        if (!success) return false;
-
-        component = custom_strtok(NULL, "/");
+        if (k >= 1) {
+            char saved = norm[ends[k]];
+            norm[ends[k]] = '\0';
+            path_cache_insert(base, norm, cluster);
+            norm[ends[k]] = saved;
+        }
     }
 
+    *current_cluster = cluster;
     return true;
 }
 
@@ -1001,45 +1854,29 @@ int fat16_open_file(const char* filename, struct fat16_file* file) {
         return 0;
     }
 
-    terminal_writestring("FAT16: Opening file ");
-    terminal_writestring(filename);
-    terminal_writestring("\n");
-
-    // Read current directory
-    fat16_dir_entry_t* dir_entries = (fat16_dir_entry_t*)malloc(root_dir_sectors * boot_sector.bytes_per_sector);
-    if (!dir_entries) {
-        terminal_writestring("FAT16: Failed to allocate memory for directory entries\n");
-        return 0;
-    }
+    // Safe to close even if the open fails
+    file->runs = NULL;
+    file->run_count = 0;
+    file->run_capacity = 0;
 
-    // Read directory contents
-    if (!fat16_read_directory(current_cluster, dir_entries, boot_sector.root_entries)) {
-        terminal_writestring("FAT16: Failed to read directory\n");
-        free(dir_entries);
+    fat16_dir_entry_t file_entry;
+    if (!find_file_at(filename, &file_entry, &file->dir_cluster, &file->dir_index)) {
         return 0;
     }
-
-    // Find file in directory
-    fat16_dir_entry_t* file_entry = find_directory_entry(dir_entries, boot_sector.root_entries, filename);
-    if (!file_entry) {
-        terminal_writestring("FAT16: File not found\n");
-        free(dir_entries);
+    if (file_entry.attributes & FAT16_ATTR_DIRECTORY) {
         return 0;
     }
 
-    terminal_writestring("FAT16: File found, size: ");
-    char size_str[32];
-    sprintf(size_str, "%d bytes\n", file_entry->file_size);
-    terminal_writestring(size_str);
-
     // Initialize file structure
-    file->starting_cluster = file_entry->starting_cluster;
-    file->size = file_entry->file_size;
+    file->starting_cluster = file_entry.starting_cluster;
+    file->size = file_entry.file_size;
     file->position = 0;
     file->current_cluster = file->starting_cluster;
     file->cluster_offset = 0;
+    file->cluster_index = 0;
+    file->readahead_index = 0;
+    file->mapped_clusters = 0;
 
-    free(dir_entries);
     return 1;
 }
 
@@ -1051,6 +1888,260 @@ void fat16_close_file(struct fat16_file* file) {
         file->position = 0;
         file->current_cluster = 0;
         file->cluster_offset = 0;
+        file->cluster_index = 0;
+        file->readahead_index = 0;
+        free(file->runs);
+        file->runs = NULL;
+        file->run_count = 0;
+        file->run_capacity = 0;
+        file->mapped_clusters = 0;
+    }
+}
+
+// Record that cluster 'index' of the file is 'cluster'. Only the next
+// unmapped index is recorded; if the run list can't grow, later lookups
+// past it walk the chain instead.
+static void file_map_cluster(struct fat16_file* file, uint32_t index, uint16_t cluster) {
+    if (index != file->mapped_clusters) return;
+
+    struct fat16_run* last = file->run_count ? &file->runs[file->run_count - 1] : NULL;
+    if (last && last->cluster + last->length == cluster) {
+        last->length++;
+    } else {
+        if (file->run_count == file->run_capacity) {
+            uint32_t capacity = file->run_capacity ? file->run_capacity * 2 : 4;
+            struct fat16_run* runs = (struct fat16_run*)realloc(file->runs, capacity * sizeof(struct fat16_run));
+            if (!runs) return;
+            file->runs = runs;
+            file->run_capacity = capacity;
+        }
+        file->runs[file->run_count].index = index;
+        file->runs[file->run_count].cluster = cluster;
+        file->runs[file->run_count].length = 1;
+        file->run_count++;
+    }
+    file->mapped_clusters++;
+}
+
+// Move the cached cluster to the one holding file->position. Clusters
+// already seen are found by binary search over the file's runs; beyond
+// them the chain is walked and mapped on the way. Returns false if the
+// chain ends first, leaving the handle on the last cluster.
+static bool file_locate(struct fat16_file* file) {
+    uint32_t cluster_size = boot_sector.sectors_per_cluster * boot_sector.bytes_per_sector;
+    uint32_t target = file->position / cluster_size;
+    file->cluster_offset = file->position % cluster_size;
+
+    if (file->current_cluster >= 2 && file->cluster_index == target) {
+        return true;
+    }
+
+    if (target < file->mapped_clusters) {
+        uint32_t lo = 0, hi = file->run_count - 1;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi + 1) / 2;
+            if (file->runs[mid].index <= target) lo = mid;
+            else hi = mid - 1;
+        }
+        file->current_cluster = file->runs[lo].cluster + (target - file->runs[lo].index);
+        file->cluster_index = target;
+        return true;
+    }
+
+    uint32_t index = file->mapped_clusters;
+    uint16_t prev = 0;
+    uint16_t cluster = file->starting_cluster;
+    if (index > 0) {
+        struct fat16_run* last = &file->runs[file->run_count - 1];
+        prev = last->cluster + last->length - 1;
+        cluster = fat16_get_next_cluster(prev);
+    }
+    while (cluster >= 2 && !fat16_is_end_of_chain(cluster)) {
+        file_map_cluster(file, index, cluster);
+        if (index == target) {
+            file->current_cluster = cluster;
+            file->cluster_index = index;
+            return true;
+        }
+        prev = cluster;
+        cluster = fat16_get_next_cluster(cluster);
+        index++;
+    }
+
+    file->current_cluster = prev;
+    file->cluster_index = index ? index - 1 : 0;
+    return false;
+}
+
+// Pull the next FAT16_READAHEAD clusters into the buffer cache once a
+// sequential reader reaches the end of the previous window
+static void file_readahead(struct fat16_file* file) {
+    if (file->cluster_index < file->readahead_index) return;
+
+    uint32_t cluster_size = boot_sector.sectors_per_cluster * boot_sector.bytes_per_sector;
+    uint32_t last_index = (file->size - 1) / cluster_size;
+    uint16_t cluster = file->current_cluster;
+    uint32_t index = file->cluster_index;
+    while (index <= last_index && index < file->cluster_index + FAT16_READAHEAD) {
+        if (cluster < 2 || fat16_is_end_of_chain(cluster)) break;
+
+        // One call per contiguous run
+        uint16_t first = cluster;
+        uint32_t run = 1;
+        uint16_t next = fat16_get_next_cluster(cluster);
+        while (index + run <= last_index && index + run < file->cluster_index + FAT16_READAHEAD &&
+               next == cluster + 1) {
+            cluster = next;
+            run++;
+            next = fat16_get_next_cluster(cluster);
+        }
+        bcache_prefetch(fat16_cluster_to_lba(first), run * boot_sector.sectors_per_cluster);
+        index += run;
+        cluster = next;
+    }
+    file->readahead_index = index;
+}
+
+// Number of consecutive clusters, at most 'max', starting at the
+// handle's current one
+static uint32_t file_contiguous(struct fat16_file* file, uint32_t max) {
+    uint16_t cluster = file->current_cluster;
+    uint32_t run = 1;
+    while (run < max && fat16_get_next_cluster(cluster) == cluster + 1) {
+        cluster++;
+        run++;
+    }
+    return run;
+}
+
+int fat16_read(struct fat16_file* file, void* buffer, uint32_t size) {
+    if (!file || !buffer) return -1;
+    if (file->position >= file->size) return 0;
+    if (size > file->size - file->position) {
+        size = file->size - file->position;
+    }
+
+    uint32_t cluster_size = boot_sector.sectors_per_cluster * boot_sector.bytes_per_sector;
+    uint8_t* out = (uint8_t*)buffer;
+    uint32_t done = 0;
+    while (done < size) {
+        if (!file_locate(file)) break;
+
+        // Whole clusters bypass the cache, one read per contiguous run
+        if (file->cluster_offset == 0 && size - done >= cluster_size) {
+            uint32_t run = file_contiguous(file, (size - done) / cluster_size);
+            if (!bcache_read_direct(fat16_cluster_to_lba(file->current_cluster),
+                                    run * boot_sector.sectors_per_cluster, out + done)) {
+                break;
+            }
+            done += run * cluster_size;
+            file->position += run * cluster_size;
+            continue;
+        }
+        file_readahead(file);
+
+        uint32_t n = cluster_size - file->cluster_offset;
+        if (n > size - done) n = size - done;
+
+        struct bcache_buf* buf = bcache_get(fat16_cluster_to_lba(file->current_cluster));
+        if (!buf) break;
+        memcpy(out + done, buf->data + file->cluster_offset, n);
+        bcache_release(buf);
+
+        done += n;
+        file->position += n;
+    }
+    return done ? (int)done : (done == size ? 0 : -1);
+}
+
+int fat16_seek(struct fat16_file* file, int32_t offset, int whence) {
+    if (!file) return -1;
+
+    int32_t base;
+    switch (whence) {
+        case FAT16_SEEK_SET: base = 0; break;
+        case FAT16_SEEK_CUR: base = (int32_t)file->position; break;
+        case FAT16_SEEK_END: base = (int32_t)file->size; break;
+        default: return -1;
+    }
+
+    // Files don't have holes, so the position stays inside the file
+    int32_t position = base + offset;
+    if (position < 0 || (uint32_t)position > file->size) {
+        return -1;
+    }
+    file->position = position;
+    return position;
+}
+
+// Rewrite one directory entry after a handle changed the file's size or
+// first cluster
+static bool update_entry(struct fat16_file* file) {
+    uint32_t lba, offset;
+    uint8_t sector[512];
+    if (!dir_entry_lba(file->dir_cluster, file->dir_index, &lba, &offset) || !bcache_read(lba, 1, sector)) {
+        return false;
+    }
+    fat16_dir_entry_t* entry = (fat16_dir_entry_t*)(sector + offset);
+    entry->starting_cluster = file->starting_cluster;
+    entry->file_size = file->size;
+    if (!bcache_write(lba, 1, sector)) return false;
+    name_index_drop(file->dir_cluster);
+    dentry_invalidate(file->dir_cluster, file->dir_index);
+    return true;
+}
+
+int fat16_write(struct fat16_file* file, const void* buffer, uint32_t size) {
+    if (!file || !buffer) return -1;
+    if (size == 0) return 0;
+
+    uint32_t cluster_size = boot_sector.sectors_per_cluster * boot_sector.bytes_per_sector;
+    uint16_t old_start = file->starting_cluster;
+    uint32_t old_size = file->size;
+    const uint8_t* in = (const uint8_t*)buffer;
+    uint32_t done = 0;
+
+    while (done < size) {
+        if (!file_locate(file)) {
+            // Past the end of the chain: allocate the rest in one go so it
+            // comes out contiguous where possible
+            uint32_t missing = (file->position + (size - done) + cluster_size - 1) / cluster_size
+                             - (file->starting_cluster ? file->cluster_index + 1 : 0);
+            uint16_t first = fat_alloc_chain(missing);
+            if (first == 0) break;
+            if (file->starting_cluster == 0) {
+                file->starting_cluster = first;
+            } else {
+                fat_set(file->current_cluster, first);
+            }
+            if (!file_locate(file)) break;
+        }
+
+        uint32_t n = cluster_size - file->cluster_offset;
+        if (n > size - done) n = size - done;
+
+        uint32_t lba = fat16_cluster_to_lba(file->current_cluster);
+        if (n == cluster_size) {
+            if (!bcache_write(lba, boot_sector.sectors_per_cluster, in + done)) break;
+        } else {
+            struct bcache_buf* buf = bcache_get(lba);
+            if (!buf) break;
+            memcpy(buf->data + file->cluster_offset, in + done, n);
+            bcache_mark_dirty(buf);
+            bcache_release(buf);
+        }
+
+        done += n;
+        file->position += n;
+        if (file->position > file->size) {
+            file->size = file->position;
+        }
     }
-} 
 
+    if (file->starting_cluster != old_start || file->size != old_size) {
+        if (!fat_flush() || !update_entry(file)) {
+            return -1;
+        }
+    }
+    return done ? (int)done : -1;
+}
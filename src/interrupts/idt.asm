@@ -9,6 +9,9 @@ idt_load:
 ; Interrupt handlers
 global irq0
 global irq1
+global irq14
+global irq15
+global isr14
 ; ... add more as needed
 
 ; Timer interrupt handler
@@ -80,4 +83,75 @@ irq1:
     pop ds
     popa                   ; Restore all registers
     iret                   ; Return from interrupt (sti will be done by iret)
-   
+
+; IDE channel interrupt handlers (IRQ14 primary, IRQ15 secondary)
+%macro IDE_IRQ 2
+%1:
+    cli                     ; Disable interrupts
+    pusha                   ; Save all registers
+    push ds                 ; Save segment registers
+    push es
+    push fs
+    push gs
+    
+    mov ax, 0x10           ; Load kernel data segment
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    
+    push dword %2           ; Channel number
+    
+    extern ide_irq_handler
+    call ide_irq_handler    ; Call C handler
+    
+    add esp, 4
+    
+    ; Send EOI to PIC2, then PIC1
+    mov al, 0x20
+    out 0xA0, al
+    out 0x20, al
+    
+    pop gs                  ; Restore segment registers
+    pop fs
+    pop es
+    pop ds
+    popa                   ; Restore all registers
+    iret
+%endmacro
+
+IDE_IRQ irq14, 0
+IDE_IRQ irq15, 1
+
+; Page fault handler (the CPU pushes an error code)
+isr14:
+    pusha                   ; Save all registers
+    push ds                 ; Save segment registers
+    push es
+    push fs
+    push gs
+    
+    mov ax, 0x10           ; Load kernel data segment
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    
+    mov eax, [esp + 52]    ; Faulting EIP
+    push eax
+    mov eax, [esp + 52]    ; Error code
+    push eax
+    mov eax, cr2           ; Faulting address
+    push eax
+    
+    extern page_fault_handler
+    call page_fault_handler ; Call C handler
+    add esp, 12
+    
+    pop gs                  ; Restore segment registers
+    pop fs
+    pop es
+    pop ds
+    popa                   ; Restore all registers
+    add esp, 4             ; Drop the error code
+    iret
@@ -18,6 +18,9 @@ struct idt_pointer idt_ptr;
 
 extern void irq0();
 extern void irq1();
+extern void irq14();
+extern void irq15();
+extern void isr14();
 extern void idt_load(void);
 extern void timer_handler(struct regs *r);
 extern void syscall_entry(void);
@@ -82,12 +85,19 @@ void idt_init() {
     outb(0x21, 0xFC);  // Enable IRQ0 (timer) and IRQ1 (keyboard)
     outb(0xA1, 0xFF);  // Disable all IRQs on slave PIC
     
+    // Set up page fault handler
+    idt_set_gate(14, (uint32_t)isr14, 0x08, 0x8E);
+
     // Set up timer interrupt
     idt_set_gate(0x20, (uint32_t)irq0, 0x08, 0x8E);
 
     // Set up keyboard interrupt
     idt_set_gate(0x21, (uint32_t)irq1, 0x08, 0x8E);
 
+    // Set up IDE interrupts, unmasked once the driver is ready for them
+    idt_set_gate(0x2E, (uint32_t)irq14, 0x08, 0x8E);
+    idt_set_gate(0x2F, (uint32_t)irq15, 0x08, 0x8E);
+
     // Set up syscall handler
     idt_set_gate(0x80, (uint32_t)syscall_entry, 0x08, 0xEE);
     
@@ -41,4 +41,76 @@ void io_wait(void)
     /* Port 0x80 is used for 'checkpoints' during POST. */
     /* The Linux kernel seems to think it is free for use :-/ */
     outb(0x80, 0);
-} 
\ No newline at end of file
+} 
+
+void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx)
+{
+    asm volatile ("cpuid"
+                  : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                  : "a"(leaf), "c"(0));
+}
+
+uint32_t read_cr0(void)
+{
+    uint32_t value;
+    asm volatile ("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+void write_cr0(uint32_t value)
+{
+    asm volatile ("mov %0, %%cr0" : : "r"(value) : "memory");
+}
+
+uint32_t read_cr2(void)
+{
+    uint32_t value;
+    asm volatile ("mov %%cr2, %0" : "=r"(value));
+    return value;
+}
+
+uint32_t read_cr3(void)
+{
+    uint32_t value;
+    asm volatile ("mov %%cr3, %0" : "=r"(value));
+    return value;
+}
+
+void write_cr3(uint32_t value)
+{
+    asm volatile ("mov %0, %%cr3" : : "r"(value) : "memory");
+}
+
+uint32_t read_cr4(void)
+{
+    uint32_t value;
+    asm volatile ("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+void write_cr4(uint32_t value)
+{
+    asm volatile ("mov %0, %%cr4" : : "r"(value) : "memory");
+}
+
+void invlpg(void* addr)
+{
+    asm volatile ("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+uint64_t rdmsr(uint32_t msr)
+{
+    uint32_t low, high;
+    asm volatile ("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+    return ((uint64_t)high << 32) | low;
+}
+
+void wrmsr(uint32_t msr, uint64_t value)
+{
+    asm volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+void wbinvd(void)
+{
+    asm volatile ("wbinvd" : : : "memory");
+}
@@ -1,5 +1,6 @@
 #include "../include/keyboardDriver.h"
 #include "../include/io.h"
+#include "../include/string.h"
 #include "../include/idt.h"
 #include "../include/gdt.h"
 #include "../include/shell.h"
@@ -7,6 +8,7 @@
 #include "../include/memory/pmm.h"
 #include "../include/memory/memory_map.h"
 #include "../include/memory/heap.h"
+#include "../include/memory/vmm.h"
 #include "../include/version.h"
 #include "../include/fs/fat16.h"
 #include "../include/drivers/iso_fs.h"
@@ -39,6 +41,9 @@ void delay_animation(int dots, int start_x, int y) {
 }
 
 void kernel_main(uint32_t multiboot_magic, void* multiboot_info) {
+	// Pick memcpy/memset strategies before anything copies memory
+	string_init();
+
 	// Initialize VBE first (with fallback to text mode)
 	vbe_init(multiboot_magic, multiboot_info);
 	
@@ -61,7 +66,7 @@ void kernel_main(uint32_t multiboot_magic, void* multiboot_info) {
 	terminal_writestring("Performing Power-On Self Test\n");
 	// Move cursor below header
 	vbe_cursor_x = 0;
-	vbe_cursor_y = 30; // 5 lines * 16px + a blank line
+	vbe_cursor_y = 32; // Console row 2
 	
 	// Memory Test
 	terminal_writestring("Memory Test: ");
@@ -94,8 +99,11 @@ void kernel_main(uint32_t multiboot_magic, void* multiboot_info) {
 	terminal_writestring("Memory Manager: ");
 	delay_animation(1, 155, 180);
 	memory_map_init(multiboot_magic, multiboot_info);
-	pmm_init();
+	pmm_init(multiboot_info);
 	heap_init();
+	vmm_init();
+	vbe_enable_write_combining();
+	vbe_init_back_buffer();
 	terminal_writestring_color("OK\n", 0x00FF00);
 	
 	// Get module information from multiboot structure
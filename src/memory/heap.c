@@ -2,35 +2,360 @@
 #include "../../include/memory/pmm.h"
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 
-// Simple heap implementation using physical memory pages
-#define HEAP_START 0x2000000  // Start at 32MB
-#define HEAP_SIZE 0x1000000   // 16MB heap size
+// Size-class slab allocator on top of a fixed page window.
+// Small requests (16 B - 2 KiB) are served from per-class slabs, larger ones
+// take whole pages, from the PMM once the window has no room for them.
+// Everything is returned where it came from on free.
+#define HEAP_PAGES (HEAP_SIZE / PAGE_SIZE)
 
-static uint32_t heap_ptr = HEAP_START;
+// Power-of-two size classes from 16 bytes (2^4) to 2 KiB (2^11)
+#define HEAP_MIN_SHIFT 4
+#define HEAP_MAX_SHIFT 11
+#define HEAP_NUM_CLASSES (HEAP_MAX_SHIFT - HEAP_MIN_SHIFT + 1)
+#define HEAP_MAX_SMALL (1 << HEAP_MAX_SHIFT)
+
+// Large allocations taken straight from the PMM once the window is full
+#define HEAP_FALLBACK_RUNS 64
+
+// Page descriptor types
+#define HEAP_PAGE_FREE  0   // Page is unused
+#define HEAP_PAGE_SLAB  1   // Page holds objects of one size class
+#define HEAP_PAGE_LARGE 2   // First page of a large allocation
+#define HEAP_PAGE_TAIL  3   // Continuation page of a large allocation
+
+// One descriptor per page in the heap window
+struct heap_page {
+    void* free_list;          // Free objects in this slab
+    struct heap_page* next;   // Next slab of the same class with free objects
+    struct heap_page* prev;   // Previous slab of the same class with free objects
+    uint16_t in_use;          // Live objects in this slab
+    uint8_t class_idx;        // Size class of this slab
+    uint8_t type;             // HEAP_PAGE_* type
+    uint32_t pages;           // Page count of a large allocation
+};
+
+static struct heap_page heap_pages[HEAP_PAGES];
+
+// Slabs that still have free objects, per size class
+static struct heap_page* partial_slabs[HEAP_NUM_CLASSES];
+
+// Next-fit cursor for page runs
+static size_t page_cursor = 0;
+
+// PMM page runs handed out by large_alloc, so kfree only returns those
+struct fallback_run {
+    void* base;
+    size_t pages;
+};
+static struct fallback_run fallback_runs[HEAP_FALLBACK_RUNS];
+
+static struct heap_stats stats;
+
+// Page index <-> address helpers
+static inline void* page_address(size_t index) {
+    return (void*)(HEAP_START + index * PAGE_SIZE);
+}
+
+static inline bool in_heap_window(uint32_t addr) {
+    return addr >= HEAP_START && addr < HEAP_START + HEAP_SIZE;
+}
+
+// Map a request size to its size class
+static inline int size_to_class(size_t size) {
+    if (size <= (1 << HEAP_MIN_SHIFT)) {
+        return 0;
+    }
+    return (32 - __builtin_clz((uint32_t)(size - 1))) - HEAP_MIN_SHIFT;
+}
+
+static inline size_t class_size(int class_idx) {
+    return (size_t)1 << (class_idx + HEAP_MIN_SHIFT);
+}
+
+// Find and claim a run of free pages (next-fit)
+static long page_run_alloc(size_t count) {
+    if (count == 0 || count > HEAP_PAGES - stats.pages_used) {
+        return -1;
+    }
+
+    size_t start = page_cursor;
+    size_t scanned = 0;
+    while (scanned < HEAP_PAGES) {
+        if (start + count > HEAP_PAGES) {
+            // Run cannot fit before the end of the window, wrap around
+            scanned += HEAP_PAGES - start;
+            start = 0;
+            continue;
+        }
+
+        size_t run = 0;
+        while (run < count && heap_pages[start + run].type == HEAP_PAGE_FREE) {
+            run++;
+        }
+        if (run == count) {
+            for (size_t i = 0; i < count; i++) {
+                heap_pages[start + i].type = HEAP_PAGE_TAIL;
+            }
+            page_cursor = (start + count) % HEAP_PAGES;
+            stats.pages_used += count;
+            return (long)start;
+        }
+
+        // Skip past the page that broke the run
+        scanned += run + 1;
+        start += run + 1;
+        if (start >= HEAP_PAGES) {
+            start = 0;
+        }
+    }
+    return -1;
+}
+
+// Return a run of pages to the window
+static void page_run_free(size_t index, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        memset(&heap_pages[index + i], 0, sizeof(struct heap_page));
+    }
+    stats.pages_used -= count;
+}
+
+// Unlink a slab from its class's partial list
+static void slab_unlink(struct heap_page* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        partial_slabs[slab->class_idx] = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->next = NULL;
+    slab->prev = NULL;
+}
+
+// Push a slab to the front of its class's partial list
+static void slab_link(struct heap_page* slab) {
+    slab->prev = NULL;
+    slab->next = partial_slabs[slab->class_idx];
+    if (slab->next) {
+        slab->next->prev = slab;
+    }
+    partial_slabs[slab->class_idx] = slab;
+}
+
+// Carve a fresh page into objects of the given class
+static struct heap_page* slab_create(int class_idx) {
+    long index = page_run_alloc(1);
+    if (index < 0) {
+        return NULL;
+    }
+
+    struct heap_page* slab = &heap_pages[index];
+    size_t size = class_size(class_idx);
+    size_t count = PAGE_SIZE / size;
+    uint8_t* base = (uint8_t*)page_address(index);
+
+    // Thread the free list through the objects in address order
+    for (size_t i = 0; i < count - 1; i++) {
+        *(void**)(base + i * size) = base + (i + 1) * size;
+    }
+    *(void**)(base + (count - 1) * size) = NULL;
+
+    slab->type = HEAP_PAGE_SLAB;
+    slab->class_idx = class_idx;
+    slab->in_use = 0;
+    slab->free_list = base;
+    slab->pages = 1;
+    slab_link(slab);
+    return slab;
+}
+
+static void* slab_alloc(int class_idx) {
+    struct heap_page* slab = partial_slabs[class_idx];
+    if (!slab) {
+        slab = slab_create(class_idx);
+        if (!slab) {
+            return NULL;
+        }
+    }
+
+    void* obj = slab->free_list;
+    slab->free_list = *(void**)obj;
+    slab->in_use++;
+
+    // Full slabs leave the partial list until an object is freed
+    if (!slab->free_list) {
+        slab_unlink(slab);
+    }
+
+    stats.bytes_in_use += class_size(class_idx);
+    stats.allocations++;
+    return obj;
+}
+
+static void slab_free(struct heap_page* slab, size_t index, void* ptr) {
+    bool was_full = (slab->free_list == NULL);
+
+    *(void**)ptr = slab->free_list;
+    slab->free_list = ptr;
+    slab->in_use--;
+    stats.bytes_in_use -= class_size(slab->class_idx);
+    stats.frees++;
+
+    if (was_full) {
+        slab_link(slab);
+    }
+
+    // Give empty slabs back to the window, but keep the last one per class
+    // so alloc/free churn on a single object does not thrash pages
+    if (slab->in_use == 0 && (slab->prev || slab->next)) {
+        slab_unlink(slab);
+        page_run_free(index, 1);
+    }
+}
+
+static int fallback_index(void* ptr) {
+    for (int i = 0; i < HEAP_FALLBACK_RUNS; i++) {
+        if (fallback_runs[i].base == ptr) return i;
+    }
+    return -1;
+}
+
+static void* large_alloc(size_t size) {
+    size_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    long index = page_run_alloc(pages);
+    if (index < 0) {
+        // Window exhausted or fragmented: take the run from the PMM
+        for (int i = 0; i < HEAP_FALLBACK_RUNS; i++) {
+            if (fallback_runs[i].base) continue;
+            void* base = pmm_alloc_pages(pages, PAGE_SIZE);
+            if (base) {
+                fallback_runs[i].base = base;
+                fallback_runs[i].pages = pages;
+                stats.bytes_in_use += pages * PAGE_SIZE;
+                stats.allocations++;
+            }
+            return base;
+        }
+        return NULL;
+    }
+
+    heap_pages[index].type = HEAP_PAGE_LARGE;
+    heap_pages[index].pages = pages;
+    stats.bytes_in_use += pages * PAGE_SIZE;
+    stats.allocations++;
+    return page_address(index);
+}
 
 void heap_init(void) {
-    heap_ptr = HEAP_START;
+    memset(heap_pages, 0, sizeof(heap_pages));
+    memset(partial_slabs, 0, sizeof(partial_slabs));
+    memset(&stats, 0, sizeof(stats));
+    memset(fallback_runs, 0, sizeof(fallback_runs));
+    stats.pages_total = HEAP_PAGES;
+    page_cursor = 0;
 }
 
 void* kmalloc(size_t size) {
-    // Round up to nearest page size
-    size_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
-    
-    // Allocate pages
-    void* ptr = heap_ptr;
-    heap_ptr += pages * PAGE_SIZE;
-    
-    // Check if we've exceeded heap size
-    if (heap_ptr > HEAP_START + HEAP_SIZE) {
-        return NULL;  // Out of memory
-    }
-    
-    return ptr;
+    if (size == 0) {
+        return NULL;
+    }
+    if (size <= HEAP_MAX_SMALL) {
+        return slab_alloc(size_to_class(size));
+    }
+    return large_alloc(size);
 }
 
 void kfree(void* ptr) {
-    // In this simple implementation, we don't actually free memory
-    // The heap just grows and never shrinks
-    (void)ptr;  // Silence unused parameter warning
-} 
\ No newline at end of file
+    if (!ptr) return;
+
+    uint32_t addr = (uint32_t)ptr;
+    if (!in_heap_window(addr)) {
+        // Only recorded fallback runs go back to the PMM; any other
+        // pointer outside the window is a stray free
+        int i = fallback_index(ptr);
+        if (i >= 0) {
+            pmm_free_pages(ptr, fallback_runs[i].pages);
+            stats.bytes_in_use -= fallback_runs[i].pages * PAGE_SIZE;
+            stats.frees++;
+            fallback_runs[i].base = NULL;
+        }
+        return;
+    }
+
+    size_t index = (addr - HEAP_START) / PAGE_SIZE;
+    struct heap_page* page = &heap_pages[index];
+
+    if (page->type == HEAP_PAGE_SLAB) {
+        slab_free(page, index, ptr);
+    } else if (page->type == HEAP_PAGE_LARGE && addr == (uint32_t)page_address(index)) {
+        stats.bytes_in_use -= page->pages * PAGE_SIZE;
+        stats.frees++;
+        page_run_free(index, page->pages);
+    }
+    // Anything else is a stray or double free; ignore it
+}
+
+// Usable size of an allocation
+size_t kmalloc_usable_size(void* ptr) {
+    if (!ptr) return 0;
+
+    uint32_t addr = (uint32_t)ptr;
+    if (!in_heap_window(addr)) {
+        int i = fallback_index(ptr);
+        return i >= 0 ? fallback_runs[i].pages * PAGE_SIZE : 0;
+    }
+
+    struct heap_page* page = &heap_pages[(addr - HEAP_START) / PAGE_SIZE];
+    if (page->type == HEAP_PAGE_SLAB) {
+        return class_size(page->class_idx);
+    }
+    if (page->type == HEAP_PAGE_LARGE) {
+        return page->pages * PAGE_SIZE;
+    }
+    return 0;
+}
+
+void* krealloc(void* ptr, size_t size) {
+    if (!ptr) {
+        return kmalloc(size);
+    }
+    if (size == 0) {
+        kfree(ptr);
+        return NULL;
+    }
+
+    // Stay in place if the block still fits and would not land in a smaller class
+    size_t old_size = kmalloc_usable_size(ptr);
+    if (size <= old_size && (old_size <= HEAP_MAX_SMALL ? size > old_size / 2 : size > HEAP_MAX_SMALL)) {
+        return ptr;
+    }
+
+    void* new_ptr = kmalloc(size);
+    if (!new_ptr) {
+        return NULL;
+    }
+    memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    kfree(ptr);
+    return new_ptr;
+}
+
+void* kcalloc(size_t count, size_t size) {
+    if (size != 0 && count > (size_t)-1 / size) {
+        return NULL;  // Overflow
+    }
+    void* ptr = kmalloc(count * size);
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void heap_get_stats(struct heap_stats* out) {
+    if (out) {
+        *out = stats;
+    }
+}
@@ -1,127 +1,500 @@
 #include "../../include/memory/pmm.h"
 #include "../../include/memory/memory_map.h"
+#include "../../include/memory/heap.h"
 #include "../../include/drivers/vbe.h"
+#include "../../include/multiboot.h"
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
 
-// Bitmap for tracking physical memory pages
+// Bitmap for tracking physical memory pages (1 = used)
 static uint32_t* bitmap = NULL;
 static size_t bitmap_size = 0;
-static size_t total_pages = 0;
+// Summary bitmap: one bit per bitmap word, set when all 32 pages in it are used
+static uint32_t* summary = NULL;
+static size_t summary_size = 0;
+static size_t total_pages = 0;   // Pages covered by the bitmap (up to the highest usable address)
+static size_t usable_pages = 0;  // Pages of available RAM according to the memory map
 static size_t free_pages = 0;
 static uint32_t last_allocated_page = 0;
+static bool pmm_ready = false;
+
+// Kernel image bounds from linker.ld
+extern uint8_t kernel_start[];
+extern uint8_t kernel_end[];
+
+// Multiboot module entry
+struct multiboot_module {
+    uint32_t mod_start;
+    uint32_t mod_end;
+    uint32_t string;
+    uint32_t reserved;
+};
+
+// Physical ranges that must stay untouched from boot onwards
+#define MAX_BOOT_RESERVED 16
+struct phys_range {
+    uint64_t start;
+    uint64_t end;
+};
+static struct phys_range boot_reserved[MAX_BOOT_RESERVED];
+static size_t boot_reserved_count = 0;
+
+// Count set bits in a word (no libgcc popcount in the kernel)
+static inline uint32_t popcount32(uint32_t x) {
+    x = x - ((x >> 1) & 0x55555555);
+    x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+    x = (x + (x >> 4)) & 0x0F0F0F0F;
+    return (x * 0x01010101) >> 24;
+}
+
+// Keep the summary bit of a bitmap word in sync with its contents
+static inline void summary_update(size_t word) {
+    if (bitmap[word] == 0xFFFFFFFF) {
+        summary[word / 32] |= (1u << (word % 32));
+    } else {
+        summary[word / 32] &= ~(1u << (word % 32));
+    }
+}
 
 // Set a bit in the bitmap
 static void bitmap_set(size_t bit) {
-    bitmap[bit / 32] |= (1 << (bit % 32));
+    bitmap[bit / 32] |= (1u << (bit % 32));
+    summary_update(bit / 32);
 }
 
-// Clear a bit in the bitmap
-static void bitmap_clear(size_t bit) {
-    bitmap[bit / 32] &= ~(1 << (bit % 32));
+// Mark a range of pages used or free a word at a time.
+// Returns the number of pages whose state changed.
+static size_t bitmap_fill_range(size_t start, size_t count, bool used) {
+    size_t changed = 0;
+    size_t bit = start;
+    size_t end = start + count;
+
+    while (bit < end) {
+        size_t word = bit / 32;
+        size_t offset = bit % 32;
+        size_t n = 32 - offset;
+        if (n > end - bit) {
+            n = end - bit;
+        }
+        uint32_t mask = (n == 32) ? 0xFFFFFFFF : (((1u << n) - 1) << offset);
+
+        uint32_t old = bitmap[word];
+        bitmap[word] = used ? (old | mask) : (old & ~mask);
+        changed += popcount32(old ^ bitmap[word]);
+        summary_update(word);
+        bit += n;
+    }
+    return changed;
 }
 
-// Test if a bit is set
-static int bitmap_test(size_t bit) {
-    return bitmap[bit / 32] & (1 << (bit % 32));
+// Find the first free page at or after 'bit'.
+// Full words are skipped 32 at a time through the summary bitmap.
+static size_t bitmap_find_free(size_t bit) {
+    if (bit >= total_pages) {
+        return (size_t)-1;
+    }
+
+    // Remainder of the starting word
+    size_t word = bit / 32;
+    uint32_t free_bits = ~bitmap[word] & (0xFFFFFFFFu << (bit % 32));
+    if (free_bits) {
+        return word * 32 + __builtin_ctz(free_bits);
+    }
+
+    word++;
+    while (word < bitmap_size) {
+        size_t sword = word / 32;
+        uint32_t not_full = ~summary[sword] & (0xFFFFFFFFu << (word % 32));
+        if (!not_full) {
+            word = (sword + 1) * 32;
+            continue;
+        }
+        word = sword * 32 + __builtin_ctz(not_full);
+        if (word >= bitmap_size) {
+            break;
+        }
+        return word * 32 + __builtin_ctz(~bitmap[word]);
+    }
+
+    return (size_t)-1; // No free pages
 }
 
-// Find the first free bit in the bitmap
-static size_t bitmap_first_free(void) {
-    // Start from the last allocated page to improve performance
-    size_t start_word = last_allocated_page / 32;
-    size_t start_bit = last_allocated_page % 32;
-    
-    // Search from last allocated page to end
-    for (size_t i = start_word; i < bitmap_size; i++) {
-        uint32_t word = bitmap[i];
-        if (word != 0xFFFFFFFF) {
-            for (size_t j = (i == start_word ? start_bit : 0); j < 32; j++) {
-                if (!(word & (1 << j))) {
-                    return i * 32 + j;
+// Find the first used page in [bit, limit), or 'limit' if the range is free
+static size_t bitmap_find_used(size_t bit, size_t limit) {
+    while (bit < limit) {
+        size_t word = bit / 32;
+        uint32_t used = bitmap[word] & (0xFFFFFFFFu << (bit % 32));
+        if (used) {
+            size_t found = word * 32 + __builtin_ctz(used);
+            return found < limit ? found : limit;
+        }
+        bit = (word + 1) * 32;
+    }
+    return limit;
+}
+
+#ifndef PMM_BUDDY
+// Find 'count' free pages starting at a multiple of 'align' (in pages)
+static size_t bitmap_find_run(size_t start, size_t count, size_t align) {
+    size_t bit = start;
+    while (true) {
+        bit = bitmap_find_free(bit);
+        if (bit == (size_t)-1) {
+            return (size_t)-1;
+        }
+        bit = (bit + align - 1) & ~(align - 1);
+        if (bit + count > total_pages) {
+            return (size_t)-1;
+        }
+        size_t used = bitmap_find_used(bit, bit + count);
+        if (used == bit + count) {
+            return bit;
+        }
+        // Restart just past the page that broke the run
+        bit = used + 1;
+    }
+}
+#endif
+
+// Largest block order that starts at 'start' and fits in 'count' pages
+static uint32_t block_order(size_t start, size_t count) {
+    uint32_t order = 0;
+    while (order < PMM_MAX_ORDER &&
+           (start & ((2u << order) - 1)) == 0 &&
+           (2u << order) <= count) {
+        order++;
+    }
+    return order;
+}
+
+#ifdef PMM_BUDDY
+// Buddy allocator: free blocks of 2^order pages on per-order lists.
+// Pages on the lists are clear in the bitmap, allocated pages are set.
+// List links live inside the free pages themselves.
+struct buddy_block {
+    struct buddy_block* next;
+    struct buddy_block* prev;
+};
+
+static struct buddy_block* free_area[PMM_MAX_ORDER + 1];
+static size_t free_area_count[PMM_MAX_ORDER + 1];
+// order + 1 for the first page of a free block, 0 for every other page
+static uint8_t* buddy_order = NULL;
+
+static inline struct buddy_block* page_block(size_t page) {
+    return (struct buddy_block*)(page * PAGE_SIZE);
+}
+
+static void buddy_push(size_t page, uint32_t order) {
+    struct buddy_block* block = page_block(page);
+    block->prev = NULL;
+    block->next = free_area[order];
+    if (block->next) {
+        block->next->prev = block;
+    }
+    free_area[order] = block;
+    free_area_count[order]++;
+    buddy_order[page] = order + 1;
+}
+
+static void buddy_unlink(size_t page, uint32_t order) {
+    struct buddy_block* block = page_block(page);
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        free_area[order] = block->next;
+    }
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+    free_area_count[order]--;
+    buddy_order[page] = 0;
+}
+
+// Return a block to the lists, merging with its buddy while possible
+static void buddy_free_block(size_t page, uint32_t order) {
+    while (order < PMM_MAX_ORDER) {
+        size_t buddy = page ^ ((size_t)1 << order);
+        if (buddy + ((size_t)1 << order) > total_pages || buddy_order[buddy] != order + 1) {
+            break;
+        }
+        buddy_unlink(buddy, order);
+        page &= ~((size_t)1 << order);
+        order++;
+    }
+    buddy_push(page, order);
+}
+
+// Take a block of exactly 2^order pages, splitting a larger one if needed
+static size_t buddy_alloc_block(uint32_t order) {
+    uint32_t found = order;
+    while (found <= PMM_MAX_ORDER && !free_area[found]) {
+        found++;
+    }
+    if (found > PMM_MAX_ORDER) {
+        return (size_t)-1;
+    }
+
+    size_t page = (size_t)free_area[found] / PAGE_SIZE;
+    buddy_unlink(page, found);
+
+    // Hand the upper halves back as smaller blocks
+    while (found > order) {
+        found--;
+        buddy_push(page + ((size_t)1 << found), found);
+    }
+    return page;
+}
+
+// Release an arbitrary page range as maximal aligned blocks
+static void buddy_release(size_t start, size_t count) {
+    while (count > 0) {
+        uint32_t order = block_order(start, count);
+        buddy_free_block(start, order);
+        start += (size_t)1 << order;
+        count -= (size_t)1 << order;
+    }
+}
+
+// Build the free lists from whatever the bitmap says is free
+static void buddy_init(void) {
+    memset(buddy_order, 0, total_pages);
+    memset(free_area, 0, sizeof(free_area));
+    memset(free_area_count, 0, sizeof(free_area_count));
+
+    size_t page = 0;
+    while ((page = bitmap_find_free(page)) != (size_t)-1) {
+        size_t end = bitmap_find_used(page, total_pages);
+        buddy_release(page, end - page);
+        page = end;
+    }
+}
+#endif
+
+#ifdef PMM_BUDDY
+// Pull a single free page out of whichever buddy block holds it
+static void buddy_take_page(size_t page) {
+    uint32_t order = 0;
+    size_t head = page;
+    while (order <= PMM_MAX_ORDER) {
+        head = page & ~(((size_t)1 << order) - 1);
+        if (buddy_order[head] == order + 1) {
+            break;
+        }
+        order++;
+    }
+    if (order > PMM_MAX_ORDER) {
+        return;
+    }
+
+    // Split the block down, keeping the half that does not hold the page
+    buddy_unlink(head, order);
+    while (order > 0) {
+        order--;
+        size_t half = (size_t)1 << order;
+        if (page < head + half) {
+            buddy_push(head + half, order);
+        } else {
+            buddy_push(head, order);
+            head += half;
+        }
+    }
+}
+#endif
+
+static void add_boot_reserved(uint64_t start, uint64_t end) {
+    if (end <= start || boot_reserved_count >= MAX_BOOT_RESERVED) {
+        return;
+    }
+    boot_reserved[boot_reserved_count].start = start;
+    boot_reserved[boot_reserved_count].end = end;
+    boot_reserved_count++;
+}
+
+// Collect everything the bootloader and kernel already occupy
+static void collect_boot_reserved(void* multiboot_info) {
+    boot_reserved_count = 0;
+
+    // Real-mode IVT, BDA, EBDA and BIOS ROMs
+    add_boot_reserved(0, 0x100000);
+    add_boot_reserved((uint32_t)kernel_start, (uint32_t)kernel_end);
+    add_boot_reserved(HEAP_START, HEAP_START + HEAP_SIZE);
+
+    struct multiboot_header* mb = (struct multiboot_header*)multiboot_info;
+    if (!mb) {
+        return;
+    }
+    add_boot_reserved((uint32_t)mb, (uint32_t)mb + sizeof(struct multiboot_header));
+
+    if (mb->flags & (1 << 3)) {  // Modules present
+        struct multiboot_module* mods = (struct multiboot_module*)mb->mods_addr;
+        add_boot_reserved(mb->mods_addr, mb->mods_addr + mb->mods_count * sizeof(struct multiboot_module));
+        for (uint32_t i = 0; i < mb->mods_count; i++) {
+            add_boot_reserved(mods[i].mod_start, mods[i].mod_end);
+        }
+    }
+}
+
+// Find room for the allocator metadata in available RAM, clear of boot ranges
+static uint64_t find_metadata_location(size_t bytes) {
+    const struct memory_map* map = memory_map_get();
+
+    for (size_t i = 0; i < map->count; i++) {
+        if (map->entries[i].type != MULTIBOOT_MEMORY_AVAILABLE) {
+            continue;
+        }
+        uint64_t region_end = map->entries[i].addr + map->entries[i].len;
+        uint64_t candidate = (map->entries[i].addr + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+
+        bool moved = true;
+        while (moved && candidate + bytes <= region_end) {
+            moved = false;
+            for (size_t r = 0; r < boot_reserved_count; r++) {
+                if (candidate < boot_reserved[r].end && candidate + bytes > boot_reserved[r].start) {
+                    // Skip past the overlapping range and check again
+                    candidate = (boot_reserved[r].end + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+                    moved = true;
                 }
             }
         }
+        if (candidate + bytes <= region_end && candidate + bytes <= 0x100000000ULL) {
+            return candidate;
+        }
     }
-    
-    // If not found, search from beginning to last allocated page
-    for (size_t i = 0; i < start_word; i++) {
-        uint32_t word = bitmap[i];
-        if (word != 0xFFFFFFFF) {
-            for (size_t j = 0; j < 32; j++) {
-                if (!(word & (1 << j))) {
-                    return i * 32 + j;
-                }
+    return 0;
+}
+
+// Pages fully inside [start, end), clipped to the bitmap
+static bool range_to_pages(uint64_t start, uint64_t end, bool inclusive, size_t* first, size_t* count) {
+    uint64_t first_page, end_page;
+    if (inclusive) {
+        // Any page touched by the range
+        first_page = start / PAGE_SIZE;
+        end_page = (end + PAGE_SIZE - 1) / PAGE_SIZE;
+    } else {
+        // Only pages entirely inside the range
+        first_page = (start + PAGE_SIZE - 1) / PAGE_SIZE;
+        end_page = end / PAGE_SIZE;
+    }
+    if (end_page > total_pages) {
+        end_page = total_pages;
+    }
+    if (first_page >= end_page) {
+        return false;
+    }
+    *first = (size_t)first_page;
+    *count = (size_t)(end_page - first_page);
+    return true;
+}
+
+bool pmm_reserve_range(uint64_t base, uint64_t length) {
+    size_t first, count;
+    if (!bitmap || length == 0 || !range_to_pages(base, base + length, true, &first, &count)) {
+        return false;
+    }
+
+#ifdef PMM_BUDDY
+    if (pmm_ready) {
+        // Free pages in the range are sitting in buddy blocks
+        for (size_t page = first; page < first + count; page++) {
+            if (!(bitmap[page / 32] & (1u << (page % 32)))) {
+                buddy_take_page(page);
             }
         }
     }
-    
-    return (size_t)-1; // No free pages
+#endif
+
+    free_pages -= bitmap_fill_range(first, count, true);
+    return true;
 }
 
-void pmm_init(void) {
-    // Get total memory from memory map
-    uint64_t total_memory = memory_map_get_total_memory();
+void pmm_init(void* multiboot_info) {
+    const struct memory_map* map = memory_map_get();
+    
+    // The bitmap spans up to the end of the highest available region (below 4GB)
+    uint64_t highest = 0;
+    uint64_t total_memory = 0;
+    for (size_t i = 0; i < map->count; i++) {
+        if (map->entries[i].type != MULTIBOOT_MEMORY_AVAILABLE) {
+            continue;
+        }
+        uint64_t end = map->entries[i].addr + map->entries[i].len;
+        if (end > 0x100000000ULL) {
+            end = 0x100000000ULL;
+        }
+        if (end > highest) {
+            highest = end;
+        }
+        total_memory += map->entries[i].len;
+    }
     
-    // Calculate total number of pages (4KB each)
-    total_pages = total_memory / PAGE_SIZE;
-    free_pages = total_pages;
+    total_pages = highest / PAGE_SIZE;
+    usable_pages = total_memory / PAGE_SIZE;
+    free_pages = 0;
+    pmm_ready = false;
     
     // Calculate bitmap size (1 bit per page, 32 bits per uint32_t)
     bitmap_size = (total_pages + 31) / 32;
+    summary_size = (bitmap_size + 31) / 32;
+    size_t metadata_bytes = (bitmap_size + summary_size) * sizeof(uint32_t);
+#ifdef PMM_BUDDY
+    metadata_bytes += total_pages;  // buddy_order[]
+#endif
     
-    // Find a suitable location for the bitmap in available memory
-    const struct memory_map* map = memory_map_get();
-    bool bitmap_allocated = false;
+    // Place the metadata somewhere that is neither kernel, module nor heap
+    collect_boot_reserved(multiboot_info);
+    uint64_t metadata_addr = find_metadata_location(metadata_bytes);
+    if (!metadata_addr) {
+        bitmap = NULL;
+        terminal_writestring("Failed to allocate bitmap for PMM\n");
+        return;
+    }
+    
+    bitmap = (uint32_t*)(uint32_t)metadata_addr;
+    summary = bitmap + bitmap_size;
+#ifdef PMM_BUDDY
+    buddy_order = (uint8_t*)(summary + summary_size);
+#endif
+    
+    // Start with every page used, including the bits past the last page
+    memset(bitmap, 0xFF, (bitmap_size + summary_size) * sizeof(uint32_t));
     
-    // Look for a suitable memory region for the bitmap
+    // Free the pages the firmware reports as available
     for (size_t i = 0; i < map->count; i++) {
-        if (map->entries[i].type == MULTIBOOT_MEMORY_AVAILABLE) {
-            uint64_t start = map->entries[i].addr;
-            uint64_t length = map->entries[i].len;
-            
-            // Check if this region is large enough for the bitmap
-            if (length >= bitmap_size * sizeof(uint32_t)) {
-                // Place bitmap at the start of this region
-                bitmap = (uint32_t*)start;
-                bitmap_allocated = true;
-                
-                // Mark this region as used in the bitmap
-                size_t start_page = start / PAGE_SIZE;
-                size_t bitmap_pages = (bitmap_size * sizeof(uint32_t) + PAGE_SIZE - 1) / PAGE_SIZE;
-                
-                // Clear the bitmap first
-                memset(bitmap, 0, bitmap_size * sizeof(uint32_t));
-                
-                // Mark bitmap pages as used
-                for (size_t j = 0; j < bitmap_pages; j++) {
-                    bitmap_set(start_page + j);
-                    free_pages--;
-                }
-                
-                terminal_writestring("PMM bitmap address: 0x");
-                terminal_writehex((uint32_t)bitmap);
-                terminal_writestring("\n");
-                break;
-            }
+        size_t first, count;
+        if (map->entries[i].type == MULTIBOOT_MEMORY_AVAILABLE &&
+            range_to_pages(map->entries[i].addr, map->entries[i].addr + map->entries[i].len,
+                           false, &first, &count)) {
+            free_pages += bitmap_fill_range(first, count, false);
         }
     }
     
-    if (!bitmap_allocated) {
-        terminal_writestring("Failed to allocate bitmap for PMM\n");
-        return;
+    // Overlapping reserved/ACPI entries win over available ones
+    for (size_t i = 0; i < map->count; i++) {
+        if (map->entries[i].type != MULTIBOOT_MEMORY_AVAILABLE) {
+            pmm_reserve_range(map->entries[i].addr, map->entries[i].len);
+        }
     }
     
-    // Mark the first 1MB as used (where kernel and bitmap reside)
-    for (size_t i = 0; i < 256; i++) {  // 1MB / 4KB = 256 pages
-        if (!bitmap_test(i)) {  // Only mark if not already marked
-            bitmap_set(i);
-            free_pages--;
-        }
+    // Low memory, kernel, heap window, multiboot data and modules
+    for (size_t i = 0; i < boot_reserved_count; i++) {
+        pmm_reserve_range(boot_reserved[i].start, boot_reserved[i].end - boot_reserved[i].start);
     }
     
+    // And the bitmap itself
+    pmm_reserve_range(metadata_addr, metadata_bytes);
+    
+    terminal_writestring("PMM bitmap address: 0x");
+    terminal_writehex((uint32_t)bitmap);
+    terminal_writestring("\n");
+    
+#ifdef PMM_BUDDY
+    buddy_init();
+#endif
+    pmm_ready = true;
+    
     // Print memory information
     terminal_writestring("\nMemory Information:\n");
     terminal_writestring("Total Memory: ");
@@ -146,7 +519,7 @@ void pmm_init(void) {
     terminal_writestring("Total Pages: ");
     // Convert total_pages to string
     i = 0;
-    size_t pages = total_pages;
+    size_t pages = usable_pages;
     do {
         mb_str[i++] = '0' + (pages % 10);
         pages /= 10;
@@ -179,7 +552,15 @@ void* pmm_alloc_page(void) {
         return NULL; // No free pages
     }
     
-    size_t page = bitmap_first_free();
+#ifdef PMM_BUDDY
+    size_t page = buddy_alloc_block(0);
+#else
+    // Start from the last allocated page, then wrap around
+    size_t page = bitmap_find_free(last_allocated_page);
+    if (page == (size_t)-1) {
+        page = bitmap_find_free(0);
+    }
+#endif
     if (page == (size_t)-1) {
         return NULL;
     }
@@ -196,37 +577,144 @@ void* pmm_alloc_page(void) {
 }
 
 void pmm_free_page(void* page) {
-    if (!page) return;
+    pmm_free_pages(page, 1);
+}
+
+void* pmm_alloc_pages(size_t count, size_t align) {
+    if (count == 0 || count > free_pages) {
+        return NULL;
+    }
+    
+    // Alignment is given in bytes; anything below a page means page alignment
+    size_t align_pages = align > PAGE_SIZE ? align / PAGE_SIZE : 1;
+    if (align_pages & (align_pages - 1)) {
+        return NULL; // Alignment must be a power of two
+    }
+    
+#ifdef PMM_BUDDY
+    // Smallest block covering both the size and the alignment
+    uint32_t order = 0;
+    while (order <= PMM_MAX_ORDER &&
+           (((size_t)1 << order) < count || ((size_t)1 << order) < align_pages)) {
+        order++;
+    }
+    if (order > PMM_MAX_ORDER) {
+        return NULL;
+    }
+    
+    size_t page = buddy_alloc_block(order);
+    if (page == (size_t)-1) {
+        return NULL;
+    }
     
-    // Convert physical address to page number
-    size_t page_num = (size_t)page / PAGE_SIZE;
+    // Give the unused tail of the block straight back
+    buddy_release(page + count, ((size_t)1 << order) - count);
+#else
+    size_t page = bitmap_find_run(last_allocated_page, count, align_pages);
+    if (page == (size_t)-1) {
+        page = bitmap_find_run(0, count, align_pages);
+    }
+    if (page == (size_t)-1) {
+        return NULL;
+    }
+#endif
+    
+    free_pages -= bitmap_fill_range(page, count, true);
+    last_allocated_page = page + count - 1;
     
-    // Check if page is valid
+    return (void*)(page * PAGE_SIZE);
+}
+
+void pmm_free_pages(void* base, size_t count) {
+    if (!base || count == 0) return;
+    
+    size_t page_num = (size_t)base / PAGE_SIZE;
     if (page_num >= total_pages) {
         return;
     }
+    if (count > total_pages - page_num) {
+        count = total_pages - page_num;
+    }
     
-    // Check if page is actually allocated
-    if (!bitmap_test(page_num)) {
-        return;
+#ifdef PMM_BUDDY
+    // Only pages that are actually allocated go back on the lists
+    size_t end = page_num + count;
+    size_t page = bitmap_find_used(page_num, end);
+    while (page < end) {
+        size_t run_end = bitmap_find_free(page);
+        if (run_end == (size_t)-1 || run_end > end) {
+            run_end = end;
+        }
+        free_pages += bitmap_fill_range(page, run_end - page, false);
+        buddy_release(page, run_end - page);
+        page = bitmap_find_used(run_end, end);
     }
+#else
+    free_pages += bitmap_fill_range(page_num, count, false);
+#endif
+}
+
+void pmm_get_order_counts(size_t counts[PMM_MAX_ORDER + 1]) {
+#ifdef PMM_BUDDY
+    for (uint32_t order = 0; order <= PMM_MAX_ORDER; order++) {
+        counts[order] = free_area_count[order];
+    }
+#else
+    // Split each free run into the aligned blocks a buddy allocator would hold
+    memset(counts, 0, (PMM_MAX_ORDER + 1) * sizeof(size_t));
+    if (!bitmap) return;
     
-    // Mark page as free
-    bitmap_clear(page_num);
-    free_pages++;
+    size_t page = 0;
+    while ((page = bitmap_find_free(page)) != (size_t)-1) {
+        size_t end = bitmap_find_used(page, total_pages);
+        while (page < end) {
+            uint32_t order = block_order(page, end - page);
+            counts[order]++;
+            page += (size_t)1 << order;
+        }
+    }
+#endif
+}
+
+uint32_t pmm_get_fragmentation(uint32_t order) {
+    if (order > PMM_MAX_ORDER) {
+        order = PMM_MAX_ORDER;
+    }
+    
+    size_t counts[PMM_MAX_ORDER + 1];
+    pmm_get_order_counts(counts);
+    
+    size_t total_free = 0;
+    size_t usable = 0;
+    for (uint32_t o = 0; o <= PMM_MAX_ORDER; o++) {
+        size_t pages = counts[o] << o;
+        total_free += pages;
+        if (o >= order) {
+            usable += pages;
+        }
+    }
+    if (total_free == 0) {
+        return 0;
+    }
+    
+    // Share of free memory sitting in blocks too small for this order
+    return (uint32_t)(((total_free - usable) * 100) / total_free);
 }
 
 size_t pmm_get_total_pages(void) {
-    return total_pages;
+    return usable_pages;
 }
 
 size_t pmm_get_free_pages(void) {
     return free_pages;
 }
 
+uint64_t pmm_get_memory_top(void) {
+    return (uint64_t)total_pages * PAGE_SIZE;
+}
+
 // Map physical address to virtual address
 void* pmm_map_physical_to_virtual(uint32_t physical_addr) {
-    // For now, we'll use a simple 1:1 mapping
-    // In a real system, this would use page tables
+    // The VMM identity maps all RAM below VMM_KERNEL_TOP
     return (void*)physical_addr;
 } 
\ No newline at end of file
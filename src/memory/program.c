@@ -1,5 +1,6 @@
 #include "../../include/memory/program.h"
 #include "../../include/memory/pmm.h"
+#include "../../include/memory/vmm.h"
 #include "../../include/drivers/vbe.h"
 #include <string.h>
 
@@ -8,22 +9,32 @@
 
 bool program_load(void* code_addr, size_t code_size, void* data_addr, size_t data_size, program_entry_t entry, struct program* prog) {
     if (!prog) return false;
+
+    // The entry point has to lie in the code being loaded
+    if ((uint8_t*)entry < (uint8_t*)code_addr || (uint8_t*)entry >= (uint8_t*)code_addr + code_size) {
+        terminal_writestring("Program entry point outside its code\n");
+        return false;
+    }
     
     // Calculate number of pages needed
     size_t code_pages = (code_size + PAGE_SIZE - 1) / PAGE_SIZE;
     size_t data_pages = (data_size + PAGE_SIZE - 1) / PAGE_SIZE;
     
-    // Allocate code segment
-    void* code_segment = pmm_alloc_page();
+    // Every segment gets at least one page
+    if (code_pages == 0) code_pages = 1;
+    if (data_pages == 0) data_pages = 1;
+    
+    // Allocate code segment as one contiguous run
+    void* code_segment = pmm_alloc_pages(code_pages, PAGE_SIZE);
     if (!code_segment) {
         terminal_writestring("Failed to allocate code segment\n");
         return false;
     }
     
     // Allocate data segment
-    void* data_segment = pmm_alloc_page();
+    void* data_segment = pmm_alloc_pages(data_pages, PAGE_SIZE);
     if (!data_segment) {
-        pmm_free_page(code_segment);
+        pmm_free_pages(code_segment, code_pages);
         terminal_writestring("Failed to allocate data segment\n");
         return false;
     }
@@ -32,12 +43,37 @@ bool program_load(void* code_addr, size_t code_size, void* data_addr, size_t dat
     memcpy(code_segment, code_addr, code_size);
     memcpy(data_segment, data_addr, data_size);
     
+    // Map both segments into a private address space at VMM_PROCESS_BASE
+    struct vmm_address_space* space = vmm_create_address_space();
+    void* code_base = code_segment;
+    void* data_base = data_segment;
+    if (space) {
+        code_base = (void*)VMM_PROCESS_BASE;
+        data_base = (void*)(VMM_PROCESS_BASE + code_pages * PAGE_SIZE);
+        for (size_t i = 0; i < code_pages + data_pages; i++) {
+            uint32_t phys = i < code_pages
+                ? (uint32_t)code_segment + i * PAGE_SIZE
+                : (uint32_t)data_segment + (i - code_pages) * PAGE_SIZE;
+            if (!vmm_map(space, (void*)(VMM_PROCESS_BASE + i * PAGE_SIZE), phys, VMM_WRITE | VMM_USER)) {
+                vmm_destroy_address_space(space);
+                pmm_free_pages(code_segment, code_pages);
+                pmm_free_pages(data_segment, data_pages);
+                terminal_writestring("Failed to map program address space\n");
+                return false;
+            }
+        }
+    }
+    
     // Set up program structure
     prog->code_segment = code_segment;
     prog->data_segment = data_segment;
     prog->code_size = code_size;
     prog->data_size = data_size;
     prog->entry = entry;
+    prog->load_base = code_addr;
+    prog->address_space = space;
+    prog->code_base = code_base;
+    prog->data_base = data_base;
     
     return true;
 }
@@ -48,16 +84,15 @@ void program_unload(struct program* prog) {
     // Calculate number of pages
     size_t code_pages = (prog->code_size + PAGE_SIZE - 1) / PAGE_SIZE;
     size_t data_pages = (prog->data_size + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (code_pages == 0) code_pages = 1;
+    if (data_pages == 0) data_pages = 1;
     
-    // Free code segment
-    for (size_t i = 0; i < code_pages; i++) {
-        pmm_free_page((void*)((uint32_t)prog->code_segment + i * PAGE_SIZE));
-    }
+    // Drop the address space before the pages it maps
+    vmm_destroy_address_space(prog->address_space);
     
-    // Free data segment
-    for (size_t i = 0; i < data_pages; i++) {
-        pmm_free_page((void*)((uint32_t)prog->data_segment + i * PAGE_SIZE));
-    }
+    // Free code and data segments
+    pmm_free_pages(prog->code_segment, code_pages);
+    pmm_free_pages(prog->data_segment, data_pages);
     
     // Clear program structure
     memset(prog, 0, sizeof(struct program));
@@ -69,8 +104,12 @@ bool program_execute(struct program* prog) {
     // Check if program is properly loaded
     if (!prog->code_segment || !prog->data_segment) return false;
     
-    // Execute program
-    prog->entry();
+    // Execute the copy at code_base, in the program's own address space
+    program_entry_t entry = (program_entry_t)((uint8_t*)prog->code_base +
+                                              ((uint8_t*)prog->entry - (uint8_t*)prog->load_base));
+    vmm_switch_address_space(prog->address_space);
+    entry();
+    vmm_switch_address_space(NULL);
     
     return true;
 } 
\ No newline at end of file
@@ -9,4 +9,14 @@ void* malloc(size_t size) {
 // Wrapper for kfree
 void free(void* ptr) {
     kfree(ptr);
-} 
\ No newline at end of file
+}
+
+// Wrapper for krealloc
+void* realloc(void* ptr, size_t size) {
+    return krealloc(ptr, size);
+}
+
+// Wrapper for kcalloc
+void* calloc(size_t count, size_t size) {
+    return kcalloc(count, size);
+}
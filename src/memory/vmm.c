@@ -0,0 +1,524 @@
+#include "../../include/memory/vmm.h"
+#include "../../include/memory/pmm.h"
+#include "../../include/memory/heap.h"
+#include "../../include/drivers/vbe.h"
+#include "../../include/io.h"
+#include "../../include/stdio.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Page table entry bits used internally
+#define PTE_PRESENT 0x001
+#define PTE_LARGE   0x080   // 4MB page (PDE only, needs CR4.PSE)
+#define PTE_GLOBAL  0x100   // Survives CR3 reloads (needs CR4.PGE)
+#define PTE_PAT     0x080   // PAT index bit in a 4KB PTE
+#define PDE_PAT     0x1000  // PAT index bit in a 4MB PDE
+#define PTE_CACHE   (VMM_WRITE_THROUGH | VMM_NO_CACHE)
+
+#define LARGE_PAGE_SIZE 0x400000
+#define PDE_INDEX(addr) ((uint32_t)(addr) >> 22)
+#define PTE_INDEX(addr) (((uint32_t)(addr) >> 12) & 0x3FF)
+
+// CPUID leaf 1 EDX feature bits
+#define CPUID_PSE  (1 << 3)
+#define CPUID_MTRR (1 << 12)
+#define CPUID_PGE  (1 << 13)
+#define CPUID_PAT  (1 << 16)
+
+// PAT and MTRR registers
+#define MSR_PAT            0x277
+#define MSR_MTRR_CAP       0xFE
+#define MSR_MTRR_DEF_TYPE  0x2FF
+#define MSR_MTRR_PHYSBASE0 0x200
+#define MSR_MTRR_PHYSMASK0 0x201
+#define MTRR_TYPE_WC       0x01
+#define MTRR_CAP_WC        (1 << 10)
+#define MTRR_ENABLE        (1 << 11)
+#define MTRR_MASK_VALID    (1 << 11)
+#define CR0_CD (1 << 30)
+#define CR0_NW (1 << 29)
+
+#define CR0_WP (1 << 16)
+#define CR0_PG (1u << 31)
+#define CR4_PSE (1 << 4)
+#define CR4_PGE (1 << 7)
+
+static struct vmm_address_space kernel_space;
+static struct vmm_address_space* current_space = &kernel_space;
+static bool paging_enabled = false;
+static bool pse_supported = false;
+static uint32_t global_flag = 0;   // PTE_GLOBAL when PGE is available
+static bool pat_enabled = false;   // PAT entry 4 holds write-combining
+static bool mtrr_supported = false;
+
+// Next-fit cursor for the dynamic window
+static uint32_t dynamic_cursor = VMM_DYNAMIC_BASE;
+
+static inline bool in_process_window(uint32_t addr) {
+    return addr >= VMM_PROCESS_BASE && addr < VMM_PROCESS_END;
+}
+
+static inline uint32_t* space_directory(struct vmm_address_space* space) {
+    return space ? space->page_directory : kernel_space.page_directory;
+}
+
+// Hardware cache bits for a 4KB PTE or a 4MB PDE
+static inline uint32_t cache_bits(uint32_t flags, bool large) {
+    if ((flags & VMM_WRITE_COMBINING) && pat_enabled) {
+        // PAT=1, PCD=0, PWT=0 selects PAT entry 4
+        return large ? PDE_PAT : PTE_PAT;
+    }
+    return flags & PTE_CACHE;
+}
+
+// Get the page table covering 'virt', creating it if asked.
+// Returns NULL if there is none or the range is a 4MB page.
+static uint32_t* get_page_table(uint32_t* directory, uint32_t virt, bool create, uint32_t flags) {
+    uint32_t pde = directory[PDE_INDEX(virt)];
+    if (pde & PTE_PRESENT) {
+        if (pde & PTE_LARGE) {
+            return NULL;
+        }
+        return (uint32_t*)(pde & ~0xFFF);
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    uint32_t* table = (uint32_t*)pmm_alloc_page();
+    if (!table) {
+        return NULL;
+    }
+    memset(table, 0, PAGE_SIZE);
+    directory[PDE_INDEX(virt)] = (uint32_t)table | PTE_PRESENT | VMM_WRITE | (flags & VMM_USER);
+    return table;
+}
+
+static inline void flush_page(struct vmm_address_space* space, void* virt) {
+    if (paging_enabled && (space == NULL || space == current_space)) {
+        invlpg(virt);
+    }
+}
+
+bool vmm_is_enabled(void) {
+    return paging_enabled;
+}
+
+bool vmm_map(struct vmm_address_space* space, void* virt, uint32_t phys, uint32_t flags) {
+    uint32_t* table = get_page_table(space_directory(space), (uint32_t)virt, true, flags);
+    if (!table) {
+        return false;
+    }
+
+    uint32_t entry = (phys & ~0xFFF) | PTE_PRESENT | (flags & (VMM_WRITE | VMM_USER)) | cache_bits(flags, false);
+    if (!(flags & VMM_USER) && !in_process_window((uint32_t)virt)) {
+        entry |= global_flag;
+    }
+    table[PTE_INDEX(virt)] = entry;
+    flush_page(space, virt);
+    return true;
+}
+
+void vmm_unmap(struct vmm_address_space* space, void* virt) {
+    uint32_t* table = get_page_table(space_directory(space), (uint32_t)virt, false, 0);
+    if (!table) {
+        return;
+    }
+    table[PTE_INDEX(virt)] = 0;
+    flush_page(space, virt);
+}
+
+uint32_t vmm_get_physical(struct vmm_address_space* space, void* virt) {
+    uint32_t* directory = space_directory(space);
+    uint32_t pde = directory[PDE_INDEX(virt)];
+    if (!(pde & PTE_PRESENT)) {
+        return 0;
+    }
+    if (pde & PTE_LARGE) {
+        return (pde & ~(LARGE_PAGE_SIZE - 1)) | ((uint32_t)virt & (LARGE_PAGE_SIZE - 1));
+    }
+
+    uint32_t pte = ((uint32_t*)(pde & ~0xFFF))[PTE_INDEX(virt)];
+    if (!(pte & PTE_PRESENT)) {
+        return 0;
+    }
+    return (pte & ~0xFFF) | ((uint32_t)virt & 0xFFF);
+}
+
+// Identity map [start, end) in the kernel directory.
+// Whole 4MB chunks become large pages when PSE is available.
+static bool identity_map(uint32_t start, uint64_t end, uint32_t flags) {
+    uint32_t* directory = kernel_space.page_directory;
+    uint64_t addr = start & ~0xFFF;
+
+    while (addr < end) {
+        uint32_t pde = directory[PDE_INDEX(addr)];
+        uint64_t chunk_end = (addr & ~(uint64_t)(LARGE_PAGE_SIZE - 1)) + LARGE_PAGE_SIZE;
+
+        if (pde & PTE_LARGE) {
+            // Already covered by a 4MB page; it must be the identity one
+            if ((pde & ~(LARGE_PAGE_SIZE - 1)) != (addr & ~(uint64_t)(LARGE_PAGE_SIZE - 1))) {
+                return false;
+            }
+            addr = chunk_end;
+            continue;
+        }
+
+        if (pse_supported && !(pde & PTE_PRESENT) && (addr & (LARGE_PAGE_SIZE - 1)) == 0) {
+            directory[PDE_INDEX(addr)] = (uint32_t)addr | PTE_PRESENT | PTE_LARGE | global_flag |
+                                         (flags & (VMM_WRITE | VMM_USER)) | cache_bits(flags, true);
+            addr = chunk_end;
+            continue;
+        }
+
+        // Fall back to 4KB pages for the part of this chunk we need
+        uint64_t stop = chunk_end < end ? chunk_end : end;
+        for (; addr < stop; addr += PAGE_SIZE) {
+            uint32_t existing = vmm_get_physical(NULL, (void*)(uint32_t)addr);
+            if (existing && existing != (uint32_t)addr) {
+                return false;
+            }
+            if (!existing && !vmm_map(NULL, (void*)(uint32_t)addr, (uint32_t)addr, flags)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void* vmm_map_mmio(uint32_t phys, size_t size, uint32_t flags) {
+    if (size == 0) {
+        return NULL;
+    }
+    uint64_t end = (uint64_t)phys + size;
+    if (end > 0x100000000ULL) {
+        end = 0x100000000ULL;
+    }
+
+    // Devices keep their physical address so BAR-derived pointers stay valid
+    if (!identity_map(phys, end, flags)) {
+        printf("VMM: cannot identity map MMIO at 0x%08x\n", phys);
+        return NULL;
+    }
+    if (paging_enabled) {
+        write_cr3(read_cr3());
+    }
+    return (void*)phys;
+}
+
+bool vmm_has_pat(void) {
+    return pat_enabled;
+}
+
+bool vmm_set_cache_flags(void* virt, size_t size, uint32_t cache_flags) {
+    uint32_t* directory = kernel_space.page_directory;
+    uint64_t addr = (uint32_t)virt & ~0xFFF;
+    uint64_t end = (uint64_t)(uint32_t)virt + size;
+    bool ok = true;
+
+    while (addr < end) {
+        uint32_t* pde = &directory[PDE_INDEX(addr)];
+        if (!(*pde & PTE_PRESENT)) {
+            ok = false;
+            addr = (addr & ~(uint64_t)(LARGE_PAGE_SIZE - 1)) + LARGE_PAGE_SIZE;
+            continue;
+        }
+        if (*pde & PTE_LARGE) {
+            *pde = (*pde & ~(PTE_CACHE | PDE_PAT)) | cache_bits(cache_flags, true);
+            invlpg((void*)(uint32_t)addr);
+            addr = (addr & ~(uint64_t)(LARGE_PAGE_SIZE - 1)) + LARGE_PAGE_SIZE;
+            continue;
+        }
+
+        uint32_t* pte = &((uint32_t*)(*pde & ~0xFFF))[PTE_INDEX(addr)];
+        if (*pte & PTE_PRESENT) {
+            *pte = (*pte & ~(PTE_CACHE | PTE_PAT)) | cache_bits(cache_flags, false);
+            invlpg((void*)(uint32_t)addr);
+        } else {
+            ok = false;
+        }
+        addr += PAGE_SIZE;
+    }
+
+    // Lines cached under the old type must not linger
+    wbinvd();
+    return ok;
+}
+
+// Cover [phys, phys + size) with a write-combining variable MTRR.
+// The range is rounded up to a power of two and must be aligned to it.
+static bool mtrr_set_write_combining(uint32_t phys, size_t size) {
+    if (!mtrr_supported) {
+        return false;
+    }
+    uint64_t cap = rdmsr(MSR_MTRR_CAP);
+    if (!(cap & MTRR_CAP_WC)) {
+        return false;
+    }
+
+    uint64_t range = PAGE_SIZE;
+    while (range < size) {
+        range <<= 1;
+    }
+    if (phys & (range - 1)) {
+        return false;
+    }
+
+    // Physical address width decides how wide the mask is
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t phys_bits = 36;
+    cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    if (eax >= 0x80000008) {
+        cpuid(0x80000008, &eax, &ebx, &ecx, &edx);
+        phys_bits = eax & 0xFF;
+    }
+    uint64_t mask = ~(range - 1) & ((1ULL << phys_bits) - 1);
+
+    uint32_t count = cap & 0xFF;
+    for (uint32_t i = 0; i < count; i++) {
+        if (rdmsr(MSR_MTRR_PHYSMASK0 + i * 2) & MTRR_MASK_VALID) {
+            continue;
+        }
+
+        // Intel SDM sequence: caches off, MTRRs off, update, back on
+        uint32_t eflags;
+        asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+        uint32_t cr0 = read_cr0();
+        write_cr0((cr0 | CR0_CD) & ~CR0_NW);
+        wbinvd();
+        uint64_t def_type = rdmsr(MSR_MTRR_DEF_TYPE);
+        wrmsr(MSR_MTRR_DEF_TYPE, def_type & ~MTRR_ENABLE);
+
+        wrmsr(MSR_MTRR_PHYSBASE0 + i * 2, phys | MTRR_TYPE_WC);
+        wrmsr(MSR_MTRR_PHYSMASK0 + i * 2, mask | MTRR_MASK_VALID);
+
+        wbinvd();
+        wrmsr(MSR_MTRR_DEF_TYPE, def_type);
+        write_cr0(cr0);
+        if (eflags & 0x200) {
+            asm volatile("sti");
+        }
+        return true;
+    }
+    return false;
+}
+
+bool vmm_set_write_combining(uint32_t phys, size_t size) {
+    if (pat_enabled && paging_enabled) {
+        return vmm_set_cache_flags((void*)phys, size, VMM_WRITE_COMBINING);
+    }
+    return mtrr_set_write_combining(phys, size);
+}
+
+// Reprogram PAT entry 4 (normally WB) as write-combining.
+// Entries 0-3 keep their power-on meaning, so PWT/PCD work as before.
+static void pat_init(void) {
+    uint64_t pat = rdmsr(MSR_PAT);
+    pat &= ~(0xFFULL << 32);
+    pat |= (uint64_t)MTRR_TYPE_WC << 32;
+    wbinvd();
+    wrmsr(MSR_PAT, pat);
+    wbinvd();
+    pat_enabled = true;
+}
+
+// Find 'pages' unmapped pages in the dynamic window (next-fit)
+static uint32_t find_dynamic_range(size_t pages) {
+    size_t window_pages = (VMM_DYNAMIC_END - VMM_DYNAMIC_BASE) / PAGE_SIZE;
+    if (pages == 0 || pages > window_pages) {
+        return 0;
+    }
+
+    // From the cursor to the end of the window, then from its start
+    uint32_t starts[2] = { dynamic_cursor, VMM_DYNAMIC_BASE };
+    for (int pass = 0; pass < 2; pass++) {
+        size_t run = 0;
+        for (uint32_t addr = starts[pass]; addr < VMM_DYNAMIC_END; addr += PAGE_SIZE) {
+            uint32_t* table = get_page_table(kernel_space.page_directory, addr, false, 0);
+            if (!table || (table[PTE_INDEX(addr)] & PTE_PRESENT)) {
+                run = 0;
+                continue;
+            }
+            if (++run == pages) {
+                dynamic_cursor = addr + PAGE_SIZE;
+                return addr - (pages - 1) * PAGE_SIZE;
+            }
+        }
+    }
+    return 0;
+}
+
+void* vmm_alloc_region(size_t size, uint32_t flags) {
+    size_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t base = find_dynamic_range(pages);
+    if (!base) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < pages; i++) {
+        uint32_t phys = (uint32_t)pmm_alloc_page();
+        if (!phys || !vmm_map(NULL, (void*)(base + i * PAGE_SIZE), phys, flags & ~VMM_USER)) {
+            if (phys) {
+                pmm_free_page((void*)phys);
+            }
+            vmm_free_region((void*)base, i * PAGE_SIZE);
+            return NULL;
+        }
+    }
+    return (void*)base;
+}
+
+void vmm_free_region(void* addr, size_t size) {
+    uint32_t base = (uint32_t)addr & ~0xFFF;
+    size_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    for (size_t i = 0; i < pages; i++) {
+        void* virt = (void*)(base + i * PAGE_SIZE);
+        uint32_t phys = vmm_get_physical(NULL, virt);
+        if (phys) {
+            vmm_unmap(NULL, virt);
+            pmm_free_page((void*)(phys & ~0xFFF));
+        }
+    }
+}
+
+// Copy the shared kernel entries into a process directory
+static void sync_kernel_entries(uint32_t* directory) {
+    for (uint32_t i = 0; i < 1024; i++) {
+        uint32_t pde = kernel_space.page_directory[i];
+        // Large pages in the process window (e.g. a framebuffer) stay shared too
+        if (!in_process_window(i << 22) || (pde & PTE_LARGE)) {
+            directory[i] = pde;
+        }
+    }
+}
+
+struct vmm_address_space* vmm_create_address_space(void) {
+    if (!paging_enabled) {
+        return NULL;
+    }
+
+    struct vmm_address_space* space = (struct vmm_address_space*)kmalloc(sizeof(struct vmm_address_space));
+    if (!space) {
+        return NULL;
+    }
+    space->page_directory = (uint32_t*)pmm_alloc_page();
+    if (!space->page_directory) {
+        kfree(space);
+        return NULL;
+    }
+
+    memset(space->page_directory, 0, PAGE_SIZE);
+    sync_kernel_entries(space->page_directory);
+    return space;
+}
+
+void vmm_destroy_address_space(struct vmm_address_space* space) {
+    if (!space || space == &kernel_space) {
+        return;
+    }
+    if (current_space == space) {
+        vmm_switch_address_space(NULL);
+    }
+
+    // Only the process window has private page tables
+    for (uint32_t i = PDE_INDEX(VMM_PROCESS_BASE); i < PDE_INDEX(VMM_PROCESS_END); i++) {
+        uint32_t pde = space->page_directory[i];
+        if ((pde & PTE_PRESENT) && !(pde & PTE_LARGE)) {
+            pmm_free_page((void*)(pde & ~0xFFF));
+        }
+    }
+    pmm_free_page(space->page_directory);
+    kfree(space);
+}
+
+void vmm_switch_address_space(struct vmm_address_space* space) {
+    if (!paging_enabled) {
+        return;
+    }
+    if (!space) {
+        space = &kernel_space;
+    }
+    if (space != &kernel_space) {
+        // Pick up kernel mappings created after the space was made
+        sync_kernel_entries(space->page_directory);
+    }
+
+    current_space = space;
+    write_cr3((uint32_t)space->page_directory);
+}
+
+void page_fault_handler(uint32_t fault_addr, uint32_t error_code, uint32_t eip) {
+    printf("\nPage fault at 0x%08x (eip 0x%08x, %s %s%s)\n", fault_addr, eip,
+           (error_code & 0x2) ? "write" : "read",
+           (error_code & 0x1) ? "protection violation" : "not present",
+           (error_code & 0x4) ? ", user" : "");
+    terminal_writestring("System halted.\n");
+    for (;;) {
+        asm volatile("cli; hlt");
+    }
+}
+
+void vmm_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    pse_supported = (edx & CPUID_PSE) != 0;
+    global_flag = (edx & CPUID_PGE) ? PTE_GLOBAL : 0;
+    mtrr_supported = (edx & CPUID_MTRR) != 0;
+    if (edx & CPUID_PAT) {
+        pat_init();
+    }
+
+    // RAM above the kernel window cannot be reached through the identity map
+    uint64_t ram_top = pmm_get_memory_top();
+    if (ram_top > VMM_KERNEL_TOP) {
+        pmm_reserve_range(VMM_KERNEL_TOP, ram_top - VMM_KERNEL_TOP);
+        ram_top = VMM_KERNEL_TOP;
+    }
+
+    kernel_space.page_directory = (uint32_t*)pmm_alloc_page();
+    if (!kernel_space.page_directory) {
+        terminal_writestring("VMM: failed to allocate page directory\n");
+        return;
+    }
+    memset(kernel_space.page_directory, 0, PAGE_SIZE);
+    ram_top = (ram_top + LARGE_PAGE_SIZE - 1) & ~(uint64_t)(LARGE_PAGE_SIZE - 1);
+    if (ram_top > VMM_KERNEL_TOP) {
+        ram_top = VMM_KERNEL_TOP;
+    }
+
+    // Kernel, heap and all RAM
+    if (!identity_map(0, (uint32_t)ram_top, VMM_WRITE)) {
+        terminal_writestring("VMM: failed to map kernel memory\n");
+        return;
+    }
+
+    // Framebuffer, so vbe can keep drawing once paging is on
+    uint32_t fb = (uint32_t)vbe_get_framebuffer();
+    if (fb) {
+        identity_map(fb, (uint64_t)fb + vbe_get_pitch() * vbe_get_height(), VMM_WRITE);
+    }
+
+    // Page tables for the dynamic window exist up front so every
+    // address space shares them
+    for (uint32_t addr = VMM_DYNAMIC_BASE; addr < VMM_DYNAMIC_END; addr += LARGE_PAGE_SIZE) {
+        if (!(kernel_space.page_directory[PDE_INDEX(addr)] & PTE_PRESENT)) {
+            get_page_table(kernel_space.page_directory, addr, true, VMM_WRITE);
+        }
+    }
+
+    uint32_t cr4 = read_cr4();
+    if (pse_supported) cr4 |= CR4_PSE;
+    if (global_flag) cr4 |= CR4_PGE;
+    write_cr4(cr4);
+
+    write_cr3((uint32_t)kernel_space.page_directory);
+    write_cr0(read_cr0() | CR0_PG | CR0_WP);
+    paging_enabled = true;
+    current_space = &kernel_space;
+
+    printf("Paging enabled: %d MB identity mapped with %s pages\n",
+           (uint32_t)(ram_top >> 20), pse_supported ? "4MB" : "4KB");
+}
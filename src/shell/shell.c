@@ -8,6 +8,8 @@
 #include "../../include/tests/syscall_test.h"
 #include "../../include/version.h"
 #include "../../include/fs/fat16.h"
+#include "../../include/fs/bcache.h"
+#include "../../include/drivers/block_device.h"
 #include "../../include/test.h"
 #include "../../include/string.h"
 #include "../../include/editor.h"
@@ -68,33 +70,42 @@ bool set_current_directory(const char* path) {
     }
     
     // Try to change directory
-    if (fat16_change_directory(path, &current_cluster)) {
-        // Update current directory path
-        if (strcmp(path, "/") == 0) {
-            strcpy(current_directory, "/");
-        } else if (strcmp(path, "..") == 0) {
-            // Remove the last directory from the path
-            char* last_slash = strrchr(current_directory, '/');
-            if (last_slash) {
-                if (last_slash == current_directory) {
-                    // If we're at /dir, go back to /
-                    current_directory[1] = '\0';
-                } else {
-                    // Otherwise, truncate at the last slash
-                    *last_slash = '\0';
-                }
+    uint16_t cluster = current_cluster;
+    if (!fat16_change_directory(path, &cluster)) {
+        return false;
+    }
+    current_cluster = cluster;
+
+    // Rebuild the shown path by applying each component to it
+    char new_path[MAX_PATH_LENGTH];
+    strcpy(new_path, path[0] == '/' ? "/" : current_directory);
+    while (*path) {
+        while (*path == '/') path++;
+        int len = 0;
+        while (path[len] && path[len] != '/') len++;
+        if (len == 0) break;
+
+        if (len == 2 && path[0] == '.' && path[1] == '.') {
+            char* last_slash = strrchr(new_path, '/');
+            if (last_slash == new_path) {
+                new_path[1] = '\0';  // Back to /
+            } else if (last_slash) {
+                *last_slash = '\0';
             }
-        } else {
-            // For now, just append the directory name
-            if (strcmp(current_directory, "/") != 0) {
-                strcat(current_directory, "/");
+        } else if (!(len == 1 && path[0] == '.')) {
+            size_t used = strlen(new_path);
+            if (used + len + 2 > MAX_PATH_LENGTH) break;
+            if (used > 1) new_path[used++] = '/';
+            for (int i = 0; i < len; i++) {
+                char c = path[i];
+                new_path[used++] = (c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
             }
-            strcat(current_directory, path);
+            new_path[used] = '\0';
         }
-        return true;
+        path += len;
     }
-    
-    return false;
+    strcpy(current_directory, new_path);
+    return true;
 }
 
 #define MAX_CMD_LENGTH 256
@@ -110,7 +121,8 @@ static int cmd_index = 0;
 static const char* builtin_commands[] = {
     "help", "ls", "cat", "echo", "shutdown", "reboot", "memtest",
     "memtest2", "memstats", "syscall", "version", "progtest",
-    "mkfile", "rm", "clear", "edit", "cursortest", "cd", "pci", "usb"
+    "mkfile", "rm", "mkdir", "rmdir", "clear", "edit", "cursortest", "cd", "pci", "usb",
+    "vbe_bench", "bcache", "mount", "fsbench", "blkq"
 };
 static const int num_builtin_commands = sizeof(builtin_commands) / sizeof(builtin_commands[0]);
 
@@ -176,28 +188,22 @@ static const char* find_closest_command(const char* input) {
 void draw_header() {
     // Draw the box with the correct dimensions
     draw_box_with_text(0, 0, 70, 5, "Litago Operating System", BORDER_COLOR, HEADER_COLOR);
-    vbe_draw_string(1, 96, "  Type 'help' for a list of commands\n", TEXT_COLOR, &font_8x16);
+    terminal_writestring_at(0, 6, "  Type 'help' for a list of commands", TEXT_COLOR);
 }
 
 void draw_prompt() {
-    const PSF1Font* font = get_current_psf1_font();
-    if (!font) {
-        // Fall back to embedded font if PSF1 font is not available
-        vbe_draw_rect(0, vbe_cursor_y, VBE_WIDTH, font_8x16.height, 0x00000000);
-        vbe_draw_string(0, vbe_cursor_y, "[litago:", PROMPT_COLOR, &font_8x16);
-        vbe_draw_string(8 * 8, vbe_cursor_y, current_directory, PROMPT_COLOR, &font_8x16);
-        vbe_draw_string((8 + strlen(current_directory)) * 8, vbe_cursor_y, "] ", PROMPT_COLOR, &font_8x16);
-        vbe_cursor_x = (8 + strlen(current_directory) + 2) * 8;  // Update cursor position after prompt
-    } else {
-        vbe_draw_rect(0, vbe_cursor_y, VBE_WIDTH, font->header.char_height, 0x00000000);
-        vbe_draw_string_psf1(0, vbe_cursor_y, "[litago:", PROMPT_COLOR, font);
-        vbe_draw_string_psf1(8 * 8, vbe_cursor_y, current_directory, PROMPT_COLOR, font);
-        vbe_draw_string_psf1((8 + strlen(current_directory)) * 8, vbe_cursor_y, "] ", PROMPT_COLOR, font);
-        vbe_cursor_x = (8 + strlen(current_directory) + 2) * 8;  // Update cursor position after prompt
-    }
+    // The prompt is console text, so it scrolls and redraws with the output
+    vbe_cursor_x = 0;
+    terminal_clear_to_eol();
+    terminal_writestring_color("[litago:", PROMPT_COLOR);
+    terminal_writestring_color(current_directory, PROMPT_COLOR);
+    terminal_writestring_color("] ", PROMPT_COLOR);
 }
 
 static void shutdown() {
+    // Write back cached filesystem blocks
+    bcache_flush();
+
     // Try QEMU's shutdown port first
     outw(0x604, 0x2000);
     
@@ -219,6 +225,9 @@ static void shutdown() {
 }
 
 static void reboot() {
+    // Write back cached filesystem blocks
+    bcache_flush();
+
     // Try to reboot using the keyboard controller
     uint8_t good = 0x02;
     while (good & 0x02) {
@@ -269,6 +278,134 @@ static void memstats() {
     uint64_t free_bytes = (uint64_t)pmm_get_free_pages() * 4096;
     print_mem_size(free_bytes);
     terminal_writestring("\n");
+
+    struct heap_stats heap;
+    heap_get_stats(&heap);
+    terminal_writestring("  Heap in use: ");
+    print_mem_size(heap.bytes_in_use);
+    terminal_writestring("\n  Heap pages: ");
+    char buf[16];
+    itoa_custom(heap.pages_used, buf, 10);
+    terminal_writestring(buf);
+    terminal_writestring(" / ");
+    itoa_custom(heap.pages_total, buf, 10);
+    terminal_writestring(buf);
+    terminal_writestring("\n");
+
+    // Free physical blocks per order (4 KB .. 4 MB)
+    size_t counts[PMM_MAX_ORDER + 1];
+    pmm_get_order_counts(counts);
+    terminal_writestring("  Free blocks by order:\n");
+    for (int order = 0; order <= PMM_MAX_ORDER; order++) {
+        uint32_t block_kb = (PAGE_SIZE / 1024) << order;
+        terminal_writestring("    ");
+        itoa_custom(block_kb >= 1024 ? block_kb / 1024 : block_kb, buf, 10);
+        terminal_writestring(buf);
+        terminal_writestring(block_kb >= 1024 ? " MB: " : " KB: ");
+        itoa_custom(counts[order], buf, 10);
+        terminal_writestring(buf);
+        terminal_writestring("\n");
+    }
+    terminal_writestring("  Fragmentation (4 MB): ");
+    itoa_custom(pmm_get_fragmentation(PMM_MAX_ORDER), buf, 10);
+    terminal_writestring(buf);
+    terminal_writestring("%\n");
+}
+
+static void print_number(uint32_t value) {
+    char buf[16];
+    itoa_custom(value, buf, 10);
+    terminal_writestring(buf);
+}
+
+// Show the mounted volume or mount FAT16 from another block device
+static void mount(const char* name) {
+    block_device_t* previous = fat16_get_device();
+
+    if (*name != '\0') {
+        block_device_t* device = block_device_get(name);
+        if (!device) {
+            terminal_writestring("No such device (use iso, ide, ahci or virtio)\n");
+            return;
+        }
+        if (!fat16_mount(device)) {
+            terminal_writestring("Failed to mount FAT16 volume\n");
+            if (previous) {
+                fat16_mount(previous);
+            }
+        }
+        strcpy(current_directory, "/");
+    }
+
+    block_device_t* device = fat16_get_device();
+    if (!device) {
+        terminal_writestring("Nothing mounted\n");
+        return;
+    }
+    terminal_writestring("FAT16 on ");
+    terminal_writestring(device->name);
+    if (device->get_total_sectors) {
+        terminal_writestring(", ");
+        print_number(device->get_total_sectors() / 2048);
+        terminal_writestring(" MB device");
+    }
+    terminal_writestring(", ");
+    print_number(fat16_get_free_clusters() * boot_sector.sectors_per_cluster / 2);
+    terminal_writestring(" KB free\n");
+}
+
+// Write, flush and read back a file on the mounted volume
+static void fsbench() {
+    const uint32_t size = 256 * 1024;
+    uint8_t* data = (uint8_t*)malloc(size);
+    if (!data) {
+        terminal_writestring("Failed to allocate memory\n");
+        return;
+    }
+    for (uint32_t i = 0; i < size; i++) {
+        data[i] = (uint8_t)(i * 7);
+    }
+
+    // The remount resets the current directory
+    uint16_t saved_cluster = current_cluster;
+
+    uint32_t start = timer_get_ticks();
+    bool ok = fat16_write_file("/BENCH.TMP", data, size) && bcache_flush();
+    uint32_t write_ticks = timer_get_ticks() - start;
+
+    // Remounting drops the cached blocks so the read comes from the device
+    ok = ok && fat16_mount(fat16_get_device());
+    memset(data, 0, size);
+    start = timer_get_ticks();
+    ok = ok && fat16_read_file("/BENCH.TMP", data, size) == 1;
+    uint32_t read_ticks = timer_get_ticks() - start;
+
+    for (uint32_t i = 0; ok && i < size; i++) {
+        if (data[i] != (uint8_t)(i * 7)) {
+            terminal_writestring("Read back mismatch\n");
+            ok = false;
+        }
+    }
+    fat16_remove_file("/BENCH.TMP");
+    bcache_flush();
+    current_cluster = saved_cluster;
+    free(data);
+
+    if (!ok) {
+        terminal_writestring("Benchmark failed\n");
+        return;
+    }
+
+    // Ticks are 10 ms
+    if (write_ticks == 0) write_ticks = 1;
+    if (read_ticks == 0) read_ticks = 1;
+    terminal_writestring("256 KB on ");
+    terminal_writestring(fat16_get_device()->name);
+    terminal_writestring(": write ");
+    print_number((size / 1024) * 100 / write_ticks);
+    terminal_writestring(" KB/s, read ");
+    print_number((size / 1024) * 100 / read_ticks);
+    terminal_writestring(" KB/s\n");
 }
 
 static void version() {
@@ -302,7 +439,7 @@ static void get_completions(const char* partial, char** completions, int* num_co
     fat16_dir_entry_t* root_dir = (fat16_dir_entry_t*)malloc(root_dir_sectors * boot_sector.bytes_per_sector);
     if (!root_dir) return;
     
-    if (!iso_fs_read_sectors(root_dir_start_sector, root_dir_sectors, root_dir)) {
+    if (!fat16_read_directory(0, root_dir, boot_sector.root_entries)) {
         free(root_dir);
         return;
     }
@@ -444,11 +581,18 @@ static void handle_command(const char* command) {
         terminal_writestring("  progtest       - Run program loading test\n");
         terminal_writestring("  mkfile <file>  - Create a new empty file\n");
         terminal_writestring("  rm <file>      - Remove a file\n");
+        terminal_writestring("  mkdir <dir>    - Create a directory\n");
+        terminal_writestring("  rmdir <dir>    - Remove an empty directory\n");
         terminal_writestring("  clear          - Clear the screen\n");
         terminal_writestring("  edit <file>    - Edit a file\n");
         terminal_writestring("  cursortest     - Test ANSI cursor movement\n");
         terminal_writestring("  pci            - Scan PCI devices\n");
         terminal_writestring("  usb            - Initialize and scan USB 3.0 devices\n");
+        terminal_writestring("  vbe_bench      - Measure framebuffer fill/copy speed\n");
+        terminal_writestring("  bcache [sync]  - Show buffer cache statistics or flush it\n");
+        terminal_writestring("  mount [dev]    - Show or mount the FAT16 volume (iso, ide, ahci, virtio)\n");
+        terminal_writestring("  fsbench        - Measure file write/read speed on the volume\n");
+        terminal_writestring("  blkq [depth]   - Show the volume's request queue or set its depth\n");
     } else if (strcmp(cmd_name, "cursortest") == 0) {
         ansi_set_enabled(true);
         // Test ANSI cursor movement
@@ -559,76 +703,47 @@ static void handle_command(const char* command) {
         pci_scan();
     } else if (strcmp(cmd_name, "usb") == 0) {
         xhci_init();
+    } else if (strcmp(cmd_name, "vbe_bench") == 0) {
+        vbe_bench();
+    } else if (strcmp(cmd_name, "mount") == 0) {
+        const char* arg = command + strlen(cmd_name);
+        while (*arg == ' ') arg++;  // Skip spaces
+        mount(arg);
+    } else if (strcmp(cmd_name, "fsbench") == 0) {
+        fsbench();
+    } else if (strcmp(cmd_name, "bcache") == 0) {
+        const char* arg = command + strlen(cmd_name);
+        while (*arg == ' ') arg++;  // Skip spaces
+
+        if (strcmp(arg, "sync") == 0) {
+            terminal_writestring(bcache_flush() ? "Buffer cache flushed\n" : "Buffer cache flush failed\n");
+        } else {
+            bcache_print_stats();
+        }
+    } else if (strcmp(cmd_name, "blkq") == 0) {
+        const char* arg = command + strlen(cmd_name);
+        while (*arg == ' ') arg++;  // Skip spaces
+
+        block_device_t* device = fat16_get_device();
+        if (!device) {
+            terminal_writestring("Nothing mounted\n");
+        } else if (*arg >= '0' && *arg <= '9') {
+            uint32_t depth = 0;
+            while (*arg >= '0' && *arg <= '9') {
+                depth = depth * 10 + (*arg++ - '0');
+            }
+            block_queue_set_depth(device, depth);
+            block_queue_print_stats(device);
+        } else {
+            block_queue_print_stats(device);
+        }
     } else if (strcmp(cmd_name, "ls") == 0) {
         const char* path = command + strlen(cmd_name);
         while (*path == ' ') path++;  // Skip spaces
         
-        // Read current directory
-        fat16_dir_entry_t* dir_entries = (fat16_dir_entry_t*)malloc(root_dir_sectors * boot_sector.bytes_per_sector);
-        if (!dir_entries) {
-            terminal_writestring("Failed to allocate memory\n");
-            return;
-        }
-
-        if (fat16_read_directory(current_cluster, dir_entries, boot_sector.root_entries)) {
-            // Print header
-            terminal_writestring("Name           Size    Type\n");
-            terminal_writestring("----------------------------------------\n");
-
-            for (int i = 0; i < boot_sector.root_entries; i++) {
-                if (dir_entries[i].filename[0] == 0x00) break;
-                if (dir_entries[i].filename[0] == 0xE5) continue;
-                if ((dir_entries[i].attributes & FAT16_ATTR_LONG_NAME) == FAT16_ATTR_LONG_NAME) continue;
-                if (dir_entries[i].attributes & FAT16_ATTR_VOLUME_ID) continue;
-
-                // Format filename
-                char name[13] = {0};
-                int name_idx = 0;
-                for (int j = 0; j < 8; j++) {
-                    if (dir_entries[i].filename[j] != ' ') {
-                        name[name_idx++] = dir_entries[i].filename[j];
-                    }
-                }
-                if (dir_entries[i].extension[0] != ' ') {
-                    name[name_idx++] = '.';
-                    for (int j = 0; j < 3; j++) {
-                        if (dir_entries[i].extension[j] != ' ') {
-                            name[name_idx++] = dir_entries[i].extension[j];
-                        }
-                    }
-                }
-                name[name_idx] = '\0';
-
-                // Print name, padded to 16 chars
-                terminal_writestring(name);
-                int name_len = strlen(name);
-                for (int s = name_len; s < 16; s++) {
-                    terminal_putchar(' ');
-                }
-
-                // Print size or blank for directories
-                if (dir_entries[i].attributes & FAT16_ATTR_DIRECTORY) {
-                    terminal_writestring("        ");
-                } else {
-                    char size_str[16];
-                    itoa_custom(dir_entries[i].file_size, size_str, 10);
-                    terminal_writestring(size_str);
-                    int size_len = strlen(size_str);
-                    for (int s = size_len; s < 8; s++) {
-                        terminal_putchar(' ');
-                    }
-                }
-
-                // Print type
-                const char* type_str = get_file_type(&dir_entries[i]);
-                terminal_writestring(type_str);
-                terminal_putchar('\n');
-            }
-        } else {
+        if (!fat16_list_directory(path)) {
             terminal_writestring("Failed to read directory\n");
         }
-
-        free(dir_entries);
     } else if (strcmp(cmd_name, "cat") == 0) {
         const char* filename = command + strlen(cmd_name);
         while (*filename == ' ') filename++;  // Skip spaces
@@ -638,24 +753,39 @@ static void handle_command(const char* command) {
             return;
         }
 
-        // Allocate buffer for file contents
-        char* buffer = (char*)malloc(4096);  // 4KB buffer
-        if (!buffer) {
-            terminal_writestring("Failed to allocate memory\n");
-            return;
-        }
-
-        int result = fat16_read_file(filename, buffer, 4096);
-        if (result == -1) {
-            terminal_writestring("Can't read a empty file\n");
-        } else if (result) {
-            terminal_writestring(buffer);
-            terminal_writestring("\n");
+        // Print straight from a RAM volume, or stream it in small pieces
+        // so a large file on disk needs no large buffer
+        if (fat16_get_device() && fat16_get_device()->map_sectors) {
+            struct fat16_map map;
+            if (!fat16_map_file(filename, &map)) {
+                terminal_writestring("Failed to read file\n");
+            } else if (map.size == 0) {
+                terminal_writestring("Can't read a empty file\n");
+            } else {
+                for (int i = 0; i < map.count; i++) {
+                    terminal_write((const char*)map.extents[i].data, map.extents[i].length);
+                }
+                terminal_writestring("\n");
+            }
+            fat16_unmap_file(&map);
         } else {
-            terminal_writestring("Failed to read file\n");
+            struct fat16_file file;
+            char chunk[512];
+            int n;
+            if (!fat16_open_file(filename, &file)) {
+                terminal_writestring("Failed to read file\n");
+            } else {
+                if (file.size == 0) {
+                    terminal_writestring("Can't read a empty file\n");
+                } else {
+                    while ((n = fat16_read(&file, chunk, sizeof(chunk))) > 0) {
+                        terminal_write(chunk, n);
+                    }
+                    terminal_writestring(n < 0 ? "\nRead error\n" : "\n");
+                }
+                fat16_close_file(&file);
+            }
         }
-
-        free(buffer);
     } else if (strcmp(cmd_name, "mkfile") == 0) {
         const char* filename = command + strlen(cmd_name);
         while (*filename == ' ') filename++;  // Skip spaces
@@ -674,7 +804,7 @@ static void handle_command(const char* command) {
         terminal_clear();
         draw_header();  // Redraw the header after clearing
         vbe_cursor_x = 0;
-        vbe_cursor_y = 125; // or wherever you want the prompt to start
+        vbe_cursor_y = 128; // First console row below the header
         draw_prompt();  // Set cursor and draw prompt at the correct position
     } else if (strcmp(cmd_name, "edit") == 0) {
         const char* filename = command + strlen(cmd_name);
@@ -699,6 +829,21 @@ static void handle_command(const char* command) {
         } else {
             terminal_writestring("Failed to remove file\n");
         }
+    } else if (strcmp(cmd_name, "mkdir") == 0 || strcmp(cmd_name, "rmdir") == 0) {
+        bool make = strcmp(cmd_name, "mkdir") == 0;
+        const char* path = command + strlen(cmd_name);
+        while (*path == ' ') path++;  // Skip spaces
+        
+        if (*path == '\0') {
+            terminal_writestring(make ? "Usage: mkdir <dir>\n" : "Usage: rmdir <dir>\n");
+            return;
+        }
+
+        if (make ? fat16_mkdir(path) : fat16_rmdir(path)) {
+            terminal_writestring(make ? "Directory created\n" : "Directory removed\n");
+        } else {
+            terminal_writestring(make ? "Failed to create directory\n" : "Failed to remove directory (must exist and be empty)\n");
+        }
     } else if (strcmp(cmd_name, "cd") == 0) {
         const char* path = command + strlen(cmd_name);
         while (*path == ' ') path++;  // Skip spaces
@@ -721,7 +866,7 @@ static void handle_command(const char* command) {
 // Initialize shell
 void shell_init(void) {
     // Clear screen and draw header
-    vbe_clear_screen(0x00000000);
+    terminal_clear();
     
     // Initialize terminal without cursor
     terminal_initialize();
@@ -743,7 +888,7 @@ void shell_init(void) {
     
     // Set position for text output without cursor
     vbe_cursor_x = 0;
-    vbe_cursor_y = 125; // Position below header
+    vbe_cursor_y = 128; // Position below header
     
     // Draw initial prompt
     draw_prompt();
@@ -769,34 +914,9 @@ void shell_start(void) {
             // Handle special keys
             if (c == '\b') {  // Backspace
                 if (cmd_index > 0) {
-                    // Store current cursor position
-                    int current_x = vbe_cursor_x;
-                    int current_y = vbe_cursor_y;
-                    
                     cmd_index--;
                     cmd_buffer[cmd_index] = '\0';
-                    
-                    // Clear the entire line
-                    const PSF1Font* font = get_current_psf1_font();
-                    int line_height = font ? font->header.char_height : font_8x16.height;
-                    vbe_draw_rect(0, current_y, VBE_WIDTH, line_height, 0x00000000);
-                    
-                    // Redraw the prompt
-                    draw_prompt();
-                    
-                    // Redraw the remaining text at the correct position
-                    if (cmd_index > 0) {
-                        if (!font) {
-                            vbe_draw_string(vbe_cursor_x, current_y, cmd_buffer, TEXT_COLOR, &font_8x16);
-                            vbe_cursor_x = vbe_cursor_x + (cmd_index * font_8x16.width);
-                        } else {
-                            vbe_draw_string_psf1(vbe_cursor_x, current_y, cmd_buffer, TEXT_COLOR, font);
-                            vbe_cursor_x = vbe_cursor_x + (cmd_index * font_get_char_width(' '));
-                        }
-                    }
-                    
-                    // Restore cursor position
-                    vbe_cursor_y = current_y;
+                    terminal_putchar('\b');
                 }
             } else if (c == '\n') {  // Enter
                 terminal_putchar('\n');
@@ -830,9 +950,6 @@ void shell_start(void) {
                             char code = keyboard_getchar();
                             if (code == 'A') {  // Up arrow
                                 if (history_count > 0) {
-                                    // Get current cursor position
-                                    int current_y = vbe_cursor_y;
-                                    
                                     // Clear current line
                                     clear_input_line(cmd_index);
                                     
@@ -849,15 +966,10 @@ void shell_start(void) {
                                     
                                     // Redraw prompt and command
                                     draw_prompt();
-                                    vbe_draw_string(vbe_cursor_x, current_y, cmd_buffer, TEXT_COLOR, &font_8x16);
-                                    vbe_cursor_x = vbe_cursor_x + (cmd_index * 8);  // Update cursor position
-                                    vbe_cursor_y = current_y;
+                                    terminal_writestring_color(cmd_buffer, TEXT_COLOR);
                                 }
                             } else if (code == 'B') {  // Down arrow
                                 if (history_index != -1) {
-                                    // Get current cursor position
-                                    int current_y = vbe_cursor_y;
-                                    
                                     // Clear current line
                                     clear_input_line(cmd_index);
                                     
@@ -869,15 +981,16 @@ void shell_start(void) {
                                         history_index = -1;
                                         memset(cmd_buffer, 0, MAX_CMD_LENGTH);
                                     }
+                                    cmd_index = strlen(cmd_buffer);
                                     
                                     // Redraw prompt and command
                                     draw_prompt();
-                                    if (cmd_index > 0) {
-                                        vbe_draw_string(vbe_cursor_x, current_y, cmd_buffer, TEXT_COLOR, &font_8x16);
-                                        vbe_cursor_x = vbe_cursor_x + (cmd_index * 8);  // Update cursor position
-                                        vbe_cursor_y = current_y;
-                                    }
+                                    terminal_writestring_color(cmd_buffer, TEXT_COLOR);
                                 }
+                            } else if (code == '5') {  // Page Up
+                                terminal_scroll_view(VBE_HEIGHT / 16 / 2);
+                            } else if (code == '6') {  // Page Down
+                                terminal_scroll_view(-(VBE_HEIGHT / 16 / 2));
                             }
                         }
                     }
@@ -890,6 +1003,9 @@ void shell_start(void) {
             }
         }
         
+        // Write back dirty filesystem blocks now and then
+        bcache_periodic(timer_get_ticks());
+
         // Small delay to prevent CPU hogging
         for (volatile int i = 0; i < 1000; i++);
     }
@@ -897,13 +1013,7 @@ void shell_start(void) {
 
 // Helper function to clear input line
 void clear_input_line(int length) {
-    const PSF1Font* font = get_current_psf1_font();
-    if (!font) {
-        // Fall back to embedded font if PSF1 font is not available
-        vbe_draw_rect(vbe_cursor_x, vbe_cursor_y, VBE_WIDTH - vbe_cursor_x, font_8x16.height, 0x00000000);
-    } else {
-        vbe_draw_rect(vbe_cursor_x, vbe_cursor_y, VBE_WIDTH - vbe_cursor_x, font->header.char_height, 0x00000000);
-    }
+    terminal_clear_to_eol();
     
     // Reset command buffer and index
     memset(cmd_buffer, 0, MAX_CMD_LENGTH);
@@ -1,4 +1,7 @@
 #include "../include/string.h"
+#include "../include/io.h"
+#include <stdint.h>
+#include <stdbool.h>
 #include <stdarg.h>
 
 // Reverse a string in place
@@ -60,14 +63,6 @@ int strcmp(const char* s1, const char* s2) {
     return *(unsigned char*)s1 - *(unsigned char*)s2;
 }
 
-// Set memory to a specific value
-void* memset(void* dest, int val, size_t count) {
-    unsigned char* ptr = (unsigned char*)dest;
-    while (count-- > 0) {
-        *ptr++ = (unsigned char)val;
-    }
-    return dest;
-}
 
 // Find first occurrence of character in string
 char* strchr(const char* str, int c) {
@@ -96,27 +91,7 @@ int strncmp(const char* s1, const char* s2, size_t n) {
     return *(unsigned char*)s1 - *(unsigned char*)s2;
 }
 
-// Copy memory from source to destination
-void* memcpy(void* dest, const void* src, size_t count) {
-    unsigned char* d = (unsigned char*)dest;
-    const unsigned char* s = (const unsigned char*)src;
-    while (count-- > 0) {
-        *d++ = *s++;
-    }
-    return dest;
-}
 
-// Compare memory regions
-int memcmp(const void* ptr1, const void* ptr2, size_t count) {
-    const unsigned char* p1 = (const unsigned char*)ptr1;
-    const unsigned char* p2 = (const unsigned char*)ptr2;
-    while (count-- > 0) {
-        if (*p1++ != *p2++) {
-            return p1[-1] < p2[-1] ? -1 : 1;
-        }
-    }
-    return 0;
-}
 
 // Get string length
 size_t strlen(const char* str) {
@@ -172,24 +147,6 @@ char* strncat(char* dest, const char* src, size_t count) {
     return dest;
 } 
 
-// Implementation of memmove for our environment
-void* memmove(void* dest, const void* src, size_t n) {
-    unsigned char* d = (unsigned char*)dest;
-    const unsigned char* s = (const unsigned char*)src;
-    
-    if (d < s) {
-        // Copy forward
-        for (size_t i = 0; i < n; i++) {
-            d[i] = s[i];
-        }
-    } else if (d > s) {
-        // Copy backward
-        for (size_t i = n; i > 0; i--) {
-            d[i-1] = s[i-1];
-        }
-    }
-    return dest;
-}
 
 // Duplicate a string
 char* strdup(const char* s) {
@@ -260,3 +217,200 @@ char* strrchr(const char* str, int c) {
     }
     return (char*)last;
 }
+
+// Memory routines. Small blocks are copied byte by byte, medium ones with
+// rep movsd/stosd, and large ones with SSE2 non-temporal stores when the
+// CPU has SSE2 and boot.asm enabled SSE. string_init picks the strategy.
+#define MEM_REP_THRESHOLD 16          // Below this, plain byte loops
+#define MEM_NT_THRESHOLD  (64 * 1024) // From here, stream past the cache
+
+static bool have_sse2 = false;
+
+// Dword view of a byte buffer
+typedef uint32_t __attribute__((may_alias)) mem_word_t;
+
+void string_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+
+    // SSE2 is only usable once CR4.OSFXSR has been set
+    have_sse2 = (edx & (1 << 26)) && (read_cr4() & (1 << 9));
+}
+
+bool string_has_sse2(void) {
+    return have_sse2;
+}
+
+// The SSE2 paths keep their own copy of the XMM registers they use, so
+// an interrupt handler copying memory cannot clobber an interrupted copy
+#define XMM_SAVE(buf) \
+    asm volatile ("movdqu %%xmm0, 0(%0)\n\tmovdqu %%xmm1, 16(%0)\n\t" \
+                  "movdqu %%xmm2, 32(%0)\n\tmovdqu %%xmm3, 48(%0)" : : "r"(buf) : "memory")
+#define XMM_RESTORE(buf) \
+    asm volatile ("movdqu 0(%0), %%xmm0\n\tmovdqu 16(%0), %%xmm1\n\t" \
+                  "movdqu 32(%0), %%xmm2\n\tmovdqu 48(%0), %%xmm3" : : "r"(buf) : "memory")
+
+// Forward copy with rep movsd, dword-aligning the destination first
+static inline void copy_rep(uint8_t* d, const uint8_t* s, size_t n) {
+    size_t head = (-(uint32_t)d) & 3;
+    if (head > n) head = n;
+    n -= head;
+    while (head--) *d++ = *s++;
+
+    size_t dwords = n >> 2;
+    size_t rest = n & 3;
+    asm volatile ("rep movsl" : "+D"(d), "+S"(s), "+c"(dwords) : : "memory");
+    asm volatile ("rep movsb" : "+D"(d), "+S"(s), "+c"(rest) : : "memory");
+}
+
+// Large forward copy: 64 bytes per iteration, non-temporal stores
+static void copy_nt(uint8_t* d, const uint8_t* s, size_t n) {
+    size_t head = (-(uint32_t)d) & 15;
+    copy_rep(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+
+    uint8_t save[64];
+    size_t blocks = n / 64;
+    XMM_SAVE(save);
+    asm volatile (
+        "1:\n\t"
+        "movdqu 0(%1), %%xmm0\n\t"
+        "movdqu 16(%1), %%xmm1\n\t"
+        "movdqu 32(%1), %%xmm2\n\t"
+        "movdqu 48(%1), %%xmm3\n\t"
+        "movntdq %%xmm0, 0(%0)\n\t"
+        "movntdq %%xmm1, 16(%0)\n\t"
+        "movntdq %%xmm2, 32(%0)\n\t"
+        "movntdq %%xmm3, 48(%0)\n\t"
+        "add $64, %1\n\t"
+        "add $64, %0\n\t"
+        "dec %2\n\t"
+        "jnz 1b\n\t"
+        "sfence"
+        : "+r"(d), "+r"(s), "+r"(blocks) : : "memory");
+    XMM_RESTORE(save);
+
+    copy_rep(d, s, n & 63);
+}
+
+// Copy memory from source to destination
+void* memcpy(void* dest, const void* src, size_t count) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+
+    if (count < MEM_REP_THRESHOLD) {
+        while (count--) *d++ = *s++;
+    } else if (count >= MEM_NT_THRESHOLD && have_sse2) {
+        copy_nt(d, s, count);
+    } else {
+        copy_rep(d, s, count);
+    }
+    return dest;
+}
+
+// Set memory to a specific value
+void* memset(void* dest, int val, size_t count) {
+    uint8_t* d = (uint8_t*)dest;
+    uint8_t byte = (uint8_t)val;
+
+    if (count < MEM_REP_THRESHOLD) {
+        while (count--) *d++ = byte;
+        return dest;
+    }
+
+    uint32_t pattern = byte * 0x01010101u;
+    size_t align = (count >= MEM_NT_THRESHOLD && have_sse2) ? 15 : 3;
+    size_t head = (-(uint32_t)d) & align;
+    count -= head;
+    while (head--) *d++ = byte;
+
+    if (align == 15) {
+        uint8_t save[64];
+        size_t blocks = count / 64;
+        XMM_SAVE(save);
+        asm volatile (
+            "movd %2, %%xmm0\n\t"
+            "pshufd $0, %%xmm0, %%xmm0\n\t"
+            "1:\n\t"
+            "movntdq %%xmm0, 0(%0)\n\t"
+            "movntdq %%xmm0, 16(%0)\n\t"
+            "movntdq %%xmm0, 32(%0)\n\t"
+            "movntdq %%xmm0, 48(%0)\n\t"
+            "add $64, %0\n\t"
+            "dec %1\n\t"
+            "jnz 1b\n\t"
+            "sfence"
+            : "+r"(d), "+r"(blocks) : "r"(pattern) : "memory");
+        XMM_RESTORE(save);
+        count &= 63;
+    }
+
+    size_t dwords = count >> 2;
+    size_t rest = count & 3;
+    asm volatile ("rep stosl" : "+D"(d), "+c"(dwords) : "a"(pattern) : "memory");
+    asm volatile ("rep stosb" : "+D"(d), "+c"(rest) : "a"(pattern) : "memory");
+    return dest;
+}
+
+// Implementation of memmove for our environment
+void* memmove(void* dest, const void* src, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+
+    if (d <= s || d >= s + n) {
+        // No overlap, or the destination is below: a forward copy is safe
+        return memcpy(dest, src, n);
+    }
+
+    // Overlapping move up: copy backward, tail bytes first
+    d += n;
+    s += n;
+    while (n & 3) {
+        *--d = *--s;
+        n--;
+    }
+    size_t dwords = n >> 2;
+    d -= 4;
+    s -= 4;
+    asm volatile ("std\n\trep movsl\n\tcld" : "+D"(d), "+S"(s), "+c"(dwords) : : "memory");
+    return dest;
+}
+
+// Compare memory regions
+int memcmp(const void* ptr1, const void* ptr2, size_t count) {
+    const uint8_t* p1 = (const uint8_t*)ptr1;
+    const uint8_t* p2 = (const uint8_t*)ptr2;
+
+    // Skip equal 16-byte chunks with SSE2, then equal dwords
+    if (count >= 64 && have_sse2) {
+        uint8_t save[64];
+        XMM_SAVE(save);
+        while (count >= 16) {
+            uint32_t mask;
+            asm volatile (
+                "movdqu (%1), %%xmm0\n\t"
+                "movdqu (%2), %%xmm1\n\t"
+                "pcmpeqb %%xmm1, %%xmm0\n\t"
+                "pmovmskb %%xmm0, %0"
+                : "=r"(mask) : "r"(p1), "r"(p2) : "memory");
+            if (mask != 0xFFFF) break;
+            p1 += 16;
+            p2 += 16;
+            count -= 16;
+        }
+        XMM_RESTORE(save);
+    }
+    while (count >= 4 && *(const mem_word_t*)p1 == *(const mem_word_t*)p2) {
+        p1 += 4;
+        p2 += 4;
+        count -= 4;
+    }
+    while (count-- > 0) {
+        if (*p1++ != *p2++) {
+            return p1[-1] < p2[-1] ? -1 : 1;
+        }
+    }
+    return 0;
+}
@@ -2,6 +2,7 @@
 #include "../include/memory/heap.h"
 #include "../include/memory/program.h"
 #include "../include/drivers/vbe.h"
+#include "../include/string.h"
 #include <stddef.h>
 #include <stdbool.h>
 
@@ -26,6 +27,21 @@ void test_memory_management() {
         terminal_writestring("✗ Failed to allocate physical pages\n");
     }
 
+    // Contiguous, aligned runs must come back whole and aligned
+    size_t free_before = pmm_get_free_pages();
+    void* run = pmm_alloc_pages(16, 0x10000);  // 64KB on a 64KB boundary
+    if (run && ((uint32_t)run & 0xFFFF) == 0 && pmm_get_free_pages() == free_before - 16) {
+        pmm_free_pages(run, 16);
+        if (pmm_get_free_pages() == free_before) {
+            terminal_writestring("✓ Contiguous 16-page aligned allocation\n");
+        } else {
+            terminal_writestring("✗ Contiguous free did not restore page count\n");
+        }
+    } else {
+        terminal_writestring("✗ Failed to allocate contiguous pages\n");
+        if (run) pmm_free_pages(run, 16);
+    }
+
     // Test Heap
     terminal_writestring("\nTesting Heap Memory Management:\n");
     
@@ -46,6 +62,48 @@ void test_memory_management() {
         terminal_writestring("✗ Failed to allocate heap memory\n");
     }
 
+    // Small-object churn must reuse freed slots instead of growing the heap
+    struct heap_stats before, after;
+    heap_get_stats(&before);
+    bool churn_ok = true;
+    for (int i = 0; i < 10000 && churn_ok; i++) {
+        char* small = (char*)malloc(16 + (i % 200));
+        if (!small) {
+            churn_ok = false;
+            break;
+        }
+        small[0] = (char)i;
+        free(small);
+    }
+    heap_get_stats(&after);
+    if (churn_ok && after.bytes_in_use == before.bytes_in_use) {
+        terminal_writestring("✓ 10000 alloc/free cycles left heap usage unchanged\n");
+    } else {
+        terminal_writestring("✗ Heap usage grew during alloc/free churn\n");
+    }
+
+    // realloc must preserve contents and calloc must zero
+    char* grow = (char*)malloc(32);
+    if (grow) {
+        for (int i = 0; i < 32; i++) grow[i] = (char)i;
+        grow = (char*)realloc(grow, 8192);
+    }
+    uint32_t* zeroed = (uint32_t*)calloc(256, sizeof(uint32_t));
+    bool resize_ok = grow && zeroed;
+    for (int i = 0; resize_ok && i < 32; i++) {
+        if (grow[i] != (char)i) resize_ok = false;
+    }
+    for (int i = 0; resize_ok && i < 256; i++) {
+        if (zeroed[i] != 0) resize_ok = false;
+    }
+    if (resize_ok) {
+        terminal_writestring("✓ realloc preserved data and calloc zeroed memory\n");
+    } else {
+        terminal_writestring("✗ realloc/calloc check failed\n");
+    }
+    free(grow);
+    free(zeroed);
+
     // Test memory writing
     terminal_writestring("\nTesting Memory Writing:\n");
     
@@ -79,16 +137,44 @@ void test_memory_management() {
     }
 }
 
-void my_test_program(void) {
-    terminal_writestring("Hello from loaded program!\n");
-}
+static const char test_program_message[] = "Hello from loaded program!\n";
+
+// terminal_writestring(test_program_message) through absolute addresses,
+// so the code still works after it is copied to the program's code_base
+static uint8_t my_test_program[] = {
+    0xB8, 0, 0, 0, 0,       // mov eax, message
+    0x50,                   // push eax
+    0xB8, 0, 0, 0, 0,       // mov eax, terminal_writestring
+    0xFF, 0xD0,             // call eax
+    0x83, 0xC4, 0x04,       // add esp, 4
+    0xC3                    // ret
+};
 
 void test_program_loading(void) {
     struct program prog;
+    uint32_t message = (uint32_t)test_program_message;
+    uint32_t writer = (uint32_t)terminal_writestring;
+    memcpy(my_test_program + 1, &message, 4);
+    memcpy(my_test_program + 7, &writer, 4);
+
     // For this test, we don't need a data segment
-    // We'll use a fixed code size (e.g., 128 bytes)
-    if (program_load((void*)my_test_program, 128, NULL, 0, my_test_program, &prog)) {
+    if (program_load(my_test_program, sizeof(my_test_program), NULL, 0,
+                     (program_entry_t)my_test_program, &prog)) {
         terminal_writestring("Program loaded successfully.\n");
+        if (prog.address_space) {
+            // The copied code must show up at code_base inside the program's space
+            vmm_switch_address_space(prog.address_space);
+            bool mapped = true;
+            for (size_t i = 0; i < sizeof(my_test_program); i++) {
+                if (((uint8_t*)prog.code_base)[i] != my_test_program[i]) {
+                    mapped = false;
+                    break;
+                }
+            }
+            vmm_switch_address_space(NULL);
+            terminal_writestring(mapped ? "✓ Code mapped in program address space\n"
+                                        : "✗ Program address space mapping is wrong\n");
+        }
         program_execute(&prog);
         program_unload(&prog);
         terminal_writestring("Program unloaded.\n");
@@ -107,6 +107,7 @@ int sprintf(char* str, const char* format, ...) {
 int printf(const char* format, ...) {
     va_list args;
     va_start(args, format);
+    vbe_begin_update();  // Present the whole output at once
     
     char buffer[256];  // Buffer for formatted output
     int i = 0;
@@ -292,5 +293,6 @@ int printf(const char* format, ...) {
     }
     
     va_end(args);
+    vbe_end_update();
     return total_chars;  // Return total number of characters written
 } 
\ No newline at end of file